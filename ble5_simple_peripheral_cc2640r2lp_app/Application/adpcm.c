@@ -0,0 +1,655 @@
+/*
+ * adpcm.c
+ */
+/*********************************************************************
+ * INCLUDES
+ */
+
+#include <stdint.h>
+
+#include "adpcm.h"
+
+/*********************************************************************
+ * LOCAL VARIABLES
+ */
+
+/* @formatter:off */
+
+/* Table of index changes */
+const static signed char IndexTable[16] = { -1, -1, -1, -1, 2, 4, 6, 8,
+                                            -1, -1, -1, -1, 2, 4, 6, 8, };
+
+/* Table of index changes, 3-bit codes (sign bit stripped) */
+const static signed char IndexTable3[4] = { -1, -1, 1, 2 };
+
+/* Quantizer step size lookup table */
+const static int StepSizeTable[89] = { 7, 8, 9, 10, 11, 12, 13, 14, 16, 17,
+                                       19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+                                       50, 55, 60, 66, 73, 80, 88, 97, 107, 118,
+                                       130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+                                       337, 371, 408, 449, 494, 544, 598, 658, 724, 796,
+                                       876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+                                       2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358,
+                                       5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+                                       15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767 };
+
+/*
+ * Per-index tables for adpcmEncoderFast(), generated from the two tables
+ * above. The index is the 3-bit magnitude of the code (sign bit stripped).
+ *
+ * DiffqTable[i][c] = (step >> 3) + (c & 4 ? step : 0)
+ *                    + (c & 2 ? step >> 1 : 0) + (c & 1 ? step >> 2 : 0)
+ *
+ * NextIndexTable[i][c] = clamp(i + IndexTable[c], 0, 88)
+ */
+/* Dequantized difference, DiffqTable[index][code & 7] */
+const static uint16_t DiffqTable[89][8] = {
+  {     0,     1,     3,     4,     7,     8,    10,    11 },
+  {     1,     3,     5,     7,     9,    11,    13,    15 },
+  {     1,     3,     5,     7,    10,    12,    14,    16 },
+  {     1,     3,     6,     8,    11,    13,    16,    18 },
+  {     1,     3,     6,     8,    12,    14,    17,    19 },
+  {     1,     4,     7,    10,    13,    16,    19,    22 },
+  {     1,     4,     7,    10,    14,    17,    20,    23 },
+  {     1,     4,     8,    11,    15,    18,    22,    25 },
+  {     2,     6,    10,    14,    18,    22,    26,    30 },
+  {     2,     6,    10,    14,    19,    23,    27,    31 },
+  {     2,     6,    11,    15,    21,    25,    30,    34 },
+  {     2,     7,    12,    17,    23,    28,    33,    38 },
+  {     2,     7,    13,    18,    25,    30,    36,    41 },
+  {     3,     9,    15,    21,    28,    34,    40,    46 },
+  {     3,    10,    17,    24,    31,    38,    45,    52 },
+  {     3,    10,    18,    25,    34,    41,    49,    56 },
+  {     4,    12,    21,    29,    38,    46,    55,    63 },
+  {     4,    13,    22,    31,    41,    50,    59,    68 },
+  {     5,    15,    25,    35,    46,    56,    66,    76 },
+  {     5,    16,    27,    38,    50,    61,    72,    83 },
+  {     6,    18,    31,    43,    56,    68,    81,    93 },
+  {     6,    19,    33,    46,    61,    74,    88,   101 },
+  {     7,    22,    37,    52,    67,    82,    97,   112 },
+  {     8,    24,    41,    57,    74,    90,   107,   123 },
+  {     9,    27,    45,    63,    82,   100,   118,   136 },
+  {    10,    30,    50,    70,    90,   110,   130,   150 },
+  {    11,    33,    55,    77,    99,   121,   143,   165 },
+  {    12,    36,    60,    84,   109,   133,   157,   181 },
+  {    13,    39,    66,    92,   120,   146,   173,   199 },
+  {    14,    43,    73,   102,   132,   161,   191,   220 },
+  {    16,    48,    81,   113,   146,   178,   211,   243 },
+  {    17,    52,    88,   123,   160,   195,   231,   266 },
+  {    19,    58,    97,   136,   176,   215,   254,   293 },
+  {    21,    64,   107,   150,   194,   237,   280,   323 },
+  {    23,    70,   118,   165,   213,   260,   308,   355 },
+  {    26,    78,   130,   182,   235,   287,   339,   391 },
+  {    28,    85,   143,   200,   258,   315,   373,   430 },
+  {    31,    94,   157,   220,   284,   347,   410,   473 },
+  {    34,   103,   173,   242,   313,   382,   452,   521 },
+  {    38,   114,   191,   267,   345,   421,   498,   574 },
+  {    42,   126,   210,   294,   379,   463,   547,   631 },
+  {    46,   138,   231,   323,   417,   509,   602,   694 },
+  {    51,   153,   255,   357,   459,   561,   663,   765 },
+  {    56,   168,   280,   392,   505,   617,   729,   841 },
+  {    61,   184,   308,   431,   555,   678,   802,   925 },
+  {    68,   204,   340,   476,   612,   748,   884,  1020 },
+  {    74,   223,   373,   522,   672,   821,   971,  1120 },
+  {    82,   246,   411,   575,   740,   904,  1069,  1233 },
+  {    90,   271,   452,   633,   814,   995,  1176,  1357 },
+  {    99,   298,   497,   696,   895,  1094,  1293,  1492 },
+  {   109,   328,   547,   766,   985,  1204,  1423,  1642 },
+  {   120,   360,   601,   841,  1083,  1323,  1564,  1804 },
+  {   132,   397,   662,   927,  1192,  1457,  1722,  1987 },
+  {   145,   436,   728,  1019,  1311,  1602,  1894,  2185 },
+  {   160,   480,   801,  1121,  1442,  1762,  2083,  2403 },
+  {   176,   528,   881,  1233,  1587,  1939,  2292,  2644 },
+  {   194,   582,   970,  1358,  1746,  2134,  2522,  2910 },
+  {   213,   639,  1066,  1492,  1920,  2346,  2773,  3199 },
+  {   234,   703,  1173,  1642,  2112,  2581,  3051,  3520 },
+  {   258,   774,  1291,  1807,  2324,  2840,  3357,  3873 },
+  {   284,   852,  1420,  1988,  2556,  3124,  3692,  4260 },
+  {   312,   936,  1561,  2185,  2811,  3435,  4060,  4684 },
+  {   343,  1030,  1717,  2404,  3092,  3779,  4466,  5153 },
+  {   378,  1134,  1890,  2646,  3402,  4158,  4914,  5670 },
+  {   415,  1246,  2078,  2909,  3742,  4573,  5405,  6236 },
+  {   457,  1372,  2287,  3202,  4117,  5032,  5947,  6862 },
+  {   503,  1509,  2516,  3522,  4529,  5535,  6542,  7548 },
+  {   553,  1660,  2767,  3874,  4981,  6088,  7195,  8302 },
+  {   608,  1825,  3043,  4260,  5479,  6696,  7914,  9131 },
+  {   669,  2008,  3348,  4687,  6027,  7366,  8706, 10045 },
+  {   736,  2209,  3683,  5156,  6630,  8103,  9577, 11050 },
+  {   810,  2431,  4052,  5673,  7294,  8915, 10536, 12157 },
+  {   891,  2674,  4457,  6240,  8023,  9806, 11589, 13372 },
+  {   980,  2941,  4902,  6863,  8825, 10786, 12747, 14708 },
+  {  1078,  3235,  5393,  7550,  9708, 11865, 14023, 16180 },
+  {  1186,  3559,  5932,  8305, 10679, 13052, 15425, 17798 },
+  {  1305,  3915,  6526,  9136, 11747, 14357, 16968, 19578 },
+  {  1435,  4306,  7178, 10049, 12922, 15793, 18665, 21536 },
+  {  1579,  4737,  7896, 11054, 14214, 17372, 20531, 23689 },
+  {  1737,  5211,  8686, 12160, 15636, 19110, 22585, 26059 },
+  {  1911,  5733,  9555, 13377, 17200, 21022, 24844, 28666 },
+  {  2102,  6306, 10511, 14715, 18920, 23124, 27329, 31533 },
+  {  2312,  6937, 11562, 16187, 20812, 25437, 30062, 34687 },
+  {  2543,  7630, 12718, 17805, 22893, 27980, 33068, 38155 },
+  {  2798,  8394, 13990, 19586, 25183, 30779, 36375, 41971 },
+  {  3077,  9232, 15388, 21543, 27700, 33855, 40011, 46166 },
+  {  3385, 10156, 16928, 23699, 30471, 37242, 44014, 50785 },
+  {  3724, 11172, 18621, 26069, 33518, 40966, 48415, 55863 },
+  {  4095, 12286, 20478, 28669, 36862, 45053, 53245, 61436 },
+};
+
+/* Next step size index, NextIndexTable[index][code & 7] */
+const static uint8_t NextIndexTable[89][8] = {
+  {  0,  0,  0,  0,  2,  4,  6,  8 },
+  {  0,  0,  0,  0,  3,  5,  7,  9 },
+  {  1,  1,  1,  1,  4,  6,  8, 10 },
+  {  2,  2,  2,  2,  5,  7,  9, 11 },
+  {  3,  3,  3,  3,  6,  8, 10, 12 },
+  {  4,  4,  4,  4,  7,  9, 11, 13 },
+  {  5,  5,  5,  5,  8, 10, 12, 14 },
+  {  6,  6,  6,  6,  9, 11, 13, 15 },
+  {  7,  7,  7,  7, 10, 12, 14, 16 },
+  {  8,  8,  8,  8, 11, 13, 15, 17 },
+  {  9,  9,  9,  9, 12, 14, 16, 18 },
+  { 10, 10, 10, 10, 13, 15, 17, 19 },
+  { 11, 11, 11, 11, 14, 16, 18, 20 },
+  { 12, 12, 12, 12, 15, 17, 19, 21 },
+  { 13, 13, 13, 13, 16, 18, 20, 22 },
+  { 14, 14, 14, 14, 17, 19, 21, 23 },
+  { 15, 15, 15, 15, 18, 20, 22, 24 },
+  { 16, 16, 16, 16, 19, 21, 23, 25 },
+  { 17, 17, 17, 17, 20, 22, 24, 26 },
+  { 18, 18, 18, 18, 21, 23, 25, 27 },
+  { 19, 19, 19, 19, 22, 24, 26, 28 },
+  { 20, 20, 20, 20, 23, 25, 27, 29 },
+  { 21, 21, 21, 21, 24, 26, 28, 30 },
+  { 22, 22, 22, 22, 25, 27, 29, 31 },
+  { 23, 23, 23, 23, 26, 28, 30, 32 },
+  { 24, 24, 24, 24, 27, 29, 31, 33 },
+  { 25, 25, 25, 25, 28, 30, 32, 34 },
+  { 26, 26, 26, 26, 29, 31, 33, 35 },
+  { 27, 27, 27, 27, 30, 32, 34, 36 },
+  { 28, 28, 28, 28, 31, 33, 35, 37 },
+  { 29, 29, 29, 29, 32, 34, 36, 38 },
+  { 30, 30, 30, 30, 33, 35, 37, 39 },
+  { 31, 31, 31, 31, 34, 36, 38, 40 },
+  { 32, 32, 32, 32, 35, 37, 39, 41 },
+  { 33, 33, 33, 33, 36, 38, 40, 42 },
+  { 34, 34, 34, 34, 37, 39, 41, 43 },
+  { 35, 35, 35, 35, 38, 40, 42, 44 },
+  { 36, 36, 36, 36, 39, 41, 43, 45 },
+  { 37, 37, 37, 37, 40, 42, 44, 46 },
+  { 38, 38, 38, 38, 41, 43, 45, 47 },
+  { 39, 39, 39, 39, 42, 44, 46, 48 },
+  { 40, 40, 40, 40, 43, 45, 47, 49 },
+  { 41, 41, 41, 41, 44, 46, 48, 50 },
+  { 42, 42, 42, 42, 45, 47, 49, 51 },
+  { 43, 43, 43, 43, 46, 48, 50, 52 },
+  { 44, 44, 44, 44, 47, 49, 51, 53 },
+  { 45, 45, 45, 45, 48, 50, 52, 54 },
+  { 46, 46, 46, 46, 49, 51, 53, 55 },
+  { 47, 47, 47, 47, 50, 52, 54, 56 },
+  { 48, 48, 48, 48, 51, 53, 55, 57 },
+  { 49, 49, 49, 49, 52, 54, 56, 58 },
+  { 50, 50, 50, 50, 53, 55, 57, 59 },
+  { 51, 51, 51, 51, 54, 56, 58, 60 },
+  { 52, 52, 52, 52, 55, 57, 59, 61 },
+  { 53, 53, 53, 53, 56, 58, 60, 62 },
+  { 54, 54, 54, 54, 57, 59, 61, 63 },
+  { 55, 55, 55, 55, 58, 60, 62, 64 },
+  { 56, 56, 56, 56, 59, 61, 63, 65 },
+  { 57, 57, 57, 57, 60, 62, 64, 66 },
+  { 58, 58, 58, 58, 61, 63, 65, 67 },
+  { 59, 59, 59, 59, 62, 64, 66, 68 },
+  { 60, 60, 60, 60, 63, 65, 67, 69 },
+  { 61, 61, 61, 61, 64, 66, 68, 70 },
+  { 62, 62, 62, 62, 65, 67, 69, 71 },
+  { 63, 63, 63, 63, 66, 68, 70, 72 },
+  { 64, 64, 64, 64, 67, 69, 71, 73 },
+  { 65, 65, 65, 65, 68, 70, 72, 74 },
+  { 66, 66, 66, 66, 69, 71, 73, 75 },
+  { 67, 67, 67, 67, 70, 72, 74, 76 },
+  { 68, 68, 68, 68, 71, 73, 75, 77 },
+  { 69, 69, 69, 69, 72, 74, 76, 78 },
+  { 70, 70, 70, 70, 73, 75, 77, 79 },
+  { 71, 71, 71, 71, 74, 76, 78, 80 },
+  { 72, 72, 72, 72, 75, 77, 79, 81 },
+  { 73, 73, 73, 73, 76, 78, 80, 82 },
+  { 74, 74, 74, 74, 77, 79, 81, 83 },
+  { 75, 75, 75, 75, 78, 80, 82, 84 },
+  { 76, 76, 76, 76, 79, 81, 83, 85 },
+  { 77, 77, 77, 77, 80, 82, 84, 86 },
+  { 78, 78, 78, 78, 81, 83, 85, 87 },
+  { 79, 79, 79, 79, 82, 84, 86, 88 },
+  { 80, 80, 80, 80, 83, 85, 87, 88 },
+  { 81, 81, 81, 81, 84, 86, 88, 88 },
+  { 82, 82, 82, 82, 85, 87, 88, 88 },
+  { 83, 83, 83, 83, 86, 88, 88, 88 },
+  { 84, 84, 84, 84, 87, 88, 88, 88 },
+  { 85, 85, 85, 85, 88, 88, 88, 88 },
+  { 86, 86, 86, 86, 88, 88, 88, 88 },
+  { 87, 87, 87, 87, 88, 88, 88, 88 },
+};
+
+/* @formatter:on */
+
+/*********************************************************************
+ * LOCAL FUNCTIONS
+ */
+
+/*
+ * Same quantizer as adpcmEncoder(), but the three compare-and-subtract steps
+ * are turned into masks, the dequantized difference and the next index come
+ * from per-index tables (no index clamp), and the sign is applied by xor.
+ * step >> 1 and step >> 2 are free on Cortex-M (barrel shifter), so they are
+ * not tabulated.
+ */
+static inline int encodeOne(int sample, int *predSample, int *index)
+{
+  int step = StepSizeTable[*index];
+  int diff = sample - *predSample;
+  int sign = diff >> 31;            /* 0 or -1 */
+  int mag = (diff ^ sign) - sign;   /* abs(diff) */
+  int code;
+  int bit;
+
+  bit = (mag >= step);
+  code = bit << 2;
+  mag -= step & -bit;
+
+  bit = (mag >= (step >> 1));
+  code |= bit << 1;
+  mag -= (step >> 1) & -bit;
+
+  bit = (mag >= (step >> 2));
+  code |= bit;
+
+  int diffq = DiffqTable[*index][code];
+  int pred = *predSample + ((diffq ^ sign) - sign);
+
+  /* encoder clamps symmetrically, see adpcmEncoder() */
+  pred = pred > 32767 ? 32767 : pred;
+  pred = pred < -32767 ? -32767 : pred;
+
+  *predSample = pred;
+  *index = NextIndexTable[*index][code];
+
+  return code | (sign & 8);
+}
+
+/*
+ * Table-driven equivalent of adpcmDecoder()
+ */
+static inline int decodeOne(int code, int *predSample, int *index)
+{
+  int diffq = DiffqTable[*index][code & 7];
+  int pred = (code & 8) ? *predSample - diffq : *predSample + diffq;
+
+  pred = pred > 32767 ? 32767 : pred;
+  pred = pred < -32768 ? -32768 : pred;
+
+  *predSample = pred;
+  *index = NextIndexTable[*index][code & 7];
+
+  return pred;
+}
+
+/*
+ * 3-bit quantizer: diffq = (step >> 2) + (c & 2 ? step : 0)
+ *                        + (c & 1 ? step >> 1 : 0)
+ * This is (2 * c + 1) * step / 4, truncated per term as in the 4-bit codec.
+ */
+static inline int encodeOne3(int sample, int *predSample, int *index)
+{
+  int step = StepSizeTable[*index];
+  int diff = sample - *predSample;
+  int sign = diff >> 31;            /* 0 or -1 */
+  int mag = (diff ^ sign) - sign;   /* abs(diff) */
+  int diffq = step >> 2;
+  int code;
+  int bit;
+
+  bit = (mag >= step);
+  code = bit << 1;
+  mag -= step & -bit;
+  diffq += step & -bit;
+
+  bit = (mag >= (step >> 1));
+  code |= bit;
+  diffq += (step >> 1) & -bit;
+
+  /* same clamp as decodeOne3(), so header and advanced states agree */
+  int pred = *predSample + ((diffq ^ sign) - sign);
+  pred = pred > 32767 ? 32767 : pred;
+  pred = pred < -32768 ? -32768 : pred;
+
+  int next = *index + IndexTable3[code];
+  next = next < 0 ? 0 : next;
+  next = next > 88 ? 88 : next;
+
+  *predSample = pred;
+  *index = next;
+
+  return code | (sign & 4);
+}
+
+static inline int decodeOne3(int code, int *predSample, int *index)
+{
+  int step = StepSizeTable[*index];
+  int diffq = step >> 2;
+
+  if (code & 2)
+    diffq += step;
+  if (code & 1)
+    diffq += step >> 1;
+
+  int pred = (code & 4) ? *predSample - diffq : *predSample + diffq;
+  pred = pred > 32767 ? 32767 : pred;
+  pred = pred < -32768 ? -32768 : pred;
+
+  int next = *index + IndexTable3[code & 3];
+  next = next < 0 ? 0 : next;
+  next = next > 88 ? 88 : next;
+
+  *predSample = pred;
+  *index = next;
+
+  return pred;
+}
+
+/*********************************************************************
+ * PUBLIC FUNCTIONS
+ */
+
+char adpcmEncoder(short sample, int16_t *prevSample, uint8_t *prevIndex)
+{
+  int code; /* ADPCM output value */
+  int diff; /* Difference between sample and the predicted sample */
+  int step; /* Quantizer step size */
+  int predSample; /* Output of ADPCM predictor */
+  int diffq; /* Dequantized predicted difference */
+  int index; /* Index into step size table */
+
+  /* Restore previous values of predicted sample and quantizer step size index */
+  predSample = (int) (*prevSample);
+  index = *prevIndex;
+  step = StepSizeTable[index];
+
+  /* Compute the difference between the acutal sample (sample) and the
+   * the predicted sample (predsample)
+   */
+  diff = sample - predSample;
+  if (diff >= 0)
+    code = 0;
+  else
+  {
+    code = 8;
+    diff = -diff;
+  }
+  /* Quantize the difference into the 4-bit ADPCM code using the
+   * the quantizer step size
+   */
+  /* Inverse quantize the ADPCM code into a predicted difference
+   * using the quantizer step size
+   */
+  diffq = step >> 3;
+  if (diff >= step)
+  {
+    code |= 4;
+    diff -= step;
+    diffq += step;
+  }
+  step >>= 1;
+  if (diff >= step)
+  {
+    code |= 2;
+    diff -= step;
+    diffq += step;
+  }
+  step >>= 1;
+  if (diff >= step)
+  {
+    code |= 1;
+    diffq += step;
+  }
+  /* Fixed predictor computes new predicted sample by adding the
+   * old predicted sample to predicted difference
+   */
+  if (code & 8)
+    predSample -= diffq;
+  else
+    predSample += diffq;
+  /* Check for overflow of the new predicted sample */
+  if (predSample > 32767)
+    predSample = 32767;
+  else if (predSample < -32767)
+    predSample = -32767;
+  /* Find new quantizer stepsize index by adding the old index
+   * to a table lookup using the ADPCM code
+   */
+  index += IndexTable[code];
+  /* Check for overflow of the new quantizer step size index */
+  if (index < 0)
+    index = 0;
+  if (index > 88)
+    index = 88;
+  /* Save the predicted sample and quantizer step size index for next iteration */
+  *prevSample = (short) predSample;
+  *prevIndex = index;
+
+  /* Return the new ADPCM code */
+  return (code & 0x0f);
+}
+
+short adpcmDecoder(char code, int16_t* prevSample, uint8_t *prevIndex)
+{
+  int predsample;
+  int index;
+  int step;
+  int diffq;
+
+  /* Restore previous values of predicted sample and quantizer step
+   size index
+   */
+  predsample = *prevSample;
+  index = *prevIndex;
+  /* Find quantizer step size from lookup table using index
+   */
+  step = StepSizeTable[index];
+  /* Inverse quantize the ADPCM code into a difference using the
+   quantizer step size
+   */
+  diffq = step >> 3;
+  if (code & 4)
+    diffq += step;
+  if (code & 2)
+    diffq += step >> 1;
+  if (code & 1)
+    diffq += step >> 2;
+  /* Add the difference to the predicted sample
+   */
+  if (code & 8)
+    predsample -= diffq;
+  else
+    predsample += diffq;
+  /* Check for overflow of the new predicted sample
+   */
+  if (predsample > 32767)
+    predsample = 32767;
+  else if (predsample < -32768)
+    predsample = -32768;
+  /* Find new quantizer step size by adding the old index and a
+   table lookup using the ADPCM code
+   */
+  index += IndexTable[code];
+  /* Check for overflow of the new quantizer step size index
+   */
+  if (index < 0)
+    index = 0;
+  if (index > 88)
+    index = 88;
+  /* Save predicted sample and quantizer step size index for next
+   iteration
+   */
+  *prevSample = predsample;
+  *prevIndex = index;
+  /* Return the new speech sample */
+  return (int16_t)(predsample);
+}
+
+char adpcmEncoderFast(short sample, int16_t *prevSample, uint8_t *prevIndex)
+{
+  int predSample = *prevSample;
+  int index = *prevIndex;
+  int code = encodeOne(sample, &predSample, &index);
+
+  *prevSample = (short) predSample;
+  *prevIndex = index;
+  return (char) code;
+}
+
+void adpcmEncodeBlock(const int16_t *pcm, size_t n, uint8_t *out,
+                      AdpcmState_t *st)
+{
+  int predSample = st->sample;
+  int index = st->index;
+
+  for (; n >= 2; n -= 2)
+  {
+    int lo = encodeOne(*pcm++, &predSample, &index);
+    int hi = encodeOne(*pcm++, &predSample, &index);
+    *out++ = (uint8_t) (lo | (hi << 4));
+  }
+
+  if (n)
+  {
+    *out = (uint8_t) encodeOne(*pcm, &predSample, &index);
+  }
+
+  st->sample = (int16_t) predSample;
+  st->index = (uint8_t) index;
+}
+
+void adpcmDecodeBlock(const uint8_t *in, size_t n, int16_t *pcm,
+                      AdpcmState_t *st)
+{
+  int predSample = st->sample;
+  int index = st->index;
+
+  for (; n >= 2; n -= 2)
+  {
+    uint8_t x = *in++;
+    *pcm++ = (int16_t) decodeOne(x & 0x0f, &predSample, &index);
+    *pcm++ = (int16_t) decodeOne(x >> 4, &predSample, &index);
+  }
+
+  if (n)
+  {
+    *pcm = (int16_t) decodeOne(*in & 0x0f, &predSample, &index);
+  }
+
+  st->sample = (int16_t) predSample;
+  st->index = (uint8_t) index;
+}
+
+void adpcmAdvanceState(const uint8_t *in, size_t n, AdpcmState_t *st)
+{
+  int predSample = st->sample;
+  int index = st->index;
+
+  for (; n >= 2; n -= 2)
+  {
+    uint8_t x = *in++;
+    decodeOne(x & 0x0f, &predSample, &index);
+    decodeOne(x >> 4, &predSample, &index);
+  }
+
+  if (n)
+  {
+    decodeOne(*in & 0x0f, &predSample, &index);
+  }
+
+  st->sample = (int16_t) predSample;
+  st->index = (uint8_t) index;
+}
+
+void adpcm3EncodeBlock(const int16_t *pcm, size_t n, uint8_t *out,
+                       AdpcmState_t *st)
+{
+  int predSample = st->sample;
+  int index = st->index;
+
+  while (n)
+  {
+    size_t k = n < ADPCM3_GROUP_SAMPLES ? n : ADPCM3_GROUP_SAMPLES;
+    uint32_t word = 0;
+
+    for (size_t i = 0; i < k; i++)
+    {
+      word |= (uint32_t) encodeOne3(*pcm++, &predSample, &index) << (i * 3);
+    }
+
+    for (size_t i = 0; i < (k * 3 + 7) / 8; i++)
+    {
+      *out++ = (uint8_t) (word >> (i * 8));
+    }
+
+    n -= k;
+  }
+
+  st->sample = (int16_t) predSample;
+  st->index = (uint8_t) index;
+}
+
+void adpcm3DecodeBlock(const uint8_t *in, size_t n, int16_t *pcm,
+                       AdpcmState_t *st)
+{
+  int predSample = st->sample;
+  int index = st->index;
+
+  while (n)
+  {
+    size_t k = n < ADPCM3_GROUP_SAMPLES ? n : ADPCM3_GROUP_SAMPLES;
+    uint32_t word = 0;
+
+    for (size_t i = 0; i < (k * 3 + 7) / 8; i++)
+    {
+      word |= (uint32_t) (*in++) << (i * 8);
+    }
+
+    for (size_t i = 0; i < k; i++)
+    {
+      *pcm++ = (int16_t) decodeOne3((word >> (i * 3)) & 7, &predSample,
+                                    &index);
+    }
+
+    n -= k;
+  }
+
+  st->sample = (int16_t) predSample;
+  st->index = (uint8_t) index;
+}
+
+void adpcm3AdvanceState(const uint8_t *in, size_t n, AdpcmState_t *st)
+{
+  int predSample = st->sample;
+  int index = st->index;
+
+  while (n)
+  {
+    size_t k = n < ADPCM3_GROUP_SAMPLES ? n : ADPCM3_GROUP_SAMPLES;
+    uint32_t word = 0;
+
+    for (size_t i = 0; i < (k * 3 + 7) / 8; i++)
+    {
+      word |= (uint32_t) (*in++) << (i * 8);
+    }
+
+    for (size_t i = 0; i < k; i++)
+    {
+      decodeOne3((word >> (i * 3)) & 7, &predSample, &index);
+    }
+
+    n -= k;
+  }
+
+  st->sample = (int16_t) predSample;
+  st->index = (uint8_t) index;
+}
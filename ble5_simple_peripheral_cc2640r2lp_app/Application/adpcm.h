@@ -0,0 +1,70 @@
+/*
+ * adpcm.h
+ */
+
+#ifndef APPLICATION_ADPCM_H_
+#define APPLICATION_ADPCM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * IMA ADPCM codec state. The same 4-byte layout is stored in sector header
+ * (offset 92), so keep it packed. format is not touched by the codec, it
+ * carries the sector format (see audio.h) along with the state.
+ */
+typedef struct __attribute__ ((__packed__)) AdpcmState
+{
+  int16_t sample;
+  uint8_t index;
+  uint8_t format;
+} AdpcmState_t;
+
+_Static_assert(sizeof(AdpcmState_t)==4, "wrong size of adpcm state");
+
+/*
+ * Reference codec, derived from Microchip AN643.
+ */
+char adpcmEncoder(short sample, int16_t *prevSample, uint8_t *prevIndex);
+short adpcmDecoder(char code, int16_t *prevSample, uint8_t *prevIndex);
+
+/*
+ * Table-driven encoder without data-dependent branches. Output (code and
+ * state) is bit-exact with adpcmEncoder().
+ */
+char adpcmEncoderFast(short sample, int16_t *prevSample, uint8_t *prevIndex);
+
+/*
+ * Block codec. n is the number of samples, two codes are packed into one
+ * byte, low nibble first. The state is loaded once and written back once.
+ * Output is bit-exact with calling adpcmEncoder() / adpcmDecoder() per
+ * sample. If n is odd, the high nibble of the last byte is left zero
+ * (encode) or ignored (decode).
+ */
+void adpcmEncodeBlock(const int16_t *pcm, size_t n, uint8_t *out,
+                      AdpcmState_t *st);
+void adpcmDecodeBlock(const uint8_t *in, size_t n, int16_t *pcm,
+                      AdpcmState_t *st);
+
+/*
+ * Advance decoder state over n samples without producing pcm output. The
+ * resulting state equals the one left by adpcmDecodeBlock() on same input.
+ */
+void adpcmAdvanceState(const uint8_t *in, size_t n, AdpcmState_t *st);
+
+/*
+ * 3-bit IMA ADPCM variant, sign bit plus 2 magnitude bits, using the same
+ * step size table. Eight codes are packed into 3 bytes, first code in the
+ * least significant bits. n should be a multiple of 8; otherwise the last
+ * group is packed into (n % 8 * 3 + 7) / 8 bytes.
+ */
+#define ADPCM3_GROUP_SAMPLES              8
+#define ADPCM3_GROUP_SIZE                 3
+
+void adpcm3EncodeBlock(const int16_t *pcm, size_t n, uint8_t *out,
+                       AdpcmState_t *st);
+void adpcm3DecodeBlock(const uint8_t *in, size_t n, int16_t *pcm,
+                       AdpcmState_t *st);
+void adpcm3AdvanceState(const uint8_t *in, size_t n, AdpcmState_t *st);
+
+#endif /* APPLICATION_ADPCM_H_ */
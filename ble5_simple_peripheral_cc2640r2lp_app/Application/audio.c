@@ -44,6 +44,8 @@
 #include "simple_peripheral.h"
 #include "button.h"
 
+#include "adpcm.h"
+#include "vad.h"
 #include "audio.h"
 
 
@@ -57,7 +59,9 @@
  *
  * There is a strictly incremental MONOTONIC_COUNTER implemented using
  * "bit-creeping" trick and consumes last two sectors. This counter records
- * how much data sectors have been written.
+ * how much data sectors have been written. It is written every
+ * COUNTER_STRIDE sectors and on stop; at mount, the sectors completed after
+ * it are found by their headers (recPos).
  *
  * Since the data sectors are used as cyclic array, it is possible the
  * sector index is larger than DATA_SECT_COUNT. So each sector saves its
@@ -66,11 +70,19 @@
  * Each sector stores exactly 4000 bytes in adpcm format, which counts for
  * 8000 samples.
  *
- * Each sector also has a 96-byte header, consisting of 21 sect indices,
- * a magic number (4 bytes), a currSect (4 bytes), and an adpcm state (4 bytes).
- * The last sect index is nextSect, which is technically redundant. But
- * this is convenient for data storing and retrieving. The 21 sect indices
- * are interpretted as 20 segments [start, end).
+ * Each sector also has a 96-byte header: the fill length of a sector
+ * committed on stop (4 bytes), 80 free bytes left blank, recStart (4
+ * bytes), recPos (4 bytes), and the adpcm state at sector start (4 bytes).
+ *
+ * Finished recordings are appended to a journal in the reserved sectors
+ * (start, end, flags, uptime), JOURNAL_SECT_NUM sectors holding thousands
+ * of entries, queried page by page with IMT_LIST_RECS. When it runs out of
+ * sectors the oldest are compacted, see journalReclaim().
+ *
+ * With USE_VAD defined, runs of silence starting at a sector boundary are
+ * not encoded. They are collapsed into a single marker sector, with
+ * FMT_SILENCE set in header format and the number of silent samples
+ * (uint32_t) at the beginning of the data area, so the timeline is kept.
  *
  */
 
@@ -108,7 +120,64 @@
 #endif
 
 /* The higher the sampling frequency, the less time we have to process the data, but the higher the sound quality. */
-#define SAMPLE_RATE                       16000   /* Supported values: 8kHz, 16kHz, 32kHz and 44.1kHz */
+#define SAMPLE_RATE(fmt)                  (((fmt) & FMT_8KHZ) ? 8000 : 16000)   /* Supported values: 8kHz, 16kHz, 32kHz and 44.1kHz */
+
+/*
+ * monotonic counter is written every COUNTER_STRIDE sectors (bits in one
+ * write), the sectors after it are recovered from headers at mount.
+ */
+#ifndef COUNTER_STRIDE
+#define COUNTER_STRIDE                    16
+#endif
+
+/*
+ * Outgoing messages in flight between audio and ble task. The stack queues
+ * up to MAX_NUM_PDU notifications per connection event, one message only
+ * allows one per round trip through freeOutgoingMsg().
+ */
+#ifndef OUTGOING_MSG_NUM
+#define OUTGOING_MSG_NUM                  4
+#endif
+
+/*
+ * readPrefetch() fills the read-ahead cache while the read loop waits for
+ * the ble task, 0 fills it on demand only.
+ */
+#ifndef READ_PREFETCH
+#define READ_PREFETCH                     1
+#endif
+
+/*
+ * v2 packets take their data from the read-ahead cache when not recording,
+ * 0 has the ble task read each packet's data from flash (as before).
+ */
+#ifndef READ_CACHE_V2
+#define READ_CACHE_V2                     1
+#endif
+
+/*
+ * mountMarkedBits() binary-searches the counter sectors at boot, 0 scans
+ * them whole (as before).
+ */
+#ifndef COUNTER_MOUNT_SEARCH
+#define COUNTER_MOUNT_SEARCH              1
+#endif
+
+/*
+ * Settings are a log of records (loadSettings()), 0 erases the settings
+ * sector and rewrites all of them at each change (as before).
+ */
+#ifndef SETTINGS_LOG
+#define SETTINGS_LOG                      1
+#endif
+
+/*
+ * writeChunk() stages chunks into full flash pages, 0 programs each chunk
+ * at its offset (as before).
+ */
+#ifndef STAGE_PAGES
+#define STAGE_PAGES                       1
+#endif
 
 #define AUDIO_PCM_EVT                     Event_Id_00
 #define AUDIO_START_REC                   Event_Id_01
@@ -124,6 +193,10 @@
 #define UPDATE_DUR_05                     Event_Id_10
 #define UPDATE_DUR_10                     Event_Id_11
 #define UPDATE_DUR_15                     Event_Id_12
+#define UPDATE_CODEC_3                    Event_Id_13
+#define UPDATE_CODEC_4                    Event_Id_14
+#define UPDATE_RATE_08                    Event_Id_15
+#define UPDATE_RATE_16                    Event_Id_16
 
 #define AUDIO_REC_AUTOSTOP                Event_Id_31 // used for debugging
 
@@ -131,7 +204,8 @@
   (AUDIO_PCM_EVT | AUDIO_START_REC | AUDIO_STOP_REC | AUDIO_READ_EVT | \
    UART_TX_RDY_EVT | UART_RX_RDY_EVT | AUDIO_INCOMING_MSG | AUDIO_OUTGOING_MSG | \
    AUDIO_REC_AUTOSTOP | AUDIO_BLE_SUBSCRIBE | AUDIO_BLE_UNSUBSCRIBE | \
-   UPDATE_DUR_05 | UPDATE_DUR_10 | UPDATE_DUR_15 )
+   UPDATE_DUR_05 | UPDATE_DUR_10 | UPDATE_DUR_15 | \
+   UPDATE_CODEC_3 | UPDATE_CODEC_4 | UPDATE_RATE_08 | UPDATE_RATE_16 )
 
 #define FLASH_SIZE                        nvsAttrs.regionSize
 #define SECT_SIZE                         nvsAttrs.sectorSize
@@ -142,42 +216,79 @@
 #define LOSECT_INDEX                      (SECT_COUNT - 2)
 #define LOSECT_OFFSET                     (LOSECT_INDEX * SECT_SIZE)
 
-#define DUR_SECT_INDEX                    (SECT_COUNT - 3)  // store single byte duration
-#define DUR_SECT_OFFSET                   (DUR_SECT_INDEX * SECT_SIZE)
+/*
+ * settings log, two sectors used in turn, see loadSettings()
+ */
+#define SETTINGS_SECT_INDEX               (SECT_COUNT - 3)
+#define SETTINGS_ALT_SECT_INDEX           (SECT_COUNT - 4)
+#define SETTINGS_SECT_OFFSET(k)           (((k) ? SETTINGS_ALT_SECT_INDEX : SETTINGS_SECT_INDEX) * SECT_SIZE)
+#define SETTINGS_MAGIC                    0x53  // header record key
+#define SETTINGS_RECORD_SIZE              4
+#define SETTINGS_KEY_NUM                  8     // room for later settings
+
+#define SETTING_DURATION                  0
+#define SETTING_CODEC                     1
+#define SETTING_RATE                      2
+
+#define JOURNAL_SECT_INDEX                (SECT_COUNT - 16) // first of journal
+#define JOURNAL_SECT_NUM                  12
+#define JOURNAL_PER_SECT                  (SECT_SIZE / sizeof(RecEntry_t) - 1)
+#define JOURNAL_SECT_OFFSET(s)            ((JOURNAL_SECT_INDEX + (s)) * SECT_SIZE)
 
 #define DATA_SECT_COUNT                   (SECT_COUNT - 16)
 
+/*
+ * data sectors are erased ahead of recPos one at a time, when the task is
+ * idle, or while recording when no pcm buffer waits, see eraseAhead().
+ * ERASE_AHEAD_SECTORS is a few seconds of audio (8 sectors, 4 s at 16 kHz
+ * 4-bit), not a whole recording, so that idle does not wipe history.
+ */
+#define ERASE_AHEAD_TIMEOUT               (20 * 1000 / Clock_tickPeriod)
+#ifndef ERASE_AHEAD_SECTORS
+#define ERASE_AHEAD_SECTORS               8
+#endif
+
 #define SECT_OFFSET(index)                (index * SECT_SIZE)
 
-// #define MAX_RECORDING_SECTORS             (uint32_t)(-1)
-#define MAX_RECORDING_SECTORS             ((uint32_t)(simpleProfileChar2) * 60 * 2)
+/*
+ * auto stop at the first sector boundary at or after the duration (minutes)
+ */
+#define MAX_RECORDING_SAMPLES(fmt)        ((uint32_t)(simpleProfileChar2) * 60 * SAMPLE_RATE(fmt))
 
 /*
  * monotonic counter is used to record sectors used.
  */
 #define MONOTONIC_COUNTER                 ((((uint32_t)(markedBitsHi >> 1) - 1) << 15) + (uint32_t)(markedBitsLo - 1))
+#define COUNTER_CHUNK_SIZE                256   // counter sector scan unit
 
 /*********************************************************************
  * TYPEDEFS
  */
-#define ADPCMBUF_SIZE                     40
-#define ADPCMBUF_NUM                      4
+#define ADPCMBUF_SIZE                     40    // one pcm buf in 4-bit format
 #define PCMBUF_SIZE                       (ADPCMBUF_SIZE * 4)
 #define PCM_SAMPLES_PER_BUF               (PCMBUF_SIZE / sizeof(int16_t))
-#define PCMBUF_NUM                        6
+/*
+ * 16 buffers are 80 ms at 16 kHz: the i2s queue covers a sector erase
+ * (typ. 45 ms) in the pcm path, see eraseAhead().
+ */
+#define PCMBUF_NUM                        16
 #define PCMBUF_TOTAL_SIZE                 (PCMBUF_SIZE * PCMBUF_NUM)
 
-#define ADPCM_SIZE_PER_SECT               4000
-#define ADPCM_BUF_COUNT_PER_SECT          (ADPCM_SIZE_PER_SECT / ADPCMBUF_SIZE)
+#define READ_AHEAD_SIZE                   (PCMBUF_TOTAL_SIZE / 2) // per half
 
-typedef struct __attribute__ ((__packed__)) AdpcmState
-{
-  int16_t sample;
-  uint8_t index;
-  uint8_t dummy;
-} AdpcmState_t;
+#define FLASH_PAGE_SIZE                   256   // nor page program unit
+#define SECT_HEADER_SIZE                  96
+#define ADPCM_CHUNK_SIZE                  BADPCM_DATA_SIZE
+#define ADPCM_CHUNKS_PER_SECT             25
+#define ADPCM_SIZE_PER_SECT               (ADPCM_CHUNK_SIZE * ADPCM_CHUNKS_PER_SECT)
 
-_Static_assert(sizeof(AdpcmState_t)==4, "wrong size of adpcm state");
+/*
+ * Fill length of a sector committed on stop, { fill, ~fill } in 16-bit
+ * halves, at header offset 0, left blank when the header is written.
+ * Blank (or any value not checking) means a full sector.
+ */
+#define SECT_FILL_SIZE                    sizeof(uint32_t)
+#define SECT_FREE_SIZE                    80    // blank, after fill length
 
 typedef struct ctx
 {
@@ -186,47 +297,37 @@ typedef struct ctx
    * The remaining 24 chunks are 160 bytes each.
    * 1. 256 + 24 * 160 = 4096.
    * 2. 25 * 160 = 4000 (adpcm data, exactly 0.5s for 16000 sample rate)
+   * 3. in 3-bit format, each chunk holds 424 samples, 159 bytes plus one
+   *    pad byte, 10600 samples (0.6625s) per sector.
+   * 4. at 8000 sample rate, a sector holds twice the time (1s or 1.325s).
    */
 
   /*
-   * There are 21 previous and 1 current segments.
-   *
-   *        A0      A1      A2      A3      A4
-   *        ....
-   *        0xffff  0xffff  0xffff  0xffff
-   *        0xffff  0xffff  0xffff  0xffff
-   *        0xffff  0xffff  0xffff  0xffff
-   * -------------------------------------------------------------------------
-   * start  0x0000  0x0000  0x0000  0x0000
-   * pos    0x0000  0x0001  0x0002  0x0003
-   *
-   *                0xffff          0xffff  0xffff
-   *                0xffff          0xffff  0xffff
-   *                0x0000          0x0000  0xffff
-   * -------------------------------------------------------------------------
-   * start          0x0001          0x0003  0x0003
-   * pos            0x0001          0x0003  0x0004
-   *
-   *                B1              B3      B4 (running)
-   *
-   * The initial state is A0. When A1 starts, the snapshot of A0 is saved in
-   * sector 0. Similarly, if the recording continues, A1 will be written into
-   * sector 1.
-   *
-   * If the recording stops at sector 1. stopRecording() should shift-up all
-   * segment starts by one cell, which means, prevs[last] = curr; the both
-   * current start and current pos are assigned to current sector index.
+   * Header: fill length (written on stop) and free bytes stay 0xff here, so
+   * that writing the header leaves them blank.
    */
-  uint32_t recordings[NUM_RECS];
+  uint8_t sectFill[SECT_FILL_SIZE];
+  uint8_t sectFree[SECT_FREE_SIZE];
   uint32_t recStart;
   uint32_t recPos;
   AdpcmState_t recAdpcmStateInSect;                  // sector-wise adpcm state
 
-  uint8_t adpcmBuf[ADPCMBUF_NUM][ADPCMBUF_SIZE];
+  uint8_t adpcmBuf[ADPCM_CHUNK_SIZE];
   uint8_t pcmBuf[PCMBUF_TOTAL_SIZE];
   AdpcmState_t recAdpcmState;
-  uint32_t recAdpcmCount;
-  uint32_t recAdpcmCountInSect;
+  uint32_t recAdpcmCount;                            // pcm bufs encoded
+  uint32_t recChunkSamples;                          // samples in adpcmBuf
+  AdpcmState_t recChunkState;                        // state at chunk start
+  uint32_t recChunkInSect;
+  uint32_t recSamples;                               // timeline, incl. silence
+  uint32_t eraseFront;                               // [recPos, eraseFront) erased
+  uint8_t pageBuf[FLASH_PAGE_SIZE];                  // staged chunks, page 1-15
+  uint32_t pageFill;
+  uint32_t pageInSect;
+#ifdef USE_VAD
+  uint32_t recSilentSamples;                         // pending silence marker
+  VadState_t vad;
+#endif
 
   I2S_Transaction i2sTransaction[PCMBUF_NUM];
   List_List recordingList;
@@ -236,15 +337,56 @@ typedef struct ctx
   uint32_t readStart;
   uint32_t readEnd;
   uint32_t readPosMajor;
-  uint32_t readPosMinor;
+  uint32_t readPosMinor;                             // byte offset in v2
+  uint32_t readEndMinor;                             // packet index, exclusive
+  uint32_t readFill;                                 // data bytes in sector
   AdpcmState_t readAdpcmState;
 
   bool reading;
+  bool readV2;
+  bool readStatePending;                             // v2 state after seek
+
+  /*
+   * multi-range read, ranges are read one after another, each preceded by
+   * a range marker packet. count 0 for single range read.
+   */
+  uint32_t readRanges[READ_RANGES_MAX][2];
+  uint8_t readRangeCount;
+  uint8_t readRangeIndex;
+  bool readRangeMarker;                              // marker pending
+
+  /*
+   * read-ahead cache, two halves of pcmBuf when not recording. Half k holds
+   * flash range [readCacheOffset[k], readCacheOffset[k] + readCacheLen[k]),
+   * len 0 is invalid. readCacheNext is the half to fill next.
+   */
+  uint32_t readCacheOffset[2];
+  uint32_t readCacheLen[2];
+  uint8_t readCacheNext;
+
+  /*
+   * credit mode, packets are only sent against credits granted by client.
+   * ack is the resume point, i.e. the first (major, minor) not delivered,
+   * in range ackRange of a multi-range read (0 otherwise).
+   */
+  bool creditMode;
+  uint32_t credits;
+  bool resumable;
+  uint8_t ackRange;
+  uint32_t ackMajor;
+  uint32_t ackMinor;
+
+  /*
+   * live monitor, each chunk is sent as soon as encoded, or dropped if
+   * the link falls behind.
+   */
+  bool monitoring;
+  uint32_t monitorDrops;
 
   bool subscriptionOn;
 } ctx_t;
 
-_Static_assert(offsetof(ctx_t, adpcmBuf)==96,
+_Static_assert(offsetof(ctx_t, adpcmBuf)==SECT_HEADER_SIZE,
                "wrong write context (header) layout");
 
 _Static_assert(offsetof(ctx_t, pcmBuf)==256,
@@ -309,17 +451,24 @@ extern Display_Handle    dispHandle;
 
 Event_Handle audioEvent;
 
-OutgoingMsg_t outmsg[1];
+OutgoingMsg_t outmsg[OUTGOING_MSG_NUM];
 IncomingMsg_t inmsg[2];
 
 static Semaphore_Handle semOutgoingMsgFreed;
+static Semaphore_Handle semSectorErase;      // held across data sector erase
 static List_List freeOutgoingMsgs;
 
+#define DEFAULT_ATT_MTU                   23
+
+static volatile uint16_t attMtu = DEFAULT_ATT_MTU;
+
 // static Semaphore_Handle semIncomingMsgPending;
 static List_List pendingIncomingMsgs;
 static List_List freeIncomingMsgs;
 
 extern uint8_t simpleProfileChar2;
+extern uint8_t simpleProfileChar3;
+extern uint8_t simpleProfileChar4;
 
 /*********************************************************************
  * LOCAL VARIABLES
@@ -327,21 +476,6 @@ extern uint8_t simpleProfileChar2;
 
 /* @formatter:off */
 
-/* Table of index changes */
-const static signed char IndexTable[16] = { -1, -1, -1, -1, 2, 4, 6, 8,
-                                            -1, -1, -1, -1, 2, 4, 6, 8, };
-
-/* Quantizer step size lookup table */
-const static int StepSizeTable[89] = { 7, 8, 9, 10, 11, 12, 13, 14, 16, 17,
-                                       19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
-                                       50, 55, 60, 66, 73, 80, 88, 97, 107, 118,
-                                       130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
-                                       337, 371, 408, 449, 494, 544, 598, 658, 724, 796,
-                                       876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
-                                       2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358,
-                                       5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
-                                       15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767 };
-
 /* Used for calculating bitmap for monotonic counter */
 static const uint8_t markedBytes[8] = { 0x7f, 0x3f, 0x1f, 0x0f, 0x07, 0x03, 0x01,
                                         0x00 };
@@ -373,6 +507,36 @@ NVS_Attrs nvsAttrs;
  */
 int markedBitsLo = -1;
 int markedBitsHi = -1;
+static uint32_t counterBytesRead;                   // spi bytes read at mount
+
+/*
+ * settings log state, values are 0xff if never set
+ */
+static uint8_t settingsVal[SETTINGS_KEY_NUM];
+#if SETTINGS_LOG
+static int settingsSect;                            // 0 or 1
+static uint8_t settingsGen;
+static size_t settingsFill;                         // next record offset
+#endif
+static uint32_t settingsErases;
+
+/*
+ * recording journal, the sectors in use in seq order (journalOrder), each
+ * with journalFill entries after its header. Entries are in time order,
+ * start and end increase, so lookup by sector is a binary search. Appends
+ * go to the last sector while journalOpen.
+ */
+static uint8_t journalOrder[JOURNAL_SECT_NUM];
+static uint32_t journalSects;
+static uint16_t journalFill[JOURNAL_SECT_NUM];
+static uint32_t journalSeq[JOURNAL_SECT_NUM];       // header seq
+static uint32_t journalSeqEnd[JOURNAL_SECT_NUM];
+static uint32_t journalNextSeq;
+static bool journalOpen;
+static uint32_t journalCount;
+static uint32_t journalDropped;                     // live, journal full
+
+static uint32_t eraseLate;                          // not erased ahead
 
 ctx_t ctx = { };
 
@@ -397,25 +561,62 @@ static void readCallbackFxn(I2S_Handle handle, int_fast16_t status,
 static void uartWriteCallbackFxn(UART_Handle handle, void *buf, size_t count);
 #endif
 
-static char adpcmEncoder(short sample, int16_t *prevSample, uint8_t *prevIndex);
-static short adpcmDecoder(char code, int16_t* prevSample, uint8_t *prevIndex);
 void checksum(void *p, uint32_t len, uint8_t *a, uint8_t *b);
 
 // extern void simple_peripheral_spin(void);
 
 static int countMarkedBits(int sectIndex, size_t size);
+static int mountMarkedBits(int sectIndex, size_t size);
 static void incrementMarkedBits(int sectIndex, size_t current);
 static void resetLowCounter(void);
 static void resetCounter(void);
 static uint32_t readMagic(void);
 static void loadCounter(void);
 static void incrementCounter(void);
-
-static void loadRecordings(void);
+static void syncCounter(uint32_t target);
+static int recountMarkedBits(int first, int last);
+static bool sectorComplete(uint32_t pos);
+
+static void journalMount(void);
+static void journalAppend(RecEntry_t *entry);
+static void journalReclaim(void);
+static size_t journalOffset(uint32_t i);
+static uint32_t journalFind(uint32_t sector);
+static bool sendRecsMsg(uint32_t sector);
 static void sendStatusMsg(void);
 
 static void startRecording(void);
 static void stopRecording(void);
+static void fillBadpcmV2(OutgoingMsg_t *outmsg, bool silence);
+static void advanceReadState(const uint8_t *data);
+static void readFlash(size_t offset, void *buf, size_t len);
+static const uint8_t *readCacheV2(size_t offset, size_t len);
+static size_t readV2Size(bool state);
+static void readPrefetch(void);
+static void seekRead(uint32_t major, uint32_t minor, uint8_t *scratch);
+static void loadReadHeader(size_t offset);
+static uint32_t sectFill(uint32_t marker);
+static void writeSectFill(uint32_t pos, uint32_t fill);
+static void startReadRange(void);
+static bool ackInRead(uint8_t range, uint32_t major, uint32_t minor);
+static bool readPastEnd(void);
+static bool nextReadRange(void);
+static void writeChunk(void);
+static void monitorChunk(void);
+static void flushPage(void);
+static void nextSector(void);
+static bool outgoingMsgInFlight(OutgoingMsg_t *msg);
+static bool sectorInFlight(uint32_t pos);
+static bool eraseAhead(void);
+static void ensureErased(void);
+#ifdef USE_VAD
+static void writeSilence(void);
+#endif
+static void loadSettings(void);
+static void saveSetting(uint8_t key, uint8_t value);
+#if SETTINGS_LOG
+static void compactSettings(void);
+#endif
 
 void Audio_subscribe(void)
 {
@@ -427,6 +628,63 @@ void Audio_unsubscribe(void)
   Event_post(audioEvent, AUDIO_BLE_UNSUBSCRIBE);
 }
 
+/*
+ * called from ble task, mtu is per connection, reset to default when link
+ * terminated.
+ */
+void Audio_updateMtu(uint16_t mtu)
+{
+  attMtu = mtu;
+}
+
+/*
+ * Copy a message into notification buffer (ble task), returns the length
+ * to send, 0 if it does not fit. For v2 packets the data is copied from
+ * the read-ahead cache, or read from flash here. eraseAhead() does not
+ * erase a sector with v2 packets in flight, but a recording overwrites the
+ * oldest sector regardless (see ensureErased()); the read and the
+ * staleness check hold semSectorErase, which eraseSector() holds across
+ * the erase, so a packet whose sector was overwritten before it was sent
+ * is always marked BADPCM_V2_STALE. startRecording() drops nvsCache under
+ * it too, before pcmBuf goes to i2s.
+ */
+size_t readOutgoingMsg(OutgoingMsg_t *msg, uint8_t *buf, size_t len)
+{
+  if (msg->type == OMT_BADPCM_V2)
+  {
+    size_t hdr = msg->len - msg->nvsLen;
+    size_t n = msg->nvsLen;
+    if (hdr > len)
+    {
+      return 0;     // should not happen, packet is sized by mtu
+    }
+    if (hdr + n > len)
+    {
+      n = len - hdr;
+    }
+    memcpy(buf, msg->raw, hdr);
+
+    Semaphore_pend(semSectorErase, BIOS_WAIT_FOREVER);
+    if (msg->nvsCache)
+    {
+      memcpy(buf + hdr, msg->nvsCache, n);
+    }
+    else
+    {
+      NVS_read(nvsHandle, msg->nvsOffset, buf + hdr, n);
+    }
+    if (msg->bad2.major + DATA_SECT_COUNT < ctx.eraseFront)
+    {
+      buf[offsetof(BadpcmPacketV2_t, format)] |= BADPCM_V2_STALE;
+    }
+    Semaphore_post(semSectorErase);
+    return hdr + n;
+  }
+
+  memcpy(buf, msg->raw, len);
+  return len;
+}
+
 void freeOutgoingMsg(OutgoingMsg_t *msg)
 {
   List_put(&freeOutgoingMsgs, (List_Elem*)msg);
@@ -486,6 +744,10 @@ static void Audio_init(void)
   semParams.eventId = AUDIO_OUTGOING_MSG;
   semOutgoingMsgFreed = Semaphore_create(1, &semParams, Error_IGNORE);
 
+  Semaphore_Params_init(&semParams);
+  semParams.mode = Semaphore_Mode_BINARY;
+  semSectorErase = Semaphore_create(1, &semParams, Error_IGNORE);
+
   List_clearList(&freeIncomingMsgs);
   List_put(&freeIncomingMsgs, (List_Elem*)&inmsg[0]);
   List_put(&freeIncomingMsgs, (List_Elem*)&inmsg[1]);
@@ -493,8 +755,10 @@ static void Audio_init(void)
   List_clearList(&pendingIncomingMsgs);
 
   List_clearList(&freeOutgoingMsgs);
-  List_put(&freeOutgoingMsgs, (List_Elem*)&outmsg[0]);
-  // List_put(&freeOutgoingMsgs, (List_Elem*)&outmsg[1]);
+  for (int i = 0; i < OUTGOING_MSG_NUM; i++)
+  {
+    List_put(&freeOutgoingMsgs, (List_Elem*)&outmsg[i]);
+  }
 
 #if defined (LOG_ADPCM_DATA) || defined (LOG_BADPCM_DATA)
   Semaphore_Params_init(&semParams);
@@ -548,23 +812,18 @@ static void Audio_taskFxn(UArg a0, UArg a1)
   loadCounter();
   Display_print1(dispHandle, 0xff, 0, "counter     : %08x", MONOTONIC_COUNTER);
 
-  loadRecordings();
-  Display_print5(dispHandle, 0xff, 0, "recordings  : %08x %08x %08x %08x %08x",
-                 ctx.recordings[0], ctx.recordings[1], ctx.recordings[2],
-                 ctx.recordings[3], ctx.recordings[4]);
-  Display_print5(dispHandle, 0xff, 0, "              %08x %08x %08x %08x %08x",
-                 ctx.recordings[5], ctx.recordings[6], ctx.recordings[7],
-                 ctx.recordings[8], ctx.recordings[9]);
-  Display_print5(dispHandle, 0xff, 0, "              %08x %08x %08x %08x %08x",
-                 ctx.recordings[10], ctx.recordings[11], ctx.recordings[12],
-                 ctx.recordings[13], ctx.recordings[14]);
-  Display_print5(dispHandle, 0xff, 0, "              %08x %08x %08x %08x %08x",
-                 ctx.recordings[15], ctx.recordings[16], ctx.recordings[17],
-                 ctx.recordings[18], ctx.recordings[19]);
-  Display_print1(dispHandle, 0xff, 0, "              %08x", ctx.recordings[20]);
+  memset(ctx.sectFill, 0xff, SECT_FILL_SIZE);
+  memset(ctx.sectFree, 0xff, SECT_FREE_SIZE);
+  ctx.recStart = MONOTONIC_COUNTER;
+  ctx.recPos = MONOTONIC_COUNTER;
+
+  journalMount();
   Display_print1(dispHandle, 0xff, 0, "restart     : %08x", ctx.recStart);
   Display_print1(dispHandle, 0xff, 0, "recPos      : %08x", ctx.recPos);
 
+  // nothing is known to be erased, including recPos
+  ctx.eraseFront = ctx.recPos;
+
   if (recordingState)
   {
     Event_post(audioEvent, AUDIO_START_REC);
@@ -573,10 +832,22 @@ static void Audio_taskFxn(UArg a0, UArg a1)
   for (int loop = 0;; loop++)
   {
     // Display_print0(dispHandle, 0xff, 0, "before event");
-    uint32_t event = Event_pend(audioEvent, NULL, AUDIO_EVENTS,
-                                BIOS_WAIT_FOREVER);
+    uint32_t event = Event_pend(
+        audioEvent, NULL, AUDIO_EVENTS,
+        !ctx.recording
+            && ctx.eraseFront < ctx.recPos + 1 + ERASE_AHEAD_SECTORS ?
+            ERASE_AHEAD_TIMEOUT : BIOS_WAIT_FOREVER);
     // Display_print0(dispHandle, 0xff, 0, "after event");
 
+    /*
+     * Timed out, nothing to do for ERASE_AHEAD_TIMEOUT, erase one sector.
+     * While recording this is done in the pcm path.
+     */
+    if (event == 0)
+    {
+      eraseAhead();
+    }
+
 
     if (event & BTN_SHUTDOWN_EVT)
     {
@@ -593,8 +864,28 @@ static void Audio_taskFxn(UArg a0, UArg a1)
 
       Display_print1(dispHandle, 0xff, 0, "set duration: %d", dur);
 
-      NVS_erase(nvsHandle, DUR_SECT_OFFSET, SECT_SIZE);
-      NVS_write(nvsHandle, DUR_SECT_OFFSET, &dur, 1, NVS_WRITE_POST_VERIFY);
+      simpleProfileChar2 = dur;
+      saveSetting(SETTING_DURATION, dur);
+    }
+
+    if (event & UPDATE_CODEC_3 || event & UPDATE_CODEC_4)
+    {
+      uint8_t bits = (event & UPDATE_CODEC_3) ? 3 : 4;
+
+      Display_print1(dispHandle, 0xff, 0, "set codec   : %d-bit", bits);
+
+      simpleProfileChar3 = bits;
+      saveSetting(SETTING_CODEC, bits);
+    }
+
+    if (event & UPDATE_RATE_08 || event & UPDATE_RATE_16)
+    {
+      uint8_t khz = (event & UPDATE_RATE_08) ? 8 : 16;
+
+      Display_print1(dispHandle, 0xff, 0, "set rate    : %d kHz", khz);
+
+      simpleProfileChar4 = khz;
+      saveSetting(SETTING_RATE, khz);
     }
 
     if (event & AUDIO_START_REC)
@@ -619,23 +910,82 @@ static void Audio_taskFxn(UArg a0, UArg a1)
         if (ttt != NULL)
         {
 #ifdef LOG_ADPCM_DATA
-          /* save a copy */
+          /* save a copy, logged adpcm is valid for 4-bit format only */
           int16_t uartPrevSample = ctx.recAdpcmState.sample;
           uint8_t uartPrevIndex = ctx.recAdpcmState.index;
+          uint8_t *uartAdpcm = &ctx.adpcmBuf[ctx.recChunkSamples / 2];
 #endif
-          uint16_t adpcmInUse = ctx.recAdpcmCount % ADPCMBUF_NUM;
           int16_t *samples = (int16_t*) ttt->bufPtr;
-          for (int i = 0; i < PCM_SAMPLES_PER_BUF; i++)
+          size_t n = PCM_SAMPLES_PER_BUF;
+          size_t samplesPerChunk = BADPCM_SAMPLES(ctx.recAdpcmState.format);
+
+#ifdef USE_VAD
+          bool voiced = vadProcess(&ctx.vad, samples, n);
+          if (!voiced && ctx.recChunkInSect == 0 && ctx.recChunkSamples == 0)
+          {
+            // silence at sector boundary, nothing encoded or written
+            ctx.recSilentSamples += n;
+            ctx.recSamples += n;
+            n = 0;
+
+            if (ctx.recSamples
+                >= MAX_RECORDING_SAMPLES(ctx.recAdpcmState.format))
+            {
+              writeSilence();
+            }
+          }
+          else if (ctx.recSilentSamples > 0)
+          {
+            writeSilence();
+          }
+#endif
+
+          /*
+           * A pcm buffer may straddle chunks (and sectors) in 3-bit format,
+           * 424 is not a multiple of 80. Both are multiples of 8, so each
+           * piece starts on a 3-byte group.
+           */
+          while (n > 0 && ctx.recording)
           {
-            uint8_t code = adpcmEncoder(samples[i], &ctx.recAdpcmState.sample,
-                                        &ctx.recAdpcmState.index);
-            if (i % 2 == 0)
+            size_t k = samplesPerChunk - ctx.recChunkSamples;
+            if (k > n)
+            {
+              k = n;
+            }
+
+            if (ctx.recChunkSamples == 0)
+            {
+              ctx.recChunkState = ctx.recAdpcmState;
+            }
+
+            if (ctx.recAdpcmState.format & FMT_ADPCM3)
             {
-              ctx.adpcmBuf[adpcmInUse][i / 2] = code;
+              adpcm3EncodeBlock(
+                  samples, k,
+                  &ctx.adpcmBuf[ctx.recChunkSamples / ADPCM3_GROUP_SAMPLES
+                      * ADPCM3_GROUP_SIZE],
+                  &ctx.recAdpcmState);
             }
             else
             {
-              ctx.adpcmBuf[adpcmInUse][i / 2] |= (code << 4);
+              adpcmEncodeBlock(samples, k,
+                               &ctx.adpcmBuf[ctx.recChunkSamples / 2],
+                               &ctx.recAdpcmState);
+            }
+
+            samples += k;
+            n -= k;
+            ctx.recChunkSamples += k;
+            ctx.recSamples += k;
+
+            if (ctx.recChunkSamples == samplesPerChunk)
+            {
+              // queued first, ble task sends while flash is programmed
+              if (ctx.monitoring && ctx.subscriptionOn)
+              {
+                monitorChunk();
+              }
+              writeChunk();
             }
           }
 #ifdef LOG_ADPCM_DATA
@@ -651,7 +1001,7 @@ static void Audio_taskFxn(UArg a0, UArg a1)
 #else
           uartPkt.dummy = 0;
 #endif
-          memcpy(uartPkt.adpcm, ctx.adpcmBuf[adpcmInUse], ADPCMBUF_SIZE);
+          memcpy(uartPkt.adpcm, uartAdpcm, ADPCMBUF_SIZE);
           checksum(&uartPkt.startSect,
                    offsetof(UartPacket_t, cka) - offsetof(UartPacket_t, startSect),
                    &uartPkt.cka, &uartPkt.ckb);
@@ -659,96 +1009,12 @@ static void Audio_taskFxn(UArg a0, UArg a1)
 #endif
           List_put(&ctx.recordingList, (List_Elem*) ttt);
 
-          if (adpcmInUse == ADPCMBUF_NUM - 1)
-          {
-            if (ctx.recAdpcmCountInSect == adpcmInUse)
-            {
-              // uint32_t bufCount = 0;
-              size_t offset = (ctx.recPos % DATA_SECT_COUNT) * SECT_SIZE;
-              size_t size = 96 + ADPCMBUF_SIZE * ADPCMBUF_NUM;
-              NVS_write(nvsHandle, offset, &ctx, size, 0); // NVS_WRITE_POST_VERIFY);
-
-              Display_print5(
-                  dispHandle, 0xff, 0,
-                  " - nvs write, pos 0x%08x, cnt %06d, cntInSect %02d, offset 0x%08x (%%4k %04d), size 256",
-                  ctx.recPos,
-                  ctx.recAdpcmCount,
-                  ctx.recAdpcmCountInSect, offset, offset % 4096);
-            }
-            else
-            {
-              uint32_t writtenBufCount = ctx.recAdpcmCountInSect / ADPCMBUF_NUM
-                  * ADPCMBUF_NUM;
-              size_t offset = (ctx.recPos % DATA_SECT_COUNT) * SECT_SIZE + 96
-                  + writtenBufCount * ADPCMBUF_SIZE;
-              size_t size = ADPCMBUF_SIZE * ADPCMBUF_NUM;
-              NVS_write(nvsHandle, offset, &ctx.adpcmBuf[0], size, 0); // NVS_WRITE_POST_VERIFY);
-
-              Display_print5(
-                  dispHandle, 0xff, 0,
-                  " - nvs write, pos 0x%08x, cnt %06d, cntInSect %02d, offset 0x%08x (%%4k %04d), size 160",
-                  ctx.recPos,
-                  ctx.recAdpcmCount,
-                  ctx.recAdpcmCountInSect, offset, offset % 4096);
-            }
-          }
-
           ctx.recAdpcmCount++;
-          ctx.recAdpcmCountInSect = ctx.recAdpcmCount % ADPCM_BUF_COUNT_PER_SECT;
 
-          // This generates too much output
-          //        Display_print2(dispHandle, 0xff, 0, "-- cnt %d, cntInSect %d",
-          //                       ctx.adpcmCount, ctx.adpcmCountInSect);
-
-          // last adpcm buf in sect
-          if (ctx.recAdpcmCountInSect == 0)
+          // no backlog, the whole i2s queue is ahead of the erase
+          if (ctx.recording && List_empty(&ctx.processingList))
           {
-            ctx.recPos++;
-            ctx.recAdpcmStateInSect = ctx.recAdpcmState;
-            incrementCounter();
-
-//            Display_print4(dispHandle, 0xff, 0,
-//                           "increment sect, pos: %d (%08x), counter %d (%08x)",
-//                           ctx.currPos, ctx.currPos, MONOTONIC_COUNTER,
-//                           MONOTONIC_COUNTER);
-
-            Display_print2(
-                dispHandle, 0xff, 0,
-                "new sector  : pos 0x%08x, counter 0x%08x",
-                ctx.recPos, MONOTONIC_COUNTER);
-
-
-//            Display_print2(dispHandle, 0xff, 0, "start %d ()", ctx.recStart, ctx.recStart);
-//            Display_print2(dispHandle, 0xff, 0, "pos   %d (0x%08x)", ctx.recPos, ctx.recPos);
-//            Display_print2(dispHandle, 0xff, 0, "count %d (0x%08x)", MONOTONIC_COUNTER, MONOTONIC_COUNTER);
-
-            /* it is important to do this here */
-            size_t offset = (ctx.recPos % DATA_SECT_COUNT) * SECT_SIZE;
-            NVS_erase(nvsHandle, offset, SECT_SIZE);
-
-            Display_print2(dispHandle, 0xff, 0,
-                           " - nvs erase,     0x%08x (%%4k %d)", offset,
-                           offset % 4096);
-
-            // great than won't happen in current behavioral definition
-            if (ctx.recPos - ctx.recStart >= MAX_RECORDING_SECTORS)
-            {
-              Display_print2(
-                  dispHandle,
-                  0xff,
-                  0,
-                  "max rec sect reached, before stopRecording(). start 0x%08x, pos 0x%08x",
-                  ctx.recStart, ctx.recPos);
-              stopRecording();
-              Display_print2(
-                  dispHandle,
-                  0xff,
-                  0,
-                  "                      after  stopRecording(). start 0x%08x, pos 0x%08x",
-                  ctx.recStart, ctx.recPos);
-
-              Event_post(audioEvent, AUDIO_REC_AUTOSTOP);
-            }
+            eraseAhead();
           }
         } /* end of if ttt != NULL */
       } /* end of if ctx */
@@ -763,6 +1029,11 @@ static void Audio_taskFxn(UArg a0, UArg a1)
     if (event & AUDIO_BLE_UNSUBSCRIBE)
     {
       ctx.subscriptionOn = false;
+
+      // in-flight packets are lost, resume point (ack) is kept
+      ctx.creditMode = false;
+      ctx.credits = 0;
+      ctx.monitoring = false;
       if (ctx.reading)
       {
         ctx.reading = false;
@@ -781,7 +1052,9 @@ static void Audio_taskFxn(UArg a0, UArg a1)
 
     if (event & AUDIO_OUTGOING_MSG)
     {
-      Semaphore_pend(semOutgoingMsgFreed, 0);
+      // several may be freed in one drain, the free list is what counts
+      while (Semaphore_pend(semOutgoingMsgFreed, 0))
+        ;
     }
 
     if (ctx.subscriptionOn)
@@ -792,6 +1065,8 @@ static void Audio_taskFxn(UArg a0, UArg a1)
         IncomingMsg_t *msg = (IncomingMsg_t*)List_get(&pendingIncomingMsgs);
         if (msg)
         {
+          bool rejected = false;
+
           Display_print1(dispHandle, 0xff, 0, "incoming msg (command) %d", msg->type);
 
           if (msg->type == IMT_START_REC)
@@ -804,23 +1079,144 @@ static void Audio_taskFxn(UArg a0, UArg a1)
             Display_print0(dispHandle, 0xff, 0, "stop recording");
             stopRecording();
           }
-          else if (msg->type == IMT_START_READ)
+          else if (msg->type == IMT_START_READ
+              || msg->type == IMT_START_READ_V2)
           {
             Display_print0(dispHandle, 0xff, 0, "start reading");
             ctx.readStart = msg->start;
             ctx.readEnd = msg->end;
+            ctx.readEndMinor = msg->endMinor;
             ctx.readPosMajor  = ctx.readStart;
             ctx.readPosMinor = 0;
+            ctx.readV2 = msg->type == IMT_START_READ_V2;
+            ctx.readStatePending = false;
+            ctx.readRangeCount = 0;
+            ctx.readRangeIndex = 0;
+            ctx.readRangeMarker = false;
+
+            if (msg->startMinor)
+            {
+              /* free list is not empty in this loop, borrow head as scratch */
+              OutgoingMsg_t *scratch = (OutgoingMsg_t*) List_head(
+                  &freeOutgoingMsgs);
+              seekRead(ctx.readStart,
+                       ctx.readV2 ? msg->startMinor * ADPCM_CHUNK_SIZE :
+                                    msg->startMinor,
+                       scratch->raw);
+            }
+            ctx.reading = true;
+
+            ctx.resumable = true;
+            ctx.ackRange = 0;
+            ctx.ackMajor = ctx.readPosMajor;
+            ctx.ackMinor = ctx.readPosMinor;
+          }
+          else if (msg->type == IMT_START_READ_MULTI)
+          {
+            Display_print1(dispHandle, 0xff, 0, "start reading %d ranges",
+                           msg->count);
+            memcpy(ctx.readRanges, msg->ranges, sizeof(ctx.readRanges));
+            ctx.readRangeCount = msg->count;
+            ctx.readRangeIndex = 0;
+            ctx.readV2 = true;
+            startReadRange();
             ctx.reading = true;
+            ctx.resumable = true;
+            ctx.ackRange = 0;
+            ctx.ackMajor = ctx.readStart;
+            ctx.ackMinor = 0;
+          }
+          else if (msg->type == IMT_LIST_RECS)
+          {
+            rejected = !sendRecsMsg(msg->start);
+          }
+          else if (msg->type == IMT_START_MONITOR)
+          {
+            Display_print0(dispHandle, 0xff, 0, "start monitor");
+            ctx.monitoring = true;
+            ctx.monitorDrops = 0;
+          }
+          else if (msg->type == IMT_STOP_MONITOR)
+          {
+            Display_print1(dispHandle, 0xff, 0, "stop monitor, %d dropped",
+                           ctx.monitorDrops);
+            ctx.monitoring = false;
           }
           else if (msg->type == IMT_STOP_READ)
           {
             Display_print0(dispHandle, 0xff, 0, "stop reading");
             ctx.reading = false;
           }
+          else if (msg->type == IMT_GRANT)
+          {
+            ctx.creditMode = true;
+            ctx.credits += msg->start;
+          }
+          else if (msg->type == IMT_ACK)
+          {
+            uint8_t range = msg->range == ACK_RANGE_CURRENT ?
+                ctx.readRangeIndex : msg->range;
+
+            if (ackInRead(range, msg->start, msg->end))
+            {
+              ctx.ackRange = range;
+              ctx.ackMajor = msg->start;
+              ctx.ackMinor = msg->end;
+            }
+            else
+            {
+              Display_print3(dispHandle, 0xff, 0, "ack %d, %d (range %d) "
+                             "rejected", msg->start, msg->end, range);
+              rejected = true;
+            }
+          }
+          else if (msg->type == IMT_RESUME_READ)
+          {
+            if (ctx.resumable)
+            {
+              Display_print3(dispHandle, 0xff, 0, "resume reading at %d, %d "
+                             "(range %d)", ctx.ackMajor, ctx.ackMinor,
+                             ctx.ackRange);
+
+              // range of the resume point, its marker is sent again
+              if (ctx.readRangeCount)
+              {
+                ctx.readRangeIndex = ctx.ackRange;
+                startReadRange();
+              }
+
+              /* free list is not empty in this loop, borrow head as scratch */
+              OutgoingMsg_t *scratch = (OutgoingMsg_t*) List_head(
+                  &freeOutgoingMsgs);
+              seekRead(ctx.ackMajor, ctx.ackMinor, scratch->raw);
+              ctx.reading = true;
+            }
+          }
           List_put(&freeIncomingMsgs, (List_Elem*)msg);
 
-          sendStatusMsg();
+          /*
+           * flow control messages are not answered, list is its own answer;
+           * a rejected ack is answered with status, which has the read
+           * position, and so is a list the mtu has no room for
+           */
+          if ((msg->type != IMT_GRANT && msg->type != IMT_ACK
+              && msg->type != IMT_LIST_RECS) || rejected)
+          {
+            sendStatusMsg();
+          }
+        }
+        else if (ctx.reading && ctx.readRangeMarker)
+        {
+          OutgoingMsg_t *outmsg = (OutgoingMsg_t*) List_get(&freeOutgoingMsgs);
+          outmsg->type = OMT_RANGE;
+          outmsg->range.version = BADPCM_RANGE;
+          outmsg->range.index = ctx.readRangeIndex;
+          outmsg->range.count = ctx.readRangeCount;
+          outmsg->range.reserved = 0;
+          outmsg->range.start = ctx.readStart;
+          outmsg->range.end = ctx.readEnd;
+          sendOutgoingMsg(outmsg);
+          ctx.readRangeMarker = false;
         }
         else if (ctx.reading)
         {
@@ -830,6 +1226,10 @@ static void Audio_taskFxn(UArg a0, UArg a1)
             {
               if (!ctx.recording)
               {
+                if (nextReadRange())
+                {
+                  continue;
+                }
                 Display_print0(dispHandle, 0xff, 0, "stop (forward) reading when recording stopped.");
                 ctx.reading = false;
                 sendStatusMsg();
@@ -839,8 +1239,12 @@ static void Audio_taskFxn(UArg a0, UArg a1)
           }
           else
           {
-            if (ctx.readPosMajor >= ctx.recStart || ctx.readPosMajor >= ctx.readEnd)
+            if (ctx.readPosMajor >= ctx.recStart || readPastEnd())
             {
+              if (nextReadRange())
+              {
+                continue;
+              }
               Display_print0(dispHandle, 0xff, 0, "stop reading when reaching rec start or read end.");
               ctx.reading = false;
               sendStatusMsg();
@@ -848,15 +1252,24 @@ static void Audio_taskFxn(UArg a0, UArg a1)
             }
           }
 
+          // only data packets take credits, range markers and end do not
+          if (ctx.creditMode && ctx.credits == 0)
+          {
+            break;  // wait for grant
+          }
+
           /*
            * in-range means:
            * upper bound: readPosMajor < recPos
-           * lower bound: readPosMajor + DATA_SECT_COUNT > recPos
+           * lower bound: readPosMajor + DATA_SECT_COUNT >= front, sectors
+           *              in [recPos, front) are erased (or being written)
            */
-          if (!(ctx.readPosMajor + DATA_SECT_COUNT > ctx.recPos))
+          uint32_t front =
+              ctx.eraseFront > ctx.recPos ? ctx.eraseFront : ctx.recPos + 1;
+          if (!(ctx.readPosMajor + DATA_SECT_COUNT >= front))
           {
             // adjusted
-            uint32_t major = ctx.recPos - DATA_SECT_COUNT + 1;
+            uint32_t major = front - DATA_SECT_COUNT;
 
             Display_print2(dispHandle, 0xff, 0, "read major %d adjusted to %d",
                            ctx.readPosMajor, major);
@@ -869,8 +1282,25 @@ static void Audio_taskFxn(UArg a0, UArg a1)
 
           if (ctx.readPosMinor == 0)
           {
-            size_t offset = (ctx.readPosMajor % DATA_SECT_COUNT) * SECT_SIZE + 92;
-            NVS_read(nvsHandle, offset, &ctx.readAdpcmState, sizeof(AdpcmState_t));
+            loadReadHeader((ctx.readPosMajor % DATA_SECT_COUNT) * SECT_SIZE);
+          }
+
+          /*
+           * silence marker is sent as a single packet, data begins with
+           * the number of silent samples (uint32_t), the rest is zero.
+           */
+          bool silence = ctx.readAdpcmState.format & FMT_SILENCE;
+
+          if (ctx.creditMode)
+          {
+            ctx.credits--;
+          }
+
+          if (ctx.readV2)
+          {
+            fillBadpcmV2(outmsg, silence);
+            sendOutgoingMsg(outmsg);
+            continue;
           }
 
           size_t offset = (ctx.readPosMajor % DATA_SECT_COUNT) * SECT_SIZE + 96
@@ -881,19 +1311,28 @@ static void Audio_taskFxn(UArg a0, UArg a1)
               "read offset %d (%08x) @ major %d (%08x) minor %d", offset,
               offset, ctx.readPosMajor, ctx.readPosMajor, ctx.readPosMinor);
 
-          NVS_read(nvsHandle, offset, &outmsg->bad.data[0], BADPCM_DATA_SIZE);
+          if (silence)
+          {
+            memset(outmsg->bad.data, 0, BADPCM_DATA_SIZE);
+            readFlash(offset, &outmsg->bad.data[0], sizeof(uint32_t));
+          }
+          else
+          {
+            readFlash(offset, &outmsg->bad.data[0], BADPCM_DATA_SIZE);
+          }
 
           outmsg->bad.major = ctx.readPosMajor;
-          outmsg->bad.minor = ctx.readPosMinor;
+          outmsg->bad.minor = ctx.readPosMinor
+              | ((ctx.readAdpcmState.format & BADPCM_FMT_MASK)
+                  << BADPCM_FMT_SHIFT);
           outmsg->bad.index = ctx.readAdpcmState.index;
           outmsg->bad.sample = ctx.readAdpcmState.sample;
 
           // update adpcm state for next read
-          for (int i = 0; i < BADPCM_DATA_SIZE; i++)
+          if (!silence)
           {
-            char x = outmsg->bad.data[i];
-            adpcmDecoder(x & 0x0f, &ctx.readAdpcmState.sample, &ctx.readAdpcmState.index);
-            adpcmDecoder((x >> 4) & 0x0f, &ctx.readAdpcmState.sample, &ctx.readAdpcmState.index);
+            // no adpcm data in silence marker, next sector has its own state
+            advanceReadState(outmsg->bad.data);
           }
 
           outmsg->type = OMT_BADPCM;
@@ -915,7 +1354,8 @@ static void Audio_taskFxn(UArg a0, UArg a1)
           sendOutgoingMsg(outmsg);
 
           ctx.readPosMinor++;
-          if (ctx.readPosMinor == 4000 / BADPCM_DATA_SIZE)
+          if (silence || ctx.readPosMinor == ADPCM_CHUNKS_PER_SECT
+              || ctx.readPosMinor * ADPCM_CHUNK_SIZE >= ctx.readFill)
           {
             ctx.readPosMajor++;
             ctx.readPosMinor = 0;
@@ -926,6 +1366,12 @@ static void Audio_taskFxn(UArg a0, UArg a1)
           break;  // no incoming message, no read operation wip
         }
       }
+
+      /*
+       * all outgoing msgs in flight, or waiting for credits, read next
+       * data while ble task is sending.
+       */
+      readPrefetch();
     }
     else  // subscriptionOn == false
     {
@@ -943,7 +1389,10 @@ static void Audio_taskFxn(UArg a0, UArg a1)
 #if defined(LOG_ADPCM_DATA) && defined (LOG_NVS_AFTER_AUTOSTOP)
     if (event & AUDIO_REC_AUTOSTOP)
     {
-      uint32_t start = ctx.recordings[NUM_RECS - 1];
+      RecEntry_t last;
+      NVS_read(nvsHandle, journalOffset(journalCount - 1), &last,
+               sizeof(last));
+      uint32_t start = last.start;
       uint32_t end = ctx.recStart;
       for (uint32_t pos = start; pos != end; pos++)
       {
@@ -981,7 +1430,6 @@ static void Audio_taskFxn(UArg a0, UArg a1)
     }
 #endif
 
-
   } /* end of loop */
 }
 
@@ -994,16 +1442,34 @@ static void startRecording(void)
   ctx.recPos = ctx.recStart;
   ctx.recAdpcmState.sample = 0;
   ctx.recAdpcmState.index = 0;
-  ctx.recAdpcmState.dummy = 0;
+  ctx.recAdpcmState.format = ((simpleProfileChar3 == 3) ? FMT_ADPCM3 : 0)
+      | ((simpleProfileChar4 == 8) ? FMT_8KHZ : 0);
   ctx.recAdpcmStateInSect = ctx.recAdpcmState;
   ctx.recAdpcmCount = 0;
-  ctx.recAdpcmCountInSect = 0;
+  ctx.recChunkSamples = 0;
+  ctx.recChunkInSect = 0;
+  ctx.recSamples = 0;
+  ctx.pageFill = 0;
+  ctx.pageInSect = 0;
+
+  // pcmBuf is taken by i2s, and sectors may be overwritten from now on
+  ctx.readCacheLen[0] = 0;
+  ctx.readCacheLen[1] = 0;
+  Semaphore_pend(semSectorErase, BIOS_WAIT_FOREVER);
+  for (int i = 0; i < OUTGOING_MSG_NUM; i++)
+  {
+    outmsg[i].nvsCache = NULL;
+  }
+  Semaphore_post(semSectorErase);
+#ifdef USE_VAD
+  ctx.recSilentSamples = 0;
+  vadReset(&ctx.vad);
+#endif
 
   ctx.recording = true;
 
-  /** ahead of writing erasure */
-  size_t offset = ctx.recPos % DATA_SECT_COUNT * SECT_SIZE;
-  NVS_erase(nvsHandle, offset, SECT_SIZE);
+  /** ahead of writing erasure, usually done already in idle */
+  ensureErased();
 
   Task_sleep(10 * 1000 / Clock_tickPeriod);
 
@@ -1051,7 +1517,7 @@ static void startRecording(void)
   i2sParams.fixedBufferLength = PCMBUF_SIZE;
   i2sParams.startUpDelay = 0;
   i2sParams.MCLKDivider = 2;
-  i2sParams.samplingFrequency = SAMPLE_RATE;
+  i2sParams.samplingFrequency = SAMPLE_RATE(ctx.recAdpcmState.format);
   i2sParams.readCallback = readCallbackFxn;
   i2sParams.writeCallback = NULL;
   i2sParams.errorCallback = errCallbackFxn;
@@ -1081,383 +1547,1907 @@ static void stopRecording(void)
     I2S_close(i2sHandle);
   }
 
-  for (int i = 0; i < NUM_RECS; i++)
+  // no more pcm, also keeps nextSector() below from stopping again
+  ctx.recording = false;
+
+  if (eraseLate)
   {
-    ctx.recordings[i] = ctx.recordings[i + 1];
+    Display_print1(dispHandle, 0xff, 0, "%d sectors not erased ahead",
+                   eraseLate);
+    eraseLate = 0;
   }
-  ctx.recStart = ctx.recPos;
-  ctx.recording = false;
-}
 
-static void errCallbackFxn(I2S_Handle handle, int_fast16_t status,
-                           I2S_Transaction *transactionPtr)
-{
+#ifdef USE_VAD
   /*
-   * The content of this callback is executed if an I2S error occurs
+   * Trailing silence, pending only at a sector boundary, so the sector
+   * committed below is the one after its marker (and empty).
    */
-  I2S_stopClocks(handle);
-  I2S_close(handle);
-}
+  if (ctx.recSilentSamples > 0)
+  {
+    writeSilence();
+  }
+#endif
 
-static void readCallbackFxn(I2S_Handle handle, int_fast16_t status,
-                            I2S_Transaction *transactionPtr)
-{
   /*
-   * The content of this callback is executed every time a read-transaction is started
+   * Commit the unfinished sector with its fill length, so the tail is
+   * kept. A partial chunk is completed with zero codes (near silence),
+   * which are not counted in fill.
    */
+  uint32_t pos = ctx.recPos;
+  uint32_t fill = ctx.recChunkInSect * ADPCM_CHUNK_SIZE;
+  if (ctx.recChunkSamples > 0)
+  {
+    size_t bytes = (ctx.recAdpcmState.format & FMT_ADPCM3) ?
+        ctx.recChunkSamples / ADPCM3_GROUP_SAMPLES * ADPCM3_GROUP_SIZE :
+        ctx.recChunkSamples / 2;
+    memset(&ctx.adpcmBuf[bytes], 0, ADPCM_CHUNK_SIZE - bytes);
+    fill += bytes;
+    writeChunk();   // moves to next sector if it was the last chunk
+  }
 
-  /* We must consider the previous transaction (the current one is not over) */
-  I2S_Transaction *transactionFinished = (I2S_Transaction*) List_prev(
-      &transactionPtr->queueElement);
-
-  if (transactionFinished != NULL)
+  if (ctx.recPos == pos && ctx.recChunkInSect > 0)
+  {
+    flushPage();
+    writeSectFill(pos, fill);
+    ctx.recChunkInSect = 0;
+    ctx.recPos++;
+    ctx.recAdpcmStateInSect = ctx.recAdpcmState;
+  }
+  else if (ctx.recPos != pos && fill < ADPCM_SIZE_PER_SECT)
+  {
+    writeSectFill(pos, fill);
+  }
+
+  // not in pcm path, catch up so mount needs no recovery
+  syncCounter(ctx.recPos);
+
+  if (ctx.recPos != ctx.recStart)
+  {
+    RecEntry_t entry;
+    entry.start = ctx.recStart;
+    entry.end = ctx.recPos;
+    entry.flags = ctx.recAdpcmState.format & (FMT_ADPCM3 | FMT_8KHZ);
+    entry.uptime = Clock_getTicks() / (1000 * 1000 / Clock_tickPeriod);
+    journalAppend(&entry);
+  }
+
+  ctx.recStart = ctx.recPos;
+}
+
+/*
+ * Fill a v2 packet with as many bytes of sector data as the mtu allows,
+ * starting at byte offset readPosMinor, and advance read position. A
+ * silence marker sector is sent as a single packet with the 4-byte count.
+ * Data is not read here, only its flash location is recorded, and where
+ * the read-ahead cache holds it.
+ */
+static void fillBadpcmV2(OutgoingMsg_t *outmsg, bool silence)
+{
+  BadpcmPacketV2_t *pkt = &outmsg->bad2;
+  uint8_t *data = pkt->body;
+
+  pkt->version = BADPCM_V2;
+  pkt->format = ctx.readAdpcmState.format & BADPCM_FMT_MASK;
+  pkt->offset = ctx.readPosMinor;
+  pkt->major = ctx.readPosMajor;
+
+  if (ctx.readPosMinor == 0 || ctx.readStatePending)
+  {
+    pkt->format |= BADPCM_V2_STATE;
+    memcpy(data, &ctx.readAdpcmState, BADPCM_V2_STATE_SIZE);
+    data += BADPCM_V2_STATE_SIZE;
+    ctx.readStatePending = false;
+  }
+
+  size_t n = readV2Size(data != pkt->body);
+  size_t left = silence ? sizeof(uint32_t) :
+      ctx.readFill - ctx.readPosMinor;
+  if (!silence && ctx.readPosMajor == ctx.readEnd
+      && ctx.readPosMinor < ctx.readEndMinor * ADPCM_CHUNK_SIZE)
+  {
+    // end in the middle of sector
+    left = ctx.readEndMinor * ADPCM_CHUNK_SIZE - ctx.readPosMinor;
+  }
+  if (n > left)
+  {
+    n = left;
+  }
+
+  size_t offset = (ctx.readPosMajor % DATA_SECT_COUNT) * SECT_SIZE
+      + SECT_HEADER_SIZE + ctx.readPosMinor;
+
+  Display_print4(dispHandle, 0xff, 0,
+                 "read offset %d (%08x) @ major %d, size %d", offset, offset,
+                 ctx.readPosMajor, n);
+
+  outmsg->type = OMT_BADPCM_V2;
+  outmsg->len = data + n - (uint8_t*) pkt;
+  outmsg->nvsOffset = offset;
+  outmsg->nvsLen = n;
+  outmsg->nvsCache = readCacheV2(offset, n);
+
+  ctx.readPosMinor += n;
+  if (silence || ctx.readPosMinor >= ctx.readFill)
+  {
+    ctx.readPosMajor++;
+    ctx.readPosMinor = 0;
+  }
+}
+
+/*
+ * Returns the cache half holding [offset, offset + len), or -1.
+ */
+static int readCacheFind(size_t offset, size_t len)
+{
+  for (int k = 0; k < 2; k++)
+  {
+    if (offset >= ctx.readCacheOffset[k]
+        && offset + len <= ctx.readCacheOffset[k] + ctx.readCacheLen[k])
+    {
+      return k;
+    }
+  }
+  return -1;
+}
+
+/*
+ * True if a v2 packet in flight takes its data from cache half k.
+ */
+static bool readCacheInFlight(int k)
+{
+  const uint8_t *half = &ctx.pcmBuf[k * READ_AHEAD_SIZE];
+
+  for (int i = 0; i < OUTGOING_MSG_NUM; i++)
+  {
+    if (outmsg[i].type == OMT_BADPCM_V2 && outmsg[i].nvsCache >= half
+        && outmsg[i].nvsCache < half + READ_AHEAD_SIZE
+        && outgoingMsgInFlight(&outmsg[i]))
+      return true;
+  }
+  return false;
+}
+
+/*
+ * Fill next cache half from offset, up to the end of sector. A half v2
+ * packets in flight still copy from is not overwritten, the other one is
+ * filled instead, -1 if both are.
+ */
+static int readCacheFill(size_t offset)
+{
+  int k = ctx.readCacheNext;
+  if (readCacheInFlight(k))
+  {
+    k = !k;
+    if (readCacheInFlight(k))
+      return -1;
+  }
+
+  size_t size = SECT_SIZE - offset % SECT_SIZE;
+  if (size > READ_AHEAD_SIZE)
+  {
+    size = READ_AHEAD_SIZE;
+  }
+
+  NVS_read(nvsHandle, offset, &ctx.pcmBuf[k * READ_AHEAD_SIZE], size);
+  ctx.readCacheOffset[k] = offset;
+  ctx.readCacheLen[k] = size;
+  ctx.readCacheNext = !k;
+  return k;
+}
+
+/*
+ * Read for the read path (audio task only). When not recording, pcmBuf
+ * is idle and used as a double-buffered read-ahead cache: the read loop
+ * takes packets from one half, while readPrefetch() fills the other when
+ * the loop waits for the ble task.
+ */
+static void readFlash(size_t offset, void *buf, size_t len)
+{
+  if (ctx.recording || len > READ_AHEAD_SIZE)
+  {
+    NVS_read(nvsHandle, offset, buf, len);
+    return;
+  }
+
+  int k = readCacheFind(offset, len);
+  if (k < 0)
+  {
+    k = readCacheFill(offset);
+    // reads do not cross sectors, the length check does not fail
+    if (k < 0 || ctx.readCacheLen[k] < len)
+    {
+      NVS_read(nvsHandle, offset, buf, len);
+      return;
+    }
+  }
+
+  memcpy(buf, &ctx.pcmBuf[k * READ_AHEAD_SIZE + offset - ctx.readCacheOffset[k]],
+         len);
+}
+
+/*
+ * Where the read-ahead cache holds the data of a v2 packet, filled here if
+ * need be; NULL when recording, or when both halves have packets in
+ * flight, the ble task then reads flash.
+ */
+static const uint8_t *readCacheV2(size_t offset, size_t len)
+{
+#if READ_CACHE_V2
+  if (ctx.recording || len > READ_AHEAD_SIZE)
+    return NULL;
+
+  int k = readCacheFind(offset, len);
+  if (k < 0)
+  {
+    k = readCacheFill(offset);
+    if (k < 0 || ctx.readCacheLen[k] < len)
+      return NULL;
+  }
+  return &ctx.pcmBuf[k * READ_AHEAD_SIZE + offset - ctx.readCacheOffset[k]];
+#else
+  return NULL;
+#endif
+}
+
+/*
+ * Data bytes in a v2 packet from readPosMinor on, with or without codec
+ * state, as the mtu allows; not cut at the end of sector or read.
+ */
+static size_t readV2Size(bool state)
+{
+  size_t size = attMtu - 3;
+  if (size > BADPCM_V2_MAX_SIZE)
+  {
+    size = BADPCM_V2_MAX_SIZE;
+  }
+  return size - BADPCM_V2_HEADER_SIZE - (state ? BADPCM_V2_STATE_SIZE : 0);
+}
+
+/*
+ * Fill (at most) one cache half ahead of the read position, that is, what
+ * the read loop reads next, or what follows it. A v2 packet is not split
+ * across halves, the next half starts with the packet that does not fit
+ * in the one in use. Never overwrites a half with packets in flight.
+ */
+static void readPrefetch(void)
+{
+  if (!READ_PREFETCH || !ctx.reading || ctx.recording
+      || (ctx.readV2 && !READ_CACHE_V2))
+    return;
+
+  size_t sect = (ctx.readPosMajor % DATA_SECT_COUNT) * SECT_SIZE;
+  size_t offset = sect;
+  size_t len = 1;
+  if (ctx.readPosMinor != 0 && ctx.readV2)
+  {
+    offset = sect + SECT_HEADER_SIZE + ctx.readPosMinor;
+    len = readV2Size(ctx.readStatePending);
+    if (len > ctx.readFill - ctx.readPosMinor)
+    {
+      len = ctx.readFill - ctx.readPosMinor;
+    }
+  }
+  else if (ctx.readPosMinor != 0)
+  {
+    offset = sect + SECT_HEADER_SIZE + ctx.readPosMinor * BADPCM_DATA_SIZE;
+  }
+
+  int k = readCacheFind(offset, len);
+  if (k >= 0)
+  {
+    // what follows the half in use
+    offset = ctx.readCacheOffset[k] + ctx.readCacheLen[k];
+    if (ctx.readV2 && offset % SECT_SIZE != 0)
+    {
+      uint32_t minor = ctx.readPosMinor;
+      bool state = minor == 0 || ctx.readStatePending;
+      while (minor < ctx.readFill)
+      {
+        size_t n = readV2Size(state);
+        if (n > ctx.readFill - minor)
+        {
+          n = ctx.readFill - minor;
+        }
+        if (sect + SECT_HEADER_SIZE + minor + n > offset)
+          break;
+        minor += n;
+        state = false;
+      }
+      offset = minor < ctx.readFill ? sect + SECT_HEADER_SIZE + minor :
+          sect + SECT_SIZE;
+    }
+    if (offset % SECT_SIZE == 0)
+    {
+      if (ctx.readPosMajor + 1 >= ctx.recPos)
+        return;
+
+      offset = ((ctx.readPosMajor + 1) % DATA_SECT_COUNT) * SECT_SIZE;
+    }
+
+    if (readCacheFind(offset, 1) >= 0 || readCacheInFlight(!k))
+      return;
+
+    ctx.readCacheNext = !k;
+  }
+
+  readCacheFill(offset);
+}
+
+/*
+ * Start current range of a multi-range read, with a marker pending.
+ */
+static void startReadRange(void)
+{
+  ctx.readStart = ctx.readRanges[ctx.readRangeIndex][0];
+  ctx.readEnd = ctx.readRanges[ctx.readRangeIndex][1];
+  ctx.readEndMinor = 0;
+  ctx.readPosMajor = ctx.readStart;
+  ctx.readPosMinor = 0;
+  ctx.readRangeMarker = true;
+}
+
+/*
+ * True if (major, minor) of range can be the resume point: within what has
+ * been sent. That is up to the read position in the range being read, and
+ * up to the end in an earlier range of a multi-range read; the resume
+ * point stays in an earlier range until the client acks into the next
+ * one. A single range read has range 0 only.
+ */
+static bool ackInRead(uint8_t range, uint32_t major, uint32_t minor)
+{
+  if (range > ctx.readRangeIndex
+      || (ctx.readRangeCount == 0 && range != 0))
+  {
+    return false;
+  }
+
+  if (range < ctx.readRangeIndex)
+  {
+    return ctx.readRanges[range][0] <= major
+        && (major < ctx.readRanges[range][1]
+            || (major == ctx.readRanges[range][1] && minor == 0));
+  }
+
+  return major < ctx.readPosMajor
+      || (major == ctx.readPosMajor && minor <= ctx.readPosMinor);
+}
+
+/*
+ * Move on to next range when current one is done, false if none left.
+ */
+static bool nextReadRange(void)
+{
+  if (ctx.readRangeIndex + 1 >= ctx.readRangeCount)
+    return false;
+
+  ctx.readRangeIndex++;
+  Display_print2(dispHandle, 0xff, 0, "read range %d, start %d",
+                 ctx.readRangeIndex, ctx.readRanges[ctx.readRangeIndex][0]);
+  startReadRange();
+  return true;
+}
+
+/*
+ * Advance read codec state over one packet (chunk) of adpcm data.
+ */
+static void advanceReadState(const uint8_t *data)
+{
+  if (ctx.readAdpcmState.format & FMT_ADPCM3)
+  {
+    adpcm3AdvanceState(data, BADPCM_SAMPLES(ctx.readAdpcmState.format),
+                       &ctx.readAdpcmState);
+  }
+  else
+  {
+    adpcmAdvanceState(data, BADPCM_SAMPLES(ctx.readAdpcmState.format),
+                      &ctx.readAdpcmState);
+  }
+}
+
+/*
+ * Load codec state and fill length of the sector at offset for reading.
+ */
+static void loadReadHeader(size_t offset)
+{
+  uint32_t marker;
+
+  readFlash(offset, &marker, sizeof(marker));
+  readFlash(offset + offsetof(ctx_t, recAdpcmStateInSect),
+            &ctx.readAdpcmState, sizeof(AdpcmState_t));
+  ctx.readFill = sectFill(marker);
+}
+
+/*
+ * Data bytes in sector, from fill length marker in header.
+ */
+static uint32_t sectFill(uint32_t marker)
+{
+  uint32_t fill = marker & 0xffff;
+  if ((marker >> 16) != (~fill & 0xffff) || fill == 0
+      || fill >= ADPCM_SIZE_PER_SECT)
+  {
+    return ADPCM_SIZE_PER_SECT;
+  }
+  return fill;
+}
+
+static void writeSectFill(uint32_t pos, uint32_t fill)
+{
+  size_t offset = (pos % DATA_SECT_COUNT) * SECT_SIZE;
+  uint32_t marker = fill | ((~fill & 0xffff) << 16);
+
+  NVS_write(nvsHandle, offset, &marker, sizeof(marker), NVS_WRITE_POST_VERIFY);
+
+  Display_print2(dispHandle, 0xff, 0, " - nvs write, pos 0x%08x, fill %d",
+                 pos, fill);
+}
+
+/*
+ * True if read position reached (readEnd, readEndMinor), exclusive.
+ */
+static bool readPastEnd(void)
+{
+  uint32_t minor = ctx.readV2 ? ctx.readEndMinor * ADPCM_CHUNK_SIZE :
+      ctx.readEndMinor;
+
+  return ctx.readPosMajor > ctx.readEnd
+      || (ctx.readPosMajor == ctx.readEnd && ctx.readPosMinor >= minor);
+}
+
+/*
+ * Position read at (major, minor). For minor > 0, codec state is loaded
+ * from sector header and advanced over preceding chunks, read into scratch
+ * (BADPCM_DATA_SIZE bytes), so the first packet is decodable on its own.
+ * v1 packets always carry state; v2 packets carry it in the first packet
+ * after seek. A v2 minor (a byte offset) is rounded down to its chunk,
+ * the only place state is known at; the client gets up to a chunk again
+ * and tells by offset. A minor past the sector starts the next one. The
+ * actual position is in readPosMajor/readPosMinor, and so in status.
+ */
+static void seekRead(uint32_t major, uint32_t minor, uint8_t *scratch)
+{
+  if (minor >= (ctx.readV2 ? ADPCM_SIZE_PER_SECT : ADPCM_CHUNKS_PER_SECT))
+  {
+    ctx.readPosMajor = major + 1;
+    ctx.readPosMinor = 0;
+    return;
+  }
+
+  if (ctx.readV2)
+  {
+    minor -= minor % ADPCM_CHUNK_SIZE;
+  }
+
+  ctx.readPosMajor = major;
+  ctx.readPosMinor = minor;
+
+  // at minor 0, state is loaded by read loop
+  if (minor == 0)
+    return;
+
+  size_t offset = (major % DATA_SECT_COUNT) * SECT_SIZE;
+  loadReadHeader(offset);
+
+  if (ctx.readAdpcmState.format & FMT_SILENCE)
+  {
+    ctx.readPosMinor = 0;
+    return;
+  }
+
+  // past the tail of a sector committed on stop
+  if ((ctx.readV2 ? minor : minor * ADPCM_CHUNK_SIZE) >= ctx.readFill)
+  {
+    ctx.readPosMajor = major + 1;
+    ctx.readPosMinor = 0;
+    return;
+  }
+
+  uint32_t chunks = minor;
+  if (ctx.readV2)
+  {
+    chunks = minor / ADPCM_CHUNK_SIZE;
+    ctx.readStatePending = true;
+  }
+
+  for (uint32_t i = 0; i < chunks; i++)
+  {
+    readFlash(offset + SECT_HEADER_SIZE + i * BADPCM_DATA_SIZE, scratch,
+              BADPCM_DATA_SIZE);
+    advanceReadState(scratch);
+  }
+}
+
+/*
+ * Write the full chunk in ctx.adpcmBuf to current sector. The first chunk
+ * goes together with the sector header as page 0 (ctx layout). The others
+ * are staged in ctx.pageBuf and programmed one full page at a time; 24
+ * chunks fill pages 1-15 exactly, so nothing is left at sector end. A
+ * 160-byte write at an arbitrary offset would cross a page boundary every
+ * other chunk and cost two page programs.
+ * Moves to next sector after the last chunk.
+ */
+static void writeChunk(void)
+{
+  if (ctx.recAdpcmState.format & FMT_ADPCM3)
+  {
+    ctx.adpcmBuf[ADPCM_CHUNK_SIZE - 1] = 0;   // pad byte
+  }
+
+  if (ctx.recChunkInSect == 0)
+  {
+    // fill length is left blank, see SECT_FILL_SIZE
+    size_t offset = (ctx.recPos % DATA_SECT_COUNT) * SECT_SIZE;
+    NVS_write(nvsHandle, offset + SECT_FILL_SIZE,
+              (uint8_t*) &ctx + SECT_FILL_SIZE, FLASH_PAGE_SIZE - SECT_FILL_SIZE,
+              0); // NVS_WRITE_POST_VERIFY);
+
+    Display_print5(
+        dispHandle, 0xff, 0,
+        " - nvs write, pos 0x%08x, cnt %06d, page %02d, offset 0x%08x (%%4k %04d), size 256",
+        ctx.recPos, ctx.recAdpcmCount, 0, offset, offset % 4096);
+
+    ctx.pageFill = 0;
+    ctx.pageInSect = 1;
+  }
+  else
+  {
+#if !STAGE_PAGES
+    size_t offset = (ctx.recPos % DATA_SECT_COUNT) * SECT_SIZE
+        + SECT_HEADER_SIZE + ctx.recChunkInSect * ADPCM_CHUNK_SIZE;
+    NVS_write(nvsHandle, offset, ctx.adpcmBuf, ADPCM_CHUNK_SIZE, 0); // NVS_WRITE_POST_VERIFY);
+#else
+    const uint8_t *src = ctx.adpcmBuf;
+    size_t len = ADPCM_CHUNK_SIZE;
+
+    while (len > 0)
+    {
+      size_t k = FLASH_PAGE_SIZE - ctx.pageFill;
+      if (k > len)
+      {
+        k = len;
+      }
+
+      memcpy(&ctx.pageBuf[ctx.pageFill], src, k);
+      ctx.pageFill += k;
+      src += k;
+      len -= k;
+
+      if (ctx.pageFill == FLASH_PAGE_SIZE)
+      {
+        flushPage();
+      }
+    }
+#endif
+  }
+
+  ctx.recChunkSamples = 0;
+  ctx.recChunkInSect++;
+
+  // last chunk in sect
+  if (ctx.recChunkInSect == ADPCM_CHUNKS_PER_SECT)
+  {
+    ctx.recChunkInSect = 0;
+    nextSector();
+  }
+}
+
+/*
+ * Close current sector (already written) and erase the next one. Stops
+ * recording if max duration is reached.
+ */
+static void nextSector(void)
+{
+  ctx.recPos++;
+  ctx.recAdpcmStateInSect = ctx.recAdpcmState;
+  if (ctx.recPos - MONOTONIC_COUNTER >= COUNTER_STRIDE)
+  {
+    syncCounter(ctx.recPos);
+  }
+
+  Display_print2(dispHandle, 0xff, 0,
+                 "new sector  : pos 0x%08x, counter 0x%08x", ctx.recPos,
+                 MONOTONIC_COUNTER);
+
+  /* it is important to do this here, usually done already by eraseAhead() */
+  ensureErased();
+
+  // duration counts silence too, see MAX_RECORDING_SAMPLES
+  if (ctx.recSamples >= MAX_RECORDING_SAMPLES(ctx.recAdpcmState.format))
+  {
+    Display_print2(
+        dispHandle, 0xff, 0,
+        "max rec sect reached, before stopRecording(). start 0x%08x, pos 0x%08x",
+        ctx.recStart, ctx.recPos);
+    stopRecording();
+    Display_print2(
+        dispHandle, 0xff, 0,
+        "                      after  stopRecording(). start 0x%08x, pos 0x%08x",
+        ctx.recStart, ctx.recPos);
+
+    Event_post(audioEvent, AUDIO_REC_AUTOSTOP);
+  }
+}
+
+/*
+ * Blank check, cheaper than erase and returns early on written sectors.
+ */
+static bool flashIsBlank(size_t offset, size_t size)
+{
+  uint32_t buf[16];
+
+  for (size_t i = 0; i < size; i += sizeof(buf))
+  {
+    NVS_read(nvsHandle, offset + i, buf, sizeof(buf));
+    for (size_t j = 0; j < sizeof(buf) / sizeof(buf[0]); j++)
+    {
+      if (buf[j] != 0xffffffff)
+        return false;
+    }
+  }
+  return true;
+}
+
+static void eraseSector(uint32_t pos)
+{
+  size_t offset = (pos % DATA_SECT_COUNT) * SECT_SIZE;
+
+  if (flashIsBlank(offset, SECT_SIZE))
+  {
+    Display_print2(dispHandle, 0xff, 0, " - nvs blank,     0x%08x (%%4k %d)",
+                   offset, offset % 4096);
+  }
+  else
+  {
+    Semaphore_pend(semSectorErase, BIOS_WAIT_FOREVER);
+    NVS_erase(nvsHandle, offset, SECT_SIZE);
+    Semaphore_post(semSectorErase);
+    Display_print2(dispHandle, 0xff, 0, " - nvs erase,     0x%08x (%%4k %d)",
+                   offset, offset % 4096);
+  }
+
+  // drop cached copy of erased data
+  for (int k = 0; k < 2; k++)
+  {
+    if (ctx.readCacheOffset[k] / SECT_SIZE == offset / SECT_SIZE)
+    {
+      ctx.readCacheLen[k] = 0;
+    }
+  }
+}
+
+/*
+ * Make sure recPos is erased before writing to it. Falls back to
+ * synchronous erase if eraseAhead() has not reached it; while recording
+ * that is counted in eraseLate, the pcm path then waits for a blank check
+ * and, unless blank, an erase at a sector boundary, with whatever backlog
+ * it has.
+ */
+static void ensureErased(void)
+{
+  if (ctx.eraseFront <= ctx.recPos)
+  {
+    if (ctx.recording)
+    {
+      eraseLate++;
+    }
+    // before erasing, readOutgoingMsg() checks it under semSectorErase
+    ctx.eraseFront = ctx.recPos + 1;
+    eraseSector(ctx.recPos);
+  }
+}
+
+/*
+ * Messages not on freeOutgoingMsgs are in flight; one freed during the
+ * walk is counted as in flight, which only postpones what waits for it.
+ */
+static bool outgoingMsgInFlight(OutgoingMsg_t *msg)
+{
+  List_Elem *e = List_head(&freeOutgoingMsgs);
+  while (e && e != &msg->listElem)
+  {
+    e = List_next(e);
+  }
+  return e == NULL;
+}
+
+/*
+ * True if a v2 packet reading sector pos is queued for notification, its
+ * data is read from flash only when the ble task sends it.
+ */
+static bool sectorInFlight(uint32_t pos)
+{
+  uint32_t sect = pos % DATA_SECT_COUNT;
+
+  for (int i = 0; i < OUTGOING_MSG_NUM; i++)
+  {
+    if (outmsg[i].type == OMT_BADPCM_V2
+        && outmsg[i].nvsOffset / SECT_SIZE == sect
+        && outgoingMsgInFlight(&outmsg[i]))
+      return true;
+  }
+  return false;
+}
+
+/*
+ * Erase (at most) one sector ahead of recPos, to keep ERASE_AHEAD_SECTORS
+ * erased after it. Called in the idle slot of the task loop (Event_pend()
+ * timed out, not recording), and while recording after a pcm buffer when
+ * none is waiting, so that the i2s queue covers the erase. Returns true if
+ * more to do.
+ */
+static bool eraseAhead(void)
+{
+  if (ctx.eraseFront < ctx.recPos)
+  {
+    ctx.eraseFront = ctx.recPos;
+  }
+
+  if (ctx.eraseFront >= ctx.recPos + 1 + ERASE_AHEAD_SECTORS)
+  {
+    return false;
+  }
+
+  // oldest sector still being read out, try again at next timeout
+  if (sectorInFlight(ctx.eraseFront))
+  {
+    return true;
+  }
+
+  eraseSector(ctx.eraseFront);
+  ctx.eraseFront++;
+
+  return ctx.eraseFront < ctx.recPos + 1 + ERASE_AHEAD_SECTORS;
+}
+
+/*
+ * Send the chunk just completed in ctx.adpcmBuf as a v1 packet, with the
+ * codec state at chunk start, before it is written to flash. Dropped if no
+ * outgoing msg is free; recording never waits for the link. Client sees
+ * the gap in (major, minor).
+ */
+static void monitorChunk(void)
+{
+  OutgoingMsg_t *outmsg = (OutgoingMsg_t*) List_get(&freeOutgoingMsgs);
+  if (outmsg == NULL)
+  {
+    ctx.monitorDrops++;
+    return;
+  }
+
+  memcpy(outmsg->bad.data, ctx.adpcmBuf, BADPCM_DATA_SIZE);
+  if (ctx.recChunkState.format & FMT_ADPCM3)
+  {
+    outmsg->bad.data[BADPCM_DATA_SIZE - 1] = 0;   // pad byte
+  }
+
+  outmsg->bad.major = ctx.recPos;
+  outmsg->bad.minor = ctx.recChunkInSect
+      | ((ctx.recChunkState.format & BADPCM_FMT_MASK) << BADPCM_FMT_SHIFT);
+  outmsg->bad.index = ctx.recChunkState.index;
+  outmsg->bad.sample = ctx.recChunkState.sample;
+  outmsg->type = OMT_BADPCM;
+
+  sendOutgoingMsg(outmsg);
+}
+
+/*
+ * Program staged bytes (a full page, or the tail on stop) to current page.
+ */
+static void flushPage(void)
+{
+  if (ctx.pageFill == 0)
+    return;
+
+  size_t offset = (ctx.recPos % DATA_SECT_COUNT) * SECT_SIZE
+      + ctx.pageInSect * FLASH_PAGE_SIZE;
+  NVS_write(nvsHandle, offset, ctx.pageBuf, ctx.pageFill, 0); // NVS_WRITE_POST_VERIFY);
+
+  Display_print5(
+      dispHandle, 0xff, 0,
+      " - nvs write, pos 0x%08x, page %02d, offset 0x%08x (%%4k %04d), size %d",
+      ctx.recPos, ctx.pageInSect, offset, offset % 4096, ctx.pageFill);
+
+  ctx.pageFill = 0;
+  ctx.pageInSect++;
+}
+
+#ifdef USE_VAD
+/*
+ * Write a silence marker sector for pending silent samples. Only the
+ * header and the sample count are programmed.
+ */
+static void writeSilence(void)
+{
+  size_t offset = (ctx.recPos % DATA_SECT_COUNT) * SECT_SIZE;
+
+  ctx.recAdpcmStateInSect.format |= FMT_SILENCE;
+  NVS_write(nvsHandle, offset + SECT_FILL_SIZE,
+            (uint8_t*) &ctx + SECT_FILL_SIZE, SECT_HEADER_SIZE - SECT_FILL_SIZE,
+            0);
+  NVS_write(nvsHandle, offset + SECT_HEADER_SIZE, &ctx.recSilentSamples,
+            sizeof(uint32_t), 0);
+
+  Display_print3(dispHandle, 0xff, 0,
+                 " - nvs write, pos 0x%08x, silence %d samples, offset 0x%08x",
+                 ctx.recPos, ctx.recSilentSamples, offset);
+
+  ctx.recSilentSamples = 0;
+  nextSector();
+}
+#endif
+
+static void errCallbackFxn(I2S_Handle handle, int_fast16_t status,
+                           I2S_Transaction *transactionPtr)
+{
+  /*
+   * The content of this callback is executed if an I2S error occurs
+   */
+  I2S_stopClocks(handle);
+  I2S_close(handle);
+}
+
+static void readCallbackFxn(I2S_Handle handle, int_fast16_t status,
+                            I2S_Transaction *transactionPtr)
+{
+  /*
+   * The content of this callback is executed every time a read-transaction is started
+   */
+
+  /* We must consider the previous transaction (the current one is not over) */
+  I2S_Transaction *transactionFinished = (I2S_Transaction*) List_prev(
+      &transactionPtr->queueElement);
+
+  if (transactionFinished != NULL)
   {
 
     /* The finished transaction contains data that must be treated */
     List_remove(&ctx.recordingList, (List_Elem*) transactionFinished);
     List_put(&ctx.processingList, (List_Elem*) transactionFinished);
 
-    /* Start the treatment of the data */
-    Semaphore_post(semDataReadyForTreatment);
+    /* Start the treatment of the data */
+    Semaphore_post(semDataReadyForTreatment);
+  }
+}
+
+#if defined (LOG_ADPCM_DATA) || defined (LOG_BADPCM_DATA)
+static void uartWriteCallbackFxn(UART_Handle handle, void *buf, size_t count)
+{
+  Semaphore_post(semUartTxReady);
+}
+#endif
+
+/*
+ * Calculate checksum, ublox
+ */
+void checksum(void *p, uint32_t len, uint8_t *a, uint8_t *b)
+{
+  uint8_t *arr = (uint8_t*) p;
+  *a = 0;
+  *b = 0;
+  for (int i = 0; i < len; i++)
+  {
+    *a += arr[i];
+    *b += *a;
+  }
+}
+
+/*
+ * Count marked (cleared) bits in buf, continuing a scan. Marked bits are a
+ * monotone prefix: 0x00 bytes, at most one partial byte, then 0xff bytes.
+ * Returns -1 if not. *complete is set once the prefix has ended.
+ *
+ * The partial byte may have a hole: syncCounter() clears several bits in
+ * one write, and power failing during it leaves the byte being programmed
+ * with only some of its bits cleared (bytes after it are untouched). Only
+ * the bits before the hole count; they were cleared by the write before
+ * or are part of a sync target that was complete, so the count never goes
+ * back. The next sync programs the byte again.
+ */
+static int countChunkBits(const uint8_t *buf, size_t len, bool *complete)
+{
+  int count = 0;
+
+  for (size_t j = 0; j < len; j++)
+  {
+    if (*complete)
+    {
+      if (buf[j] != 0xff)
+        return -1;
+    }
+    else
+    {
+      if (buf[j] == 0)
+      {
+        count += 8;
+      }
+      else
+      {
+        switch (buf[j])
+        {
+        // @formatter:off
+        case 0x01: count += 7; break;
+        case 0x03: count += 6; break;
+        case 0x07: count += 5; break;
+        case 0x0f: count += 4; break;
+        case 0x1f: count += 3; break;
+        case 0x3f: count += 2; break;
+        case 0x7f: count += 1; break;
+        case 0xff: count += 0; break;
+        default:
+          // torn, bits up to the first one still set
+          for (uint8_t m = 0x80; !(buf[j] & m); m >>= 1)
+          {
+            count++;
+          }
+          break;
+        // @formatter:on
+        }
+        *complete = true;
+      }
+    }
+  }
+  return count;
+}
+
+/*
+ * Count marked (cleared) bits in given sector and size
+ * size is 4096 for low counter and 2048 for high counter
+ */
+static int countMarkedBits(int sectIndex, size_t size)
+{
+  uint8_t buf[COUNTER_CHUNK_SIZE];
+  bool complete = false;
+  int count = 0;
+
+  for (size_t i = 0; i < size / COUNTER_CHUNK_SIZE; i++)
+  {
+    NVS_read(nvsHandle, SECT_OFFSET(sectIndex) + i * COUNTER_CHUNK_SIZE, buf,
+             COUNTER_CHUNK_SIZE);
+    counterBytesRead += COUNTER_CHUNK_SIZE;
+
+    int n = countChunkBits(buf, COUNTER_CHUNK_SIZE, &complete);
+    if (n < 0)
+      return -1;
+
+    count += n;
+  }
+  return count;
+}
+
+/*
+ * Same as countMarkedBits() but binary-searches for the chunk where the
+ * marked prefix ends, probing the last byte of each chunk, and validates
+ * only that chunk and the next one (must be blank). Falls back to the full
+ * scan if the boundary does not look right, e.g. a hole in the prefix.
+ */
+static int mountMarkedBits(int sectIndex, size_t size)
+{
+#if !COUNTER_MOUNT_SEARCH
+  return countMarkedBits(sectIndex, size);
+#else
+  uint8_t buf[COUNTER_CHUNK_SIZE];
+  size_t chunks = size / COUNTER_CHUNK_SIZE;
+  size_t offset = SECT_OFFSET(sectIndex);
+
+  // first chunk not fully marked, in [lo, hi]
+  size_t lo = 0, hi = chunks;
+  while (lo < hi)
+  {
+    size_t mid = (lo + hi) / 2;
+    uint8_t last;
+    NVS_read(nvsHandle, offset + mid * COUNTER_CHUNK_SIZE + COUNTER_CHUNK_SIZE - 1,
+             &last, 1);
+    counterBytesRead += 1;
+
+    if (last == 0)
+    {
+      lo = mid + 1;
+    }
+    else
+    {
+      hi = mid;
+    }
+  }
+
+  size_t b = (lo == chunks) ? chunks - 1 : lo;
+  bool complete = false;
+
+  NVS_read(nvsHandle, offset + b * COUNTER_CHUNK_SIZE, buf, COUNTER_CHUNK_SIZE);
+  counterBytesRead += COUNTER_CHUNK_SIZE;
+  int n = countChunkBits(buf, COUNTER_CHUNK_SIZE, &complete);
+
+  if (n >= 0 && b + 1 < chunks)
+  {
+    NVS_read(nvsHandle, offset + (b + 1) * COUNTER_CHUNK_SIZE, buf,
+             COUNTER_CHUNK_SIZE);
+    counterBytesRead += COUNTER_CHUNK_SIZE;
+    complete = true;
+    if (countChunkBits(buf, COUNTER_CHUNK_SIZE, &complete) < 0)
+    {
+      n = -1;
+    }
+  }
+
+  if (n < 0)
+  {
+    Display_print1(dispHandle, 0xff, 0, "counter     : sector %d, full scan",
+                   sectIndex);
+    return countMarkedBits(sectIndex, size);
+  }
+
+  return b * COUNTER_CHUNK_SIZE * 8 + n;
+#endif
+}
+
+/*
+ * clear one more bit on given sector, and position
+ */
+static void incrementMarkedBits(int sectIndex, size_t current)
+{
+  int offset = SECT_OFFSET(sectIndex) + current / 8;
+  NVS_write(nvsHandle, offset, (void*) &markedBytes[current % 8], 1,
+  NVS_WRITE_POST_VERIFY);
+}
+
+static uint32_t readMagic(void)
+{
+  uint32_t magic;
+  NVS_read(nvsHandle, HISECT_OFFSET + 2048, &magic, sizeof(uint32_t));
+  return magic;
+}
+
+static void resetLowCounter(void)
+{
+  NVS_erase(nvsHandle, LOSECT_OFFSET, SECT_SIZE);
+  markedBitsLo = 0;
+  incrementMarkedBits(LOSECT_INDEX, markedBitsLo++);
+}
+
+static void resetCounter(void)
+{
+  // erase high sect
+  NVS_erase(nvsHandle, HISECT_OFFSET, SECT_SIZE);
+
+  // erase and init low counter
+  resetLowCounter();
+
+  // init high counter
+  markedBitsHi = 0;
+  incrementMarkedBits(HISECT_INDEX, markedBitsHi++);
+  incrementMarkedBits(HISECT_INDEX, markedBitsHi++);  // twice
+
+  // write magic
+  uint32_t magic = MAGIC;
+  NVS_write(nvsHandle, HISECT_OFFSET + 2048, &magic, sizeof(magic),
+  NVS_WRITE_POST_VERIFY);
+}
+
+static void loadCounter(void)
+{
+  static bool initialized = false;
+  if (!initialized)
+  {
+    loadSettings();
+
+    uint8_t dur = settingsVal[SETTING_DURATION];
+    Display_print1(dispHandle, 0xff, 0, "duration    : %d", dur);
+
+    if (dur == 10)
+    {
+      simpleProfileChar2 = 10;
+    }
+    else if (dur == 15)
+    {
+      simpleProfileChar2 = 15;
+    }
+    else
+    {
+      simpleProfileChar2 = 5;
+    }
+
+    simpleProfileChar3 = (settingsVal[SETTING_CODEC] == 3) ? 3 : 4;
+    Display_print1(dispHandle, 0xff, 0, "codec       : %d-bit",
+                   simpleProfileChar3);
+
+    simpleProfileChar4 = (settingsVal[SETTING_RATE] == 8) ? 8 : 16;
+    Display_print1(dispHandle, 0xff, 0, "rate        : %d kHz",
+                   simpleProfileChar4);
+
+    if (MAGIC != readMagic())
+    {
+      resetCounter();
+      return;
+    }
+
+    uint32_t t0 = Clock_getTicks();
+    counterBytesRead = 0;
+
+    markedBitsHi = mountMarkedBits(HISECT_INDEX, 2048);
+    if (markedBitsHi <= 1)
+    {
+      resetCounter();
+      return;
+    }
+
+    if (markedBitsHi % 2 == 1) // unfinished carrying bit
+    {
+      resetLowCounter();
+      incrementMarkedBits(HISECT_INDEX, markedBitsHi++);
+    }
+
+    markedBitsLo = mountMarkedBits(LOSECT_INDEX, 4096);
+    initialized = true;
+
+    Display_print2(dispHandle, 0xff, 0, "counter     : mount %d bytes, %d ticks",
+                   counterBytesRead, Clock_getTicks() - t0);
+
+    // sectors completed after last counter write, at most COUNTER_STRIDE
+    uint32_t counter = MONOTONIC_COUNTER;
+    uint32_t pos = counter;
+    while (pos - counter < COUNTER_STRIDE && sectorComplete(pos))
+    {
+      pos++;
+    }
+
+    if (pos != counter)
+    {
+      Display_print2(dispHandle, 0xff, 0, "counter     : recovered %08x -> %08x",
+                     counter, pos);
+      syncCounter(pos);
+    }
+  }
+}
+
+#if !SETTINGS_LOG
+
+/*
+ * Settings sector holds one byte per setting: duration, codec, rate. A
+ * change erases it and writes them again.
+ */
+static void loadSettings(void)
+{
+  memset(settingsVal, 0xff, sizeof(settingsVal));
+  NVS_read(nvsHandle, SETTINGS_SECT_OFFSET(0), settingsVal, 3);
+}
+
+static void saveSetting(uint8_t key, uint8_t value)
+{
+  settingsVal[key] = value;
+  NVS_erase(nvsHandle, SETTINGS_SECT_OFFSET(0), SECT_SIZE);
+  settingsErases++;
+  NVS_write(nvsHandle, SETTINGS_SECT_OFFSET(0), settingsVal, 3,
+            NVS_WRITE_POST_VERIFY);
+}
+
+#else
+
+/*
+ * A settings record is { key, value, ~key, ~value }, torn or blank ones
+ * do not check.
+ */
+static bool settingsRecordValid(const uint8_t *r)
+{
+  return r[2] == (uint8_t) ~r[0] && r[3] == (uint8_t) ~r[1];
+}
+
+static void writeSettingsRecord(size_t offset, uint8_t key, uint8_t value)
+{
+  uint8_t r[SETTINGS_RECORD_SIZE] = { key, value, (uint8_t) ~key,
+                                      (uint8_t) ~value };
+  NVS_write(nvsHandle, offset, r, sizeof(r), NVS_WRITE_POST_VERIFY);
+}
+
+/*
+ * Settings are a log of records in one of two sectors. The first record
+ * is a header, key SETTINGS_MAGIC and a generation as value; the sector
+ * with the newer valid header is active. A change appends a record, the
+ * newest record of a key wins. When full, the current values are written
+ * to the other sector (compactSettings()), the only time a sector is
+ * erased. Without any header, the old format (3 bytes: duration, codec,
+ * rate at the start of SETTINGS_SECT_INDEX) is read and compacted.
+ */
+static void loadSettings(void)
+{
+  uint8_t hdr[2][SETTINGS_RECORD_SIZE];
+  bool valid[2];
+
+  memset(settingsVal, 0xff, sizeof(settingsVal));
+
+  for (int k = 0; k < 2; k++)
+  {
+    NVS_read(nvsHandle, SETTINGS_SECT_OFFSET(k), hdr[k], SETTINGS_RECORD_SIZE);
+    valid[k] = hdr[k][0] == SETTINGS_MAGIC && settingsRecordValid(hdr[k]);
+  }
+
+  if (!valid[0] && !valid[1])
+  {
+    NVS_read(nvsHandle, SETTINGS_SECT_OFFSET(0), settingsVal, 3);
+    settingsSect = 0;
+    settingsGen = 0;
+    compactSettings();
+    return;
+  }
+
+  settingsSect = (valid[0] && valid[1]) ?
+      ((int8_t) (hdr[1][1] - hdr[0][1]) > 0) : valid[1];
+  settingsGen = hdr[settingsSect][1];
+
+  size_t offset = SETTINGS_SECT_OFFSET(settingsSect);
+  uint8_t buf[64];
+
+  settingsFill = SECT_SIZE;
+  for (size_t i = SETTINGS_RECORD_SIZE; i < SECT_SIZE; i += sizeof(buf))
+  {
+    size_t size = SECT_SIZE - i < sizeof(buf) ? SECT_SIZE - i : sizeof(buf);
+    NVS_read(nvsHandle, offset + i, buf, size);
+
+    for (size_t j = 0; j < size; j += SETTINGS_RECORD_SIZE)
+    {
+      uint8_t *r = &buf[j];
+      if (r[0] == 0xff && r[1] == 0xff && r[2] == 0xff && r[3] == 0xff)
+      {
+        settingsFill = i + j;
+        break;
+      }
+
+      if (settingsRecordValid(r) && r[0] < SETTINGS_KEY_NUM)
+      {
+        settingsVal[r[0]] = r[1];
+      }
+    }
+
+    if (settingsFill < SECT_SIZE)
+      break;
+  }
+
+  Display_print3(dispHandle, 0xff, 0, "settings    : sect %d, gen %d, fill %d",
+                 settingsSect, settingsGen, settingsFill);
+}
+
+/*
+ * Append a record if value changed, one small program instead of an erase.
+ */
+static void saveSetting(uint8_t key, uint8_t value)
+{
+  if (settingsVal[key] == value)
+    return;
+
+  settingsVal[key] = value;
+
+  if (settingsFill + SETTINGS_RECORD_SIZE > SECT_SIZE)
+  {
+    compactSettings();
+    return;
+  }
+
+  writeSettingsRecord(SETTINGS_SECT_OFFSET(settingsSect) + settingsFill, key,
+                      value);
+  settingsFill += SETTINGS_RECORD_SIZE;
+}
+
+/*
+ * Write current values to the other sector, header last as commit.
+ */
+static void compactSettings(void)
+{
+  int k = !settingsSect;
+  size_t offset = SETTINGS_SECT_OFFSET(k);
+
+  if (!flashIsBlank(offset, SECT_SIZE))
+  {
+    NVS_erase(nvsHandle, offset, SECT_SIZE);
+    settingsErases++;
+  }
+
+  size_t fill = SETTINGS_RECORD_SIZE;
+  for (int key = 0; key < SETTINGS_KEY_NUM; key++)
+  {
+    if (settingsVal[key] != 0xff)
+    {
+      writeSettingsRecord(offset + fill, key, settingsVal[key]);
+      fill += SETTINGS_RECORD_SIZE;
+    }
+  }
+
+  settingsGen++;
+  writeSettingsRecord(offset, SETTINGS_MAGIC, settingsGen);
+  settingsSect = k;
+  settingsFill = fill;
+
+  Display_print2(dispHandle, 0xff, 0, "settings    : compacted, gen %d, %d erases",
+                 settingsGen, settingsErases);
+}
+
+#endif
+
+/*
+ * Advance counter to target. Bits in low sector are cleared in one write,
+ * the carry to high sector goes through incrementCounter().
+ */
+static void syncCounter(uint32_t target)
+{
+  while (MONOTONIC_COUNTER < target)
+  {
+    int from = markedBitsLo;
+    int to = from + (target - MONOTONIC_COUNTER);
+    if (to > SECT_SIZE * 8)
+    {
+      to = SECT_SIZE * 8;
+    }
+
+    if (to == from)
+    {
+      incrementCounter();   // carry
+      continue;
+    }
+
+    uint8_t bytes[COUNTER_STRIDE / 8 + 2];
+    int first = from / 8;
+    int last = (to - 1) / 8;
+    if (last - first + 1 > (int) sizeof(bytes))
+    {
+      last = first + sizeof(bytes) - 1;
+      to = (last + 1) * 8;
+    }
+
+    for (int k = first; k <= last; k++)
+    {
+      int m = to - k * 8;   // bits cleared in byte k, msb first
+      bytes[k - first] = (m >= 8) ? 0 : (uint8_t) (0xff >> m);
+    }
+
+    if (NVS_write(nvsHandle, SECT_OFFSET(LOSECT_INDEX) + first, bytes,
+                  last - first + 1, NVS_WRITE_POST_VERIFY) != NVS_STATUS_SUCCESS)
+    {
+      // the write did not take, or a torn byte holds bits it does not
+      // clear: the marked prefix on flash is what counts
+      int marked = recountMarkedBits(first, last);
+      Display_print2(dispHandle, 0xff, 0, "counter     : write did not verify, %d bits, wanted %d",
+                     marked, to);
+      if (marked <= from)
+      {
+        return;     // no progress, next boot recovers from the headers
+      }
+      to = marked;
+    }
+    markedBitsLo = to;
+  }
+}
+
+/*
+ * Marked bits in the low counter sector, counting the prefix on flash from
+ * byte first through byte last, which the prefix does not pass.
+ */
+static int recountMarkedBits(int first, int last)
+{
+  int marked = first * 8;
+
+  for (int k = first; k <= last; k++)
+  {
+    uint8_t b;
+    NVS_read(nvsHandle, SECT_OFFSET(LOSECT_INDEX) + k, &b, 1);
+
+    int m = 0;
+    while (m < 8 && !(b & (0x80 >> m)))
+    {
+      m++;
+    }
+    marked += m;
+    if (m < 8)
+      break;
   }
+  return marked;
 }
 
-#if defined (LOG_ADPCM_DATA) || defined (LOG_BADPCM_DATA)
-static void uartWriteCallbackFxn(UART_Handle handle, void *buf, size_t count)
+/*
+ * True if sector pos has been written to the end in this round, that is,
+ * header recPos matches and the last page (or silence count) is programmed.
+ */
+static bool sectorComplete(uint32_t pos)
 {
-  Semaphore_post(semUartTxReady);
-}
-#endif
+  size_t offset = (pos % DATA_SECT_COUNT) * SECT_SIZE;
+  uint32_t recPos;
+  AdpcmState_t state;
 
-static char adpcmEncoder(short sample, int16_t *prevSample, uint8_t *prevIndex)
-{
-  int code; /* ADPCM output value */
-  int diff; /* Difference between sample and the predicted sample */
-  int step; /* Quantizer step size */
-  int predSample; /* Output of ADPCM predictor */
-  int diffq; /* Dequantized predicted difference */
-  int index; /* Index into step size table */
+  NVS_read(nvsHandle, offset + offsetof(ctx_t, recPos), &recPos,
+           sizeof(recPos));
+  if (recPos != pos)
+    return false;
 
-  /* Restore previous values of predicted sample and quantizer step size index */
-  predSample = (int) (*prevSample);
-  index = *prevIndex;
-  step = StepSizeTable[index];
+  uint32_t marker;
+  NVS_read(nvsHandle, offset, &marker, sizeof(marker));
+  if (sectFill(marker) < ADPCM_SIZE_PER_SECT)
+    return true;  // committed on stop
 
-  /* Compute the difference between the acutal sample (sample) and the
-   * the predicted sample (predsample)
-   */
-  diff = sample - predSample;
-  if (diff >= 0)
-    code = 0;
-  else
-  {
-    code = 8;
-    diff = -diff;
-  }
-  /* Quantize the difference into the 4-bit ADPCM code using the
-   * the quantizer step size
-   */
-  /* Inverse quantize the ADPCM code into a predicted difference
-   * using the quantizer step size
-   */
-  diffq = step >> 3;
-  if (diff >= step)
+  NVS_read(nvsHandle, offset + offsetof(ctx_t, recAdpcmStateInSect), &state,
+           sizeof(state));
+  if (state.format & FMT_SILENCE)
   {
-    code |= 4;
-    diff -= step;
-    diffq += step;
+    uint32_t count;
+    NVS_read(nvsHandle, offset + SECT_HEADER_SIZE, &count, sizeof(count));
+    return count != 0xffffffff;
   }
-  step >>= 1;
-  if (diff >= step)
+
+  return !flashIsBlank(offset + SECT_SIZE - FLASH_PAGE_SIZE, FLASH_PAGE_SIZE);
+}
+
+/*
+ * increment counter including flip
+ */
+static void incrementCounter(void)
+{
+  if (markedBitsLo < SECT_SIZE * 8)
   {
-    code |= 2;
-    diff -= step;
-    diffq += step;
+    incrementMarkedBits(LOSECT_INDEX, markedBitsLo++);
   }
-  step >>= 1;
-  if (diff >= step)
+  else
   {
-    code |= 1;
-    diffq += step;
+    incrementMarkedBits(HISECT_INDEX, markedBitsHi++);
+    resetLowCounter();
+    incrementMarkedBits(HISECT_INDEX, markedBitsHi++);
   }
-  /* Fixed predictor computes new predicted sample by adding the
-   * old predicted sample to predicted difference
-   */
-  if (code & 8)
-    predSample -= diffq;
-  else
-    predSample += diffq;
-  /* Check for overflow of the new predicted sample */
-  if (predSample > 32767)
-    predSample = 32767;
-  else if (predSample < -32767)
-    predSample = -32767;
-  /* Find new quantizer stepsize index by adding the old index
-   * to a table lookup using the ADPCM code
-   */
-  index += IndexTable[code];
-  /* Check for overflow of the new quantizer step size index */
-  if (index < 0)
-    index = 0;
-  if (index > 88)
-    index = 88;
-  /* Save the predicted sample and quantizer step size index for next iteration */
-  *prevSample = (short) predSample;
-  *prevIndex = index;
-
-  /* Return the new ADPCM code */
-  return (code & 0x0f);
 }
 
-static short adpcmDecoder(char code, int16_t* prevSample, uint8_t *prevIndex)
+/*
+ * Check of a journal entry, Fletcher-16 over it with the check bits clear.
+ */
+uint16_t recEntryCheck(const RecEntry_t *entry)
 {
-  int predsample;
-  int index;
-  int step;
-  int diffq;
+  RecEntry_t e = *entry;
+  uint8_t a, b;
 
-  /* Restore previous values of predicted sample and quantizer step
-   size index
-   */
-  predsample = *prevSample;
-  index = *prevIndex;
-  /* Find quantizer step size from lookup table using index
-   */
-  step = StepSizeTable[index];
-  /* Inverse quantize the ADPCM code into a difference using the
-   quantizer step size
-   */
-  diffq = step >> 3;
-  if (code & 4)
-    diffq += step;
-  if (code & 2)
-    diffq += step >> 1;
-  if (code & 1)
-    diffq += step >> 2;
-  /* Add the difference to the predicted sample
-   */
-  if (code & 8)
-    predsample -= diffq;
-  else
-    predsample += diffq;
-  /* Check for overflow of the new predicted sample
-   */
-  if (predsample > 32767)
-    predsample = 32767;
-  else if (predsample < -32768)
-    predsample = -32768;
-  /* Find new quantizer step size by adding the old index and a
-   table lookup using the ADPCM code
-   */
-  index += IndexTable[code];
-  /* Check for overflow of the new quantizer step size index
-   */
-  if (index < 0)
-    index = 0;
-  if (index > 88)
-    index = 88;
-  /* Save predicted sample and quantizer step size index for next
-   iteration
-   */
-  *prevSample = predsample;
-  *prevIndex = index;
-  /* Return the new speech sample */
-  return (int16_t)(predsample);
+  e.flags &= ~(0xffffu << REC_FLAGS_CHECK_SHIFT);
+  checksum(&e, sizeof(e), &a, &b);
+  return (uint16_t) ((a << 8) | b);
+}
+
+static bool slotBlank(const uint8_t *p)
+{
+  for (size_t k = 0; k < sizeof(RecEntry_t); k++)
+  {
+    if (p[k] != 0xff)
+      return false;
+  }
+  return true;
 }
 
 /*
- * Calculate checksum, ublox
+ * Flash offset of entry i, counted over the sectors in seq order.
  */
-void checksum(void *p, uint32_t len, uint8_t *a, uint8_t *b)
+static size_t journalOffset(uint32_t i)
 {
-  uint8_t *arr = (uint8_t*) p;
-  *a = 0;
-  *b = 0;
-  for (int i = 0; i < len; i++)
+  for (uint32_t k = 0; k < journalSects; k++)
   {
-    *a += arr[i];
-    *b += *a;
+    uint8_t s = journalOrder[k];
+    if (i < journalFill[s])
+    {
+      return JOURNAL_SECT_OFFSET(s) + (1 + i) * sizeof(RecEntry_t);
+    }
+    i -= journalFill[s];
+  }
+  return JOURNAL_SECT_OFFSET(0);    // not reached, i < journalCount
+}
+
+static void journalErase(int s)
+{
+  if (!flashIsBlank(JOURNAL_SECT_OFFSET(s), SECT_SIZE))
+  {
+    NVS_erase(nvsHandle, JOURNAL_SECT_OFFSET(s), SECT_SIZE);
   }
 }
 
 /*
- * Count marked (cleared) bits in given sector and size
- * size is 4096 for low counter and 2048 for high counter
+ * Validate journal sector s: a complete header, entries that check and
+ * follow each other up to the first blank slot, blank after it. Returns
+ * the entries, -1 if the header is not complete. *closed is set if the
+ * sector takes no more appends: full, or a torn or bad entry or stray bits
+ * after the last one (power failed during an append).
  */
-static int countMarkedBits(int sectIndex, size_t size)
+static int journalScan(int s, JournalHeader_t *hdr, bool *closed)
 {
-  uint8_t buf[256];
-  bool countComplete = false;
+  uint8_t buf[COUNTER_CHUNK_SIZE];
+  size_t offset = JOURNAL_SECT_OFFSET(s);
+  uint32_t prevEnd = 0;
   int count = 0;
+  bool ended = false;
+
+  NVS_read(nvsHandle, offset, hdr, sizeof(*hdr));
+  if (hdr->magic != JOURNAL_MAGIC || hdr->done != 0 || hdr->seqEnd < hdr->seq)
+    return -1;
 
-  for (int i = 0; i < size / 256; i++)
+  *closed = true;
+  for (size_t i = 0; i < SECT_SIZE; i += sizeof(buf))
   {
-    NVS_read(nvsHandle, SECT_OFFSET(sectIndex) + i * 256, buf, 256);
-    for (int j = 0; j < 256; j++)
+    NVS_read(nvsHandle, offset + i, buf, sizeof(buf));
+    for (size_t j = i ? 0 : sizeof(RecEntry_t); j < sizeof(buf);
+        j += sizeof(RecEntry_t))
     {
-      if (countComplete)
+      const RecEntry_t *e = (const RecEntry_t*) &buf[j];
+      if (slotBlank(&buf[j]))
       {
-        if (buf[j] != 0xff)
-          return -1;
+        ended = true;
+      }
+      else if (ended || !(e->start < e->end && e->start >= prevEnd)
+          || e->flags >> REC_FLAGS_CHECK_SHIFT != recEntryCheck(e))
+      {
+        return count;
       }
       else
       {
-        if (buf[j] == 0)
-        {
-          count += 8;
-        }
-        else
-        {
-          switch (buf[j])
-          {
-          // @formatter:off
-          case 0x01: count += 7; break;
-          case 0x03: count += 6; break;
-          case 0x07: count += 5; break;
-          case 0x0f: count += 4; break;
-          case 0x1f: count += 3; break;
-          case 0x3f: count += 2; break;
-          case 0x7f: count += 1; break;
-          case 0xff: count += 0; break;
-          default: return -1;
-          // @formatter:on
-}          countComplete = true;
-        }
+        prevEnd = e->end;
+        count++;
       }
     }
   }
+
+  *closed = count == JOURNAL_PER_SECT;
   return count;
 }
 
 /*
- * clear one more bit on given sector, and position
+ * Validate every journal sector (journalScan()), erasing those without a
+ * complete header unless blank. A sector whose seq range contains another
+ * one's is the copy of a compaction that completed, the other one is one
+ * of its sources and is erased too. The rest is put in seq order; the last
+ * one takes appends unless closed.
  */
-static void incrementMarkedBits(int sectIndex, size_t current)
-{
-  int offset = SECT_OFFSET(sectIndex) + current / 8;
-  NVS_write(nvsHandle, offset, (void*) &markedBytes[current % 8], 1,
-  NVS_WRITE_POST_VERIFY);
-}
-
-static uint32_t readMagic(void)
+static void journalMount(void)
 {
-  uint32_t magic;
-  NVS_read(nvsHandle, HISECT_OFFSET + 2048, &magic, sizeof(uint32_t));
-  return magic;
-}
+  int fill[JOURNAL_SECT_NUM];
+  bool closed[JOURNAL_SECT_NUM];
+  uint32_t t0 = Clock_getTicks();
 
-static void resetLowCounter(void)
-{
-  NVS_erase(nvsHandle, LOSECT_OFFSET, SECT_SIZE);
-  markedBitsLo = 0;
-  incrementMarkedBits(LOSECT_INDEX, markedBitsLo++);
-}
+  for (int s = 0; s < JOURNAL_SECT_NUM; s++)
+  {
+    JournalHeader_t hdr;
+    fill[s] = journalScan(s, &hdr, &closed[s]);
+    if (fill[s] < 0)
+    {
+      journalErase(s);
+      continue;
+    }
+    journalSeq[s] = hdr.seq;
+    journalSeqEnd[s] = hdr.seqEnd;
+  }
 
-static void resetCounter(void)
-{
-  // erase high sect
-  NVS_erase(nvsHandle, HISECT_OFFSET, SECT_SIZE);
+  for (int s = 0; s < JOURNAL_SECT_NUM; s++)
+  {
+    for (int t = 0; t < JOURNAL_SECT_NUM && fill[s] >= 0; t++)
+    {
+      if (t == s || fill[t] < 0 || journalSeq[t] < journalSeq[s]
+          || journalSeqEnd[t] > journalSeqEnd[s])
+        continue;
+
+      if (journalSeq[t] == journalSeq[s] && journalSeqEnd[t] == journalSeqEnd[s]
+          && t < s)
+        continue;   // the same range twice, keep the first
+
+      Display_print3(dispHandle, 0xff, 0, "journal     : sect %d in compacted %d, seq %d",
+                     t, s, journalSeq[t]);
+      NVS_erase(nvsHandle, JOURNAL_SECT_OFFSET(t), SECT_SIZE);
+      fill[t] = -1;
+    }
+  }
 
-  // erase and init low counter
-  resetLowCounter();
+  journalSects = 0;
+  journalCount = 0;
+  journalNextSeq = 0;
+  for (int s = 0; s < JOURNAL_SECT_NUM; s++)
+  {
+    if (fill[s] < 0)
+      continue;
 
-  // init high counter
-  markedBitsHi = 0;
-  incrementMarkedBits(HISECT_INDEX, markedBitsHi++);
-  incrementMarkedBits(HISECT_INDEX, markedBitsHi++);  // twice
+    uint32_t k = journalSects++;
+    while (k > 0 && journalSeq[journalOrder[k - 1]] > journalSeq[s])
+    {
+      journalOrder[k] = journalOrder[k - 1];
+      k--;
+    }
+    journalOrder[k] = s;
+    journalFill[s] = fill[s];
+    journalCount += fill[s];
+    if (journalSeqEnd[s] >= journalNextSeq)
+    {
+      journalNextSeq = journalSeqEnd[s] + 1;
+    }
+  }
+  journalOpen = journalSects > 0 && !closed[journalOrder[journalSects - 1]];
 
-  // write magic
-  uint32_t magic = MAGIC;
-  NVS_write(nvsHandle, HISECT_OFFSET + 2048, &magic, sizeof(magic),
-  NVS_WRITE_POST_VERIFY);
+  Display_print3(dispHandle, 0xff, 0, "journal     : %d entries in %d sectors, %d ticks",
+                 journalCount, journalSects, Clock_getTicks() - t0);
 }
 
-static void loadCounter(void)
+/*
+ * Erase the first n sectors in seq order.
+ */
+static void journalDrop(uint32_t n)
 {
-  static bool initialized = false;
-  if (!initialized)
+  for (uint32_t k = 0; k < n; k++)
   {
-    uint8_t dur;
-    NVS_read(nvsHandle, DUR_SECT_OFFSET, &dur, 1);
-    Display_print1(dispHandle, 0xff, 0, "duration    : %d", dur);
+    uint8_t s = journalOrder[k];
+    NVS_erase(nvsHandle, JOURNAL_SECT_OFFSET(s), SECT_SIZE);
+    journalCount -= journalFill[s];
+  }
+  journalSects -= n;
+  memmove(journalOrder, &journalOrder[n], journalSects);
+}
 
-    if (dur == 10)
+/*
+ * A sector not in use, the first after the last one in use, for wear.
+ */
+static int journalFree(void)
+{
+  int last = journalSects ? journalOrder[journalSects - 1] : JOURNAL_SECT_NUM - 1;
+
+  for (int k = 1; k <= JOURNAL_SECT_NUM; k++)
+  {
+    int s = (last + k) % JOURNAL_SECT_NUM;
+    uint32_t j = 0;
+    while (j < journalSects && journalOrder[j] != s)
     {
-      simpleProfileChar2 = 10;
+      j++;
     }
-    else if (dur == 15)
+    if (j == journalSects)
+      return s;
+  }
+  return 0;   // not reached, one sector is kept free
+}
+
+/*
+ * Entries at the start of sector s whose recording has been overwritten
+ * (or erased ahead) in the data area.
+ */
+static uint32_t journalDead(uint8_t s)
+{
+  uint32_t front = ctx.eraseFront > ctx.recPos ? ctx.eraseFront : ctx.recPos;
+  uint32_t horizon = front > DATA_SECT_COUNT ? front - DATA_SECT_COUNT : 0;
+  uint32_t lo = 0, hi = journalFill[s];
+
+  while (lo < hi)
+  {
+    uint32_t mid = (lo + hi) / 2;
+    uint32_t end;
+    NVS_read(nvsHandle, JOURNAL_SECT_OFFSET(s) + (1 + mid) * sizeof(RecEntry_t)
+             + offsetof(RecEntry_t, end), &end, sizeof(end));
+    if (end <= horizon)
     {
-      simpleProfileChar2 = 15;
+      lo = mid + 1;
     }
     else
     {
-      simpleProfileChar2 = 5;
+      hi = mid;
     }
+  }
+  return lo;
+}
 
-    if (MAGIC != readMagic())
-    {
-      resetCounter();
-      return;
-    }
+/*
+ * Copy the live entries of the first n sectors in seq order (the first
+ * one's after its dead ones) to a free sector, which replaces them. Its
+ * header covers their seq ranges and is marked done after the last entry:
+ * power failing before that leaves the copy to be erased at mount, after
+ * it the sources.
+ */
+static void journalCompact(uint32_t n, uint32_t dead)
+{
+  uint8_t buf[COUNTER_CHUNK_SIZE];
+  int t = journalFree();
+  size_t to = JOURNAL_SECT_OFFSET(t);
+  JournalHeader_t hdr = { JOURNAL_MAGIC, journalSeq[journalOrder[0]],
+                          journalSeqEnd[journalOrder[n - 1]], 0xffffffff };
+  uint32_t fill = 0;
 
-    markedBitsHi = countMarkedBits(HISECT_INDEX, 2048);
-    if (markedBitsHi <= 1)
-    {
-      resetCounter();
-      return;
-    }
+  journalErase(t);
+  NVS_write(nvsHandle, to, &hdr, sizeof(hdr), NVS_WRITE_POST_VERIFY);
 
-    if (markedBitsHi % 2 == 1) // unfinished carrying bit
+  for (uint32_t k = 0; k < n; k++)
+  {
+    uint8_t s = journalOrder[k];
+    for (uint32_t i = k ? 0 : dead; i < journalFill[s];)
     {
-      resetLowCounter();
-      incrementMarkedBits(HISECT_INDEX, markedBitsHi++);
+      uint32_t m = journalFill[s] - i;
+      if (m > sizeof(buf) / sizeof(RecEntry_t))
+      {
+        m = sizeof(buf) / sizeof(RecEntry_t);
+      }
+      NVS_read(nvsHandle, JOURNAL_SECT_OFFSET(s) + (1 + i) * sizeof(RecEntry_t),
+               buf, m * sizeof(RecEntry_t));
+      NVS_write(nvsHandle, to + (1 + fill) * sizeof(RecEntry_t), buf,
+                m * sizeof(RecEntry_t), NVS_WRITE_POST_VERIFY);
+      i += m;
+      fill += m;
     }
+  }
 
-    markedBitsLo = countMarkedBits(LOSECT_INDEX, 4096);
-    initialized = true;
+  hdr.done = 0;
+  NVS_write(nvsHandle, to + offsetof(JournalHeader_t, done), &hdr.done,
+            sizeof(hdr.done), NVS_WRITE_POST_VERIFY);
+
+  journalDrop(n);
+  memmove(&journalOrder[1], &journalOrder[0], journalSects);
+  journalOrder[0] = t;
+  journalSects++;
+  journalSeq[t] = hdr.seq;
+  journalSeqEnd[t] = hdr.seqEnd;
+  journalFill[t] = fill;
+  journalCount += fill;
+
+  Display_print4(dispHandle, 0xff, 0, "journal     : %d sectors compacted into %d, %d entries, %d dead",
+                 n, t, fill, dead);
+}
+
+/*
+ * Free at least one journal sector. Dead entries (journalDead()) are a
+ * prefix of the journal: the oldest sector is erased if it has only dead
+ * ones. Otherwise the live entries of as many of the oldest sectors as fit
+ * in one are compacted into the free sector; if not even two fit, the
+ * journal is full of live entries and the oldest sector is dropped.
+ */
+static void journalReclaim(void)
+{
+  uint8_t oldest = journalOrder[0];
+  uint32_t dead = journalDead(oldest);
+  uint32_t live = journalFill[oldest] - dead;
+
+  if (live == 0)
+  {
+    Display_print2(dispHandle, 0xff, 0, "journal     : sect %d erased, %d dead entries",
+                   oldest, dead);
+    journalDrop(1);
+    return;
+  }
+
+  uint32_t n = 1;
+  uint32_t total = live;
+  while (n < journalSects
+      && total + journalFill[journalOrder[n]] <= JOURNAL_PER_SECT)
+  {
+    total += journalFill[journalOrder[n++]];
+  }
+
+  if (n < 2)
+  {
+    journalDropped += live;
+    Display_print2(dispHandle, 0xff, 0, "journal     : full, sect %d dropped, %d live entries",
+                   oldest, live);
+    journalDrop(1);
+    return;
   }
+
+  journalCompact(n, dead);
 }
 
 /*
- * increment counter including flip
+ * Start a sector for appends, last in seq order. One sector is kept free
+ * for journalCompact().
  */
-static void incrementCounter(void)
+static void journalNewSector(void)
 {
-  if (markedBitsLo < SECT_SIZE * 8)
+  while (journalSects + 2 > JOURNAL_SECT_NUM)
   {
-    incrementMarkedBits(LOSECT_INDEX, markedBitsLo++);
+    journalReclaim();
   }
-  else
+
+  int s = journalFree();
+  JournalHeader_t hdr = { JOURNAL_MAGIC, journalNextSeq, journalNextSeq, 0 };
+
+  journalErase(s);
+  NVS_write(nvsHandle, JOURNAL_SECT_OFFSET(s), &hdr, sizeof(hdr),
+            NVS_WRITE_POST_VERIFY);
+  journalSeq[s] = journalSeqEnd[s] = journalNextSeq++;
+  journalFill[s] = 0;
+  journalOrder[journalSects++] = s;
+  journalOpen = true;
+}
+
+/*
+ * Append one entry, setting its check. A slot that does not verify ends
+ * the sector, as journalScan() would at mount, and the entry goes to a
+ * new one.
+ */
+static void journalAppend(RecEntry_t *entry)
+{
+  entry->flags &= REC_FLAGS_FMT_MASK;
+  entry->flags |= (uint32_t) recEntryCheck(entry) << REC_FLAGS_CHECK_SHIFT;
+
+  for (int tries = 0; tries < 2; tries++)
   {
-    incrementMarkedBits(HISECT_INDEX, markedBitsHi++);
-    resetLowCounter();
-    incrementMarkedBits(HISECT_INDEX, markedBitsHi++);
+    if (!journalOpen)
+    {
+      journalNewSector();
+    }
+
+    uint8_t s = journalOrder[journalSects - 1];
+    size_t offset = JOURNAL_SECT_OFFSET(s)
+        + (1 + journalFill[s]) * sizeof(RecEntry_t);
+    if (NVS_write(nvsHandle, offset, entry, sizeof(RecEntry_t),
+                  NVS_WRITE_POST_VERIFY) == NVS_STATUS_SUCCESS)
+    {
+      journalFill[s]++;
+      journalCount++;
+      journalOpen = journalFill[s] < JOURNAL_PER_SECT;
+
+      Display_print3(dispHandle, 0xff, 0, "journal     : #%d [%08x, %08x)",
+                     journalCount - 1, entry->start, entry->end);
+      return;
+    }
+    journalOpen = false;
   }
 }
 
-/**
- * @fn loadPrevStarts
- *
+/*
+ * Index of the first entry with end > sector, or journalCount.
  */
-static void loadRecordings(void)
+static uint32_t journalFind(uint32_t sector)
 {
-  uint32_t counter = MONOTONIC_COUNTER;
-  if (counter == 0)
+  uint32_t lo = 0, hi = journalCount;
+  while (lo < hi)
   {
-    for (int i = 0; i < NUM_RECS; i++)
+    uint32_t mid = lo + (hi - lo) / 2;
+    uint32_t end;
+    NVS_read(nvsHandle, journalOffset(mid) + offsetof(RecEntry_t, end), &end,
+             sizeof(end));
+    if (end <= sector)
+    {
+      lo = mid + 1;
+    }
+    else
     {
-      ctx.recordings[i] = 0xFFFFFFFF;
+      hi = mid;
     }
   }
-  else
+  return lo;
+}
+
+/*
+ * Send a page of journal entries, beginning with the recording that ends
+ * after sector. Client asks for next page with end of last entry. Returns
+ * false, sending nothing, if not even one entry fits in a notification:
+ * an empty page would read as the end of the list.
+ */
+static bool sendRecsMsg(uint32_t sector)
+{
+  uint32_t max = (attMtu - 3 - RECS_HEADER_SIZE) / sizeof(RecEntry_t);
+  if (max == 0)
+  {
+    Display_print1(dispHandle, 0xff, 0, "list recs   : mtu %d too small",
+                   attMtu);
+    return false;
+  }
+  if (max > RECS_PAGE_MAX)
+  {
+    max = RECS_PAGE_MAX;
+  }
+
+  OutgoingMsg_t *outmsg = (OutgoingMsg_t*) List_get(&freeOutgoingMsgs);
+  RecsPacket_t *pkt = &outmsg->recs;
+
+  uint32_t i = journalFind(sector);
+  uint32_t n = journalCount - i;
+  if (n > max)
+  {
+    n = max;
+  }
+
+  for (uint32_t k = 0; k < n; k++)
   {
-    // skip earlist one
-    size_t offset = (counter - 1) % DATA_SECT_COUNT * SECT_SIZE + 4;
-    NVS_read(nvsHandle, offset, &ctx, sizeof(uint32_t) * NUM_RECS);
+    NVS_read(nvsHandle, journalOffset(i + k), &pkt->entries[k],
+             sizeof(RecEntry_t));
   }
 
-  ctx.recStart = counter;
-  ctx.recPos = counter;
+  pkt->version = BADPCM_RECS;
+  pkt->count = n;
+  pkt->reserved = 0;
+  pkt->total = journalCount;
+
+  outmsg->type = OMT_RECS;
+  outmsg->len = RECS_HEADER_SIZE + n * sizeof(RecEntry_t);
+
+  Display_print3(dispHandle, 0xff, 0, "list recs   : from %08x, #%d, %d entries",
+                 sector, i, n);
+
+  sendOutgoingMsg(outmsg);
+  return true;
 }
 
 /*
@@ -1467,39 +3457,20 @@ static void sendStatusMsg(void)
 {
   OutgoingMsg_t *outmsg = (OutgoingMsg_t*) List_get(&freeOutgoingMsgs);
 
-  memcpy(outmsg->status.recordings, &ctx.recordings,
-         sizeof(uint32_t) * NUM_RECS);
   outmsg->status.recStart = ctx.recStart;
   outmsg->status.recPos = ctx.recPos;
   outmsg->status.readStart = ctx.readStart;
   outmsg->status.readEnd = ctx.readEnd;
   outmsg->status.readPosMajor = ctx.readPosMajor;
   outmsg->status.readPosMinor = ctx.readPosMinor;
-  outmsg->status.flags = ctx.recording ? 1 : 0 + ctx.reading ? 2 : 0;
+  outmsg->status.flags = (ctx.recording ? 1 : 0) | (ctx.reading ? 2 : 0)
+      | (ctx.monitoring ? 4 : 0);
   outmsg->type = OMT_STATUS;
 
 
 #ifndef Display_DISABLE_ALL
-  Display_print5(dispHandle, 0xff, 0, "status: recordings %08x %08x %08x %08x %08x",
-                 outmsg->status.recordings[0], outmsg->status.recordings[1],
-                 outmsg->status.recordings[2], outmsg->status.recordings[3],
-                 outmsg->status.recordings[4]);
-  Display_print5(dispHandle, 0xff, 0, "                   %08x %08x %08x %08x %08x",
-                 outmsg->status.recordings[5], outmsg->status.recordings[6],
-                 outmsg->status.recordings[7], outmsg->status.recordings[8],
-                 outmsg->status.recordings[9]);
-  Display_print5(dispHandle, 0xff, 0, "                   %08x %08x %08x %08x %08x",
-                 outmsg->status.recordings[10], outmsg->status.recordings[11],
-                 outmsg->status.recordings[12], outmsg->status.recordings[13],
-                 outmsg->status.recordings[14]);
-  Display_print5(dispHandle, 0xff, 0, "                   %08x %08x %08x %08x %08x",
-                 outmsg->status.recordings[15], outmsg->status.recordings[16],
-                 outmsg->status.recordings[17], outmsg->status.recordings[18],
-                 outmsg->status.recordings[19]);
-  Display_print1(dispHandle, 0xff, 0, "                   %08x",
-                 outmsg->status.recordings[20]);
   Display_print3(dispHandle, 0xff, 0,
-                 "        recording: %d, recStart %08x, recPos %08x",
+                 "status: recording: %d, recStart %08x, recPos %08x",
                  outmsg->status.flags & 0x00000001, outmsg->status.recStart,
                  outmsg->status.recPos);
   Display_print5(dispHandle, 0xff, 0,
@@ -1556,8 +3527,31 @@ void Audio_updateDuration(uint8_t dur)
   }
 }
 
+void Audio_updateCodec(uint8_t bits)
+{
+  if (bits == 3)
+  {
+    Event_post(audioEvent, UPDATE_CODEC_3);
+  }
+  else if (bits == 4)
+  {
+    Event_post(audioEvent, UPDATE_CODEC_4);
+  }
+}
+
+void Audio_updateRate(uint8_t khz)
+{
+  if (khz == 8)
+  {
+    Event_post(audioEvent, UPDATE_RATE_08);
+  }
+  else if (khz == 16)
+  {
+    Event_post(audioEvent, UPDATE_RATE_16);
+  }
+}
+
 void Audio_stopRec(void)
 {
   Event_post(audioEvent, AUDIO_STOP_REC);
 }
-
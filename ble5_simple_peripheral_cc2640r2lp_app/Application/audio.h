@@ -24,6 +24,9 @@ void Audio_createTask(void);
 void Audio_subscribe();
 void Audio_unsubscribe();
 void Audio_updateDuration(uint8_t dur);
+void Audio_updateCodec(uint8_t bits);
+void Audio_updateRate(uint8_t khz);
+void Audio_updateMtu(uint16_t mtu);
 void Audio_stopRec(void);
 
 #define IMT_NOOP                        (0)
@@ -31,6 +34,17 @@ void Audio_stopRec(void);
 #define IMT_START_REC                   (2)
 #define IMT_STOP_READ                   (3)
 #define IMT_START_READ                  (4)
+#define IMT_START_READ_V2               (5)   // same as START_READ, v2 packets
+#define IMT_GRANT                       (6)   // start: credits (packets)
+#define IMT_ACK                         (7)   // start: major, end: minor, range
+#define IMT_RESUME_READ                 (8)   // resume from last ack
+#define IMT_START_READ_MULTI            (9)   // ranges, v2 packets
+#define IMT_START_MONITOR               (10)  // live chunks, v1 packets
+#define IMT_STOP_MONITOR                (11)
+#define IMT_LIST_RECS                   (12)  // start: sector, one page
+
+#define READ_RANGES_MAX                 8     // [start, end) pairs per command
+#define ACK_RANGE_CURRENT               0xff  // 9-byte ack, range being read
 
 typedef uint32_t IncomingMsgType;
 
@@ -40,6 +54,11 @@ typedef struct IncomingMsg
   IncomingMsgType type;
   uint32_t start;
   uint32_t end;
+  uint32_t startMinor;                        // packet index, 17-byte form
+  uint32_t endMinor;
+  uint32_t count;                             // IMT_START_READ_MULTI only
+  uint32_t range;                             // IMT_ACK only, range index
+  uint32_t ranges[READ_RANGES_MAX][2];
 } IncomingMsg_t;
 
 void recvIncomingMsg(IncomingMsg_t* msg);
@@ -58,7 +77,26 @@ IncomingMsg_t* allocIncomingMsg(void);
 // extern Mailbox_Handle incomingMailbox;
 
 #define BADPCM_DATA_SIZE                  160
-#define NUM_RECS                          21
+#define BADPCM_SECT_DATA_SIZE             (BADPCM_DATA_SIZE * 25)  // per sector
+
+/*
+ * Sector format, stored in the format byte of sector header adpcm state and
+ * in the upper 3 bits of badpcm packet minor (lower 5 bits are chunk index).
+ */
+#define FMT_ADPCM3                        (1 << 0)  // 3-bit, otherwise 4-bit
+#define FMT_8KHZ                          (1 << 1)  // 8000, otherwise 16000
+#define FMT_SILENCE                       (1 << 2)  // silence marker, no adpcm
+
+#define BADPCM_MINOR_MASK                 0x1f
+#define BADPCM_FMT_SHIFT                  5
+#define BADPCM_FMT_MASK                   0x07
+
+/*
+ * samples per badpcm packet, 4-bit: 320, 3-bit: 53 groups of 8 (last byte pad)
+ */
+#define BADPCM_SAMPLES(fmt)               (((fmt) & FMT_ADPCM3) ? \
+                                           (BADPCM_DATA_SIZE / 3 * 8) : \
+                                           (BADPCM_DATA_SIZE * 2))
 
 typedef struct __attribute__ ((__packed__)) BadpcmPacket
 {
@@ -72,10 +110,109 @@ typedef struct __attribute__ ((__packed__)) BadpcmPacket
 _Static_assert(sizeof(BadpcmPacket_t)==BADPCM_DATA_SIZE + 8,
                "wrong badcpm packet size");
 
+/*
+ * v2 packet, sent only after IMT_START_READ_V2. Variable length, filled up
+ * to ATT MTU - 3. offset is the byte offset of data in the 4000-byte sector
+ * data. If BADPCM_V2_STATE is set in format, body begins with the codec
+ * state of the sector (int16_t sample, uint8_t index), which is the case
+ * for the first packet (offset 0) of each sector. BADPCM_V2_STALE is set
+ * if the sector was overwritten by recording before the packet was sent,
+ * the data is not that of major.
+ *
+ * Only the header (and state) is kept in OutgoingMsg_t, data follows on
+ * the air and is read from flash straight into the notification buffer,
+ * see readOutgoingMsg().
+ */
+#define BADPCM_V2                         0xA2
+#define BADPCM_V2_STATE                   (1 << 7)
+#define BADPCM_V2_STALE                   (1 << 6)  // overwritten, discard
+#define BADPCM_V2_HEADER_SIZE             8
+#define BADPCM_V2_STATE_SIZE              3
+#define BADPCM_V2_MAX_SIZE                244   // 251 mtu - 4 l2cap - 3 att
+
+typedef struct __attribute__ ((__packed__)) BadpcmPacketV2
+{
+  uint8_t version;      // BADPCM_V2
+  uint8_t format;       // sector format, BADPCM_V2_STATE, BADPCM_V2_STALE
+  uint16_t offset;
+  uint32_t major;
+  uint8_t body[BADPCM_V2_STATE_SIZE];
+} BadpcmPacketV2_t;
+
+_Static_assert(sizeof(BadpcmPacketV2_t)==BADPCM_V2_HEADER_SIZE + BADPCM_V2_STATE_SIZE,
+               "wrong badcpm v2 packet size");
+
+/*
+ * range marker, sent before the data of each range in IMT_START_READ_MULTI.
+ */
+#define BADPCM_RANGE                      0xA3
+
+typedef struct __attribute__ ((__packed__)) RangePacket
+{
+  uint8_t version;      // BADPCM_RANGE
+  uint8_t index;        // range index in command
+  uint8_t count;        // number of ranges in command
+  uint8_t reserved;
+  uint32_t start;
+  uint32_t end;
+} RangePacket_t;
+
+_Static_assert(sizeof(RangePacket_t) == 12, "wrong range packet size");
+
+/*
+ * recording journal entry, as stored in flash, and a page of them sent for
+ * IMT_LIST_RECS: entries with end > given sector, as many as mtu allows.
+ */
+typedef struct __attribute__ ((__packed__)) RecEntry
+{
+  uint32_t start;
+  uint32_t end;         // exclusive
+  uint32_t flags;       // bit 0-2: format, bit 16-31: check, see recEntryCheck()
+  uint32_t uptime;      // seconds since boot at stop, no rtc
+} RecEntry_t;
+
+#define REC_FLAGS_FMT_MASK                0x0007
+#define REC_FLAGS_CHECK_SHIFT             16
+
+/*
+ * first slot of each journal sector. A sector compacted from several
+ * covers their seq range [seq, seqEnd]; done is programmed to 0 last, a
+ * sector without it is erased at mount.
+ */
+typedef struct __attribute__ ((__packed__)) JournalHeader
+{
+  uint32_t magic;       // JOURNAL_MAGIC
+  uint32_t seq;
+  uint32_t seqEnd;
+  uint32_t done;
+} JournalHeader_t;
+
+#define JOURNAL_MAGIC                     0x4A524543
+
+_Static_assert(sizeof(JournalHeader_t) == sizeof(RecEntry_t),
+               "journal header is one slot");
+
+uint16_t recEntryCheck(const RecEntry_t *entry);
+
+#define BADPCM_RECS                       0xA4
+#define RECS_HEADER_SIZE                  8
+#define RECS_PAGE_MAX                     10
+
+typedef struct __attribute__ ((__packed__)) RecsPacket
+{
+  uint8_t version;      // BADPCM_RECS
+  uint8_t count;        // entries in this page
+  uint16_t reserved;
+  uint32_t total;       // entries in journal
+  RecEntry_t entries[RECS_PAGE_MAX];
+} RecsPacket_t;
+
+_Static_assert(sizeof(RecsPacket_t) == RECS_HEADER_SIZE + RECS_PAGE_MAX * 16,
+               "wrong recs packet size");
+
 typedef struct __attribute__ ((__packed__)) StatusPacket
 {
-  uint32_t flags; /* 1 << 0 recording, 1 << 1 reading */
-  uint32_t recordings[NUM_RECS];
+  uint32_t flags; /* 1 << 0 recording, 1 << 1 reading, 1 << 2 monitoring */
   uint32_t recStart;
   uint32_t recPos;
   uint32_t readStart;
@@ -84,7 +221,7 @@ typedef struct __attribute__ ((__packed__)) StatusPacket
   uint32_t readPosMinor;
 } StatusPacket_t;
 
-_Static_assert(sizeof(StatusPacket_t) == 112, "wrong status packet size");
+_Static_assert(sizeof(StatusPacket_t) == 28, "wrong status packet size");
 
 /*
  * for alignment inside struct, OutgoingMsgType is defined to uint32_t,
@@ -92,6 +229,9 @@ _Static_assert(sizeof(StatusPacket_t) == 112, "wrong status packet size");
  */
 #define OMT_STATUS                        (0)
 #define OMT_BADPCM                        (1)
+#define OMT_BADPCM_V2                     (2)
+#define OMT_RANGE                         (3)
+#define OMT_RECS                          (4)
 
 typedef uint32_t OutgoingMsgType;
 
@@ -99,15 +239,23 @@ typedef struct __attribute__ ((__packed__)) OutgoingMsg
 {
   List_Elem listElem;
   OutgoingMsgType type;     // +   4 = 12
+  uint32_t len;             // +   4 = 16, OMT_BADPCM_V2 (incl. nvs data), OMT_RECS
+  uint32_t nvsOffset;       // +   4 = 20, OMT_BADPCM_V2 only
+  uint32_t nvsLen;          // +   4 = 24, OMT_BADPCM_V2 only
+  const uint8_t *nvsCache;  // +   4 = 28, OMT_BADPCM_V2, copy in read cache or NULL
   union
-  {                   // + 168 = 180
+  {                   // + 168 = 196
     uint8_t raw[0];
     BadpcmPacket_t bad;
+    BadpcmPacketV2_t bad2;
+    RangePacket_t range;
+    RecsPacket_t recs;
     StatusPacket_t status;
   };
 } OutgoingMsg_t;
 
 void sendOutgoingMsg(OutgoingMsg_t *msg);
 void freeOutgoingMsg(OutgoingMsg_t *msg);
+size_t readOutgoingMsg(OutgoingMsg_t *msg, uint8_t *buf, size_t len);
 
 #endif /* APPLICATION_AUDIO_H_ */
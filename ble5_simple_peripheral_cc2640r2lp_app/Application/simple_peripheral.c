@@ -139,10 +139,12 @@ extern gattAttribute_t *simpleProfileChar1ConfigAttrHandle;
 #define SP_UNSUBSCRIBE_EVT                      Event_Id_28
 #define SP_READABLE_EVT                         Event_Id_27
 #define SP_HTIMER_EVT                           Event_Id_26
+#define SP_CONN_EVT                             Event_Id_25
 
 // Bitwise OR of all RTOS events to pend on
 #define SP_ALL_EVENTS                           (SP_ICALL_EVT | SP_QUEUE_EVT | SP_SUBSCRIBE_EVT | \
-                                                 SP_UNSUBSCRIBE_EVT | SP_READABLE_EVT | SP_HTIMER_EVT )
+                                                 SP_UNSUBSCRIBE_EVT | SP_READABLE_EVT | SP_HTIMER_EVT | \
+                                                 SP_CONN_EVT )
 
 // Size of string-converted device address ("0xXXXXXXXXXXXX")
 #define SP_ADDR_STR_SIZE                        15
@@ -226,13 +228,40 @@ static GAP_Addr_Modes_t addrMode = DEFAULT_ADDRESS_MODE;
 bool subscriptionOn = false;
 static List_List pendingOutgoingMsgs;
 
+/*
+ * Notification flow control. When the stack is out of buffers, drain is
+ * retried at the end of each connection event (buffers are released when
+ * packets are acked). notiClock is only a fallback in case no connection
+ * event report arrives.
+ */
+#ifndef NOTI_FALLBACK_PERIOD
+#define NOTI_FALLBACK_PERIOD                    50  // ms
+#endif
+
 static Clock_Struct notiClock;
+static bool connEvtRegistered = false;
+
+static uint32_t notiAllocFails = 0;
+static uint32_t notiSendFails = 0;
+static uint32_t notiStalls = 0;
+static uint32_t notiConnEvtWakeups = 0;
+static uint32_t notiTimerWakeups = 0;
 
 void clockCallback(UArg a0)
 {
   Event_post(syncEvent, SP_HTIMER_EVT);
 }
 
+/*
+ * Called in stack context. The report is ICall_malloc'ed by the stack,
+ * not a message.
+ */
+static void SimplePeripheral_connEvtCB(Gap_ConnEventRpt_t *pReport)
+{
+  ICall_free(pReport);
+  Event_post(syncEvent, SP_CONN_EVT);
+}
+
 /*********************************************************************
  * LOCAL FUNCTIONS
  */
@@ -257,6 +286,8 @@ static bool SimplePeripheral_doNotify(int where);
 static void SimplePeripheral_onSubscribe(void);
 static void SimplePeripheral_onUnsubscribe(void);
 static void SimplePeripheral_drain(int where);
+static void SimplePeripheral_stall(void);
+static void SimplePeripheral_unstall(void);
 
 /*********************************************************************
  * EXTERN FUNCTIONS
@@ -408,7 +439,8 @@ static void SimplePeripheral_init(void)
 //  params.debugStallMode = GPTimerCC26XX_DEBUG_STALL_OFF;
 //  hTimer = GPTimerCC26XX_open(Board_GPTIMER0A, &params); // Board_GPTIMER0A
 
-  Util_constructClock(&notiClock, clockCallback, 10, 1, false, NULL);
+  Util_constructClock(&notiClock, clockCallback, NOTI_FALLBACK_PERIOD,
+                      NOTI_FALLBACK_PERIOD, false, NULL);
 
   subscriptionOn = false;
   List_clearList(&pendingOutgoingMsgs);
@@ -489,8 +521,15 @@ static void SimplePeripheral_taskFxn(UArg a0, UArg a1)
 
       if (events & SP_HTIMER_EVT)
       {
+        notiTimerWakeups++;
         SimplePeripheral_drain(1);
       }
+
+      if (events & SP_CONN_EVT)
+      {
+        notiConnEvtWakeups++;
+        SimplePeripheral_drain(3);
+      }
     }
   }
 }
@@ -568,6 +607,7 @@ static uint8_t SimplePeripheral_processGATTMsg(gattMsgEvent_t *pMsg)
   {
     // MTU size updated
     // Display_printf(dispHandle, SP_ROW_STATUS_1, 0, "MTU Size: %d", pMsg->msg.mtuEvt.MTU);
+    Audio_updateMtu(pMsg->msg.mtuEvt.MTU);
   }
 
   // Free message payload. Needed only for ATT Protocol messages
@@ -665,6 +705,7 @@ static void SimplePeripheral_processGapMessage(gapEventHdr_t *pMsg)
 
     SimplePeripheral_onUnsubscribe();
 
+    Audio_updateMtu(ATT_MTU_SIZE);
     Audio_unsubscribe();
     break;
   }
@@ -832,6 +873,15 @@ static bool SimplePeripheral_doNotify(int where)
   case OMT_BADPCM:
     len = sizeof(BadpcmPacket_t);
     break;
+  case OMT_BADPCM_V2:
+    len = msg->len;
+    break;
+  case OMT_RANGE:
+    len = sizeof(RangePacket_t);
+    break;
+  case OMT_RECS:
+    len = msg->len;
+    break;
   default:
     len = 0;
     break;
@@ -841,11 +891,20 @@ static bool SimplePeripheral_doNotify(int where)
                                          len, &noti.len);
   if (noti.pValue == NULL)
   {
+    notiAllocFails++;
     Display_print1(dispHandle, 0xff, 0, "------ notify failed, nomem, where %d", where);
     return false;
   }
 
-  memcpy(noti.pValue, msg->raw, noti.len);
+  noti.len = readOutgoingMsg(msg, noti.pValue, noti.len);
+  if (noti.len == 0)
+  {
+    // cannot be sent at this mtu, drop it
+    notiSendFails++;
+    Display_print1(dispHandle, 0xff, 0, "------ notify dropped, too long, where %d", where);
+    GATT_bm_free((gattMsg_t*) &noti, ATT_HANDLE_VALUE_NOTI);
+    return true;
+  }
   noti.handle = simpleProfileChar1ValueAttrHandle->handle;
   status = GATT_Notification(connList[0], &noti, 0);
 
@@ -861,6 +920,7 @@ static bool SimplePeripheral_doNotify(int where)
   }
   else
   {
+    notiSendFails++;
     Display_print2(dispHandle, 0xff, 0, "------ notify failed, code %d, where %d", status, where);
     GATT_bm_free((gattMsg_t*) &noti, ATT_HANDLE_VALUE_NOTI);
     return false;
@@ -877,13 +937,55 @@ static void SimplePeripheral_onSubscribe(void)
 static void SimplePeripheral_onUnsubscribe(void)
 {
   // SimplePeripheral_stopTimer();
+  SimplePeripheral_unstall();
+
+  subscriptionOn = false;
+  SimplePeripheral_drain(2);
+
+  Display_print5(dispHandle, 0xff, 0,
+                 "notify stats: alloc fail %d, send fail %d, stall %d, "
+                 "conn evt wakeup %d, timer wakeup %d",
+                 notiAllocFails, notiSendFails, notiStalls,
+                 notiConnEvtWakeups, notiTimerWakeups);
+}
+
+/*
+ * Out of stack buffers, wait for connection event (or fallback timer).
+ */
+static void SimplePeripheral_stall(void)
+{
+  if (!connEvtRegistered && connList[0] != CONNHANDLE_INVALID)
+  {
+    notiStalls++;
+    if (Gap_RegisterConnEventCb(SimplePeripheral_connEvtCB, GAP_CB_REGISTER,
+                                connList[0]) == SUCCESS)
+    {
+      connEvtRegistered = true;
+    }
+  }
+
+  if (!Util_isActive(&notiClock))
+  {
+    Util_startClock(&notiClock);
+  }
+}
+
+static void SimplePeripheral_unstall(void)
+{
+  if (connEvtRegistered)
+  {
+    // stack drops the callback itself when link is terminated
+    if (connList[0] != CONNHANDLE_INVALID)
+    {
+      Gap_RegisterConnEventCb(NULL, GAP_CB_UNREGISTER, connList[0]);
+    }
+    connEvtRegistered = false;
+  }
+
   if (Util_isActive(&notiClock))
   {
     Util_stopClock(&notiClock);
   }
-
-  subscriptionOn = false;
-  SimplePeripheral_drain(2);
 }
 
 static void SimplePeripheral_drain(int where)
@@ -898,21 +1000,15 @@ static void SimplePeripheral_drain(int where)
     {
       if (!SimplePeripheral_doNotify(where))
       {
-        if (!Util_isActive(&notiClock))
-        {
-          Util_startClock(&notiClock);
-        }
-        break;
-      }
-      else
-      {
-        if (Util_isActive(&notiClock))
-        {
-          Util_stopClock(&notiClock);
-        }
-        freeOutgoingMsg((OutgoingMsg_t*)List_get(&pendingOutgoingMsgs));
+        SimplePeripheral_stall();
+        return;
       }
+
+      freeOutgoingMsg((OutgoingMsg_t*)List_get(&pendingOutgoingMsgs));
     }
+
+    // all queued, more will come with SP_READABLE_EVT
+    SimplePeripheral_unstall();
   }
   else
   {
@@ -0,0 +1,66 @@
+/*
+ * vad.c
+ */
+/*********************************************************************
+ * INCLUDES
+ */
+#include "vad.h"
+
+/*********************************************************************
+ * PUBLIC FUNCTIONS
+ */
+
+void vadReset(VadState_t *st)
+{
+  st->hangover = 0;
+}
+
+/*
+ * Returns true if the block is voiced, or still within hangover.
+ */
+bool vadProcess(VadState_t *st, const int16_t *pcm, size_t n)
+{
+  if (n == 0)
+  {
+    return st->hangover > 0;
+  }
+
+  int32_t sum = 0;
+  for (size_t i = 0; i < n; i++)
+  {
+    sum += pcm[i];
+  }
+  int32_t dc = sum / (int32_t) n;
+
+  uint32_t mag = 0;
+  uint32_t zc = 0;
+  bool neg = (pcm[0] - dc) < 0;
+  for (size_t i = 0; i < n; i++)
+  {
+    int32_t x = pcm[i] - dc;
+    bool xneg = x < 0;
+    mag += xneg ? -x : x;
+    zc += xneg != neg;
+    neg = xneg;
+  }
+
+  /* compare mean values without dividing */
+  bool voiced = (mag >= (uint32_t) VAD_ENERGY_HIGH * n)
+      || (mag >= (uint32_t) VAD_ENERGY_LOW * n
+          && zc * VAD_ZC_BLOCK >= (uint32_t) VAD_ZC_MIN * n);
+
+  if (voiced)
+  {
+    st->hangover = VAD_HANGOVER_SAMPLES;
+  }
+  else if (st->hangover > n)
+  {
+    st->hangover -= n;
+  }
+  else
+  {
+    st->hangover = 0;
+  }
+
+  return voiced || st->hangover > 0;
+}
@@ -0,0 +1,47 @@
+/*
+ * vad.h
+ */
+
+#ifndef APPLICATION_VAD_H_
+#define APPLICATION_VAD_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Energy / zero-crossing voice activity detector. A block is voiced if its
+ * mean absolute amplitude (dc removed) is above VAD_ENERGY_HIGH, or above
+ * VAD_ENERGY_LOW with at least VAD_ZC_MIN zero crossings per
+ * VAD_ZC_BLOCK samples (unvoiced consonants are quiet but noisy).
+ *
+ * After the last voiced block, blocks are still reported voiced for
+ * VAD_HANGOVER_SAMPLES, so word tails and short pauses are kept.
+ */
+#ifndef VAD_ENERGY_HIGH
+#define VAD_ENERGY_HIGH                   256
+#endif
+
+#ifndef VAD_ENERGY_LOW
+#define VAD_ENERGY_LOW                    64
+#endif
+
+#ifndef VAD_ZC_MIN
+#define VAD_ZC_MIN                        12
+#endif
+
+#define VAD_ZC_BLOCK                      80
+
+#ifndef VAD_HANGOVER_SAMPLES
+#define VAD_HANGOVER_SAMPLES              8000
+#endif
+
+typedef struct VadState
+{
+  uint32_t hangover;      // samples left before reporting silence
+} VadState_t;
+
+void vadReset(VadState_t *st);
+bool vadProcess(VadState_t *st, const int16_t *pcm, size_t n);
+
+#endif /* APPLICATION_VAD_H_ */
@@ -66,7 +66,7 @@
  * CONSTANTS
  */
 
-#define SERVAPP_NUM_ATTR_SUPPORTED        1 + 4 + 3   // TODO
+#define SERVAPP_NUM_ATTR_SUPPORTED        1 + 4 + 3 + 3 + 3   // TODO
 
 /*********************************************************************
  * TYPEDEFS
@@ -86,6 +86,12 @@ CONST uint8 simpleProfileChar1UUID[ATT_UUID_SIZE] = {
 CONST uint8 simpleProfileChar2UUID[ATT_UUID_SIZE] = {
     SIMPLEPROFILE_BASE_UUID_128(SIMPLEPROFILE_CHAR2_UUID) };
 
+CONST uint8 simpleProfileChar3UUID[ATT_UUID_SIZE] = {
+    SIMPLEPROFILE_BASE_UUID_128(SIMPLEPROFILE_CHAR3_UUID) };
+
+CONST uint8 simpleProfileChar4UUID[ATT_UUID_SIZE] = {
+    SIMPLEPROFILE_BASE_UUID_128(SIMPLEPROFILE_CHAR4_UUID) };
+
 /*********************************************************************
  * EXTERNAL VARIABLES
  */
@@ -110,10 +116,14 @@ static CONST gattAttrType_t simpleProfileService = { ATT_UUID_SIZE,
 // Simple Profile Characteristic 4 Properties
 static uint8 simpleProfileChar1Props = GATT_PROP_WRITE | GATT_PROP_NOTIFY;
 static uint8 simpleProfileChar2Props = GATT_PROP_READ | GATT_PROP_WRITE;
+static uint8 simpleProfileChar3Props = GATT_PROP_READ | GATT_PROP_WRITE;
+static uint8 simpleProfileChar4Props = GATT_PROP_READ | GATT_PROP_WRITE;
 
 // Characteristic 4 Value
 static uint8 simpleProfileChar1 = 0;
 uint8_t simpleProfileChar2 = 5;
+uint8_t simpleProfileChar3 = 4;   // adpcm bits per sample, 3 or 4
+uint8_t simpleProfileChar4 = 16;  // sample rate in kHz, 8 or 16
 
 // Simple Profile Characteristic 4 Configuration Each client has its own
 // instantiation of the Client Characteristic Configuration. Reads of the
@@ -124,6 +134,8 @@ static gattCharCfg_t *simpleProfileChar1Config;
 // Simple Profile Characteristic 4 User Description
 static uint8 simpleProfileChar1UserDesp[6] = "audio";
 static uint8 simpleProfileChar2UserDesp[9] = "duration";
+static uint8 simpleProfileChar3UserDesp[6] = "codec";
+static uint8 simpleProfileChar4UserDesp[5] = "rate";
 
 /*********************************************************************
  * Profile Attributes - Table
@@ -171,6 +183,36 @@ static gattAttribute_t simpleProfileAttrTbl[SERVAPP_NUM_ATTR_SUPPORTED] = {
       { { ATT_BT_UUID_SIZE, charUserDescUUID },
       GATT_PERMIT_READ,
         0, simpleProfileChar2UserDesp },
+
+      // 8 Characteristic 3 Declaration
+      { { ATT_BT_UUID_SIZE, characterUUID },
+      GATT_PERMIT_READ,
+        0, &simpleProfileChar3Props },
+
+      // 9 Characteristic 3 Value
+      { { ATT_UUID_SIZE, simpleProfileChar3UUID },
+      GATT_PERMIT_READ | GATT_PERMIT_WRITE,
+        0, &simpleProfileChar3 },
+
+      // 10 Characteristic 3 User Description
+      { { ATT_BT_UUID_SIZE, charUserDescUUID },
+      GATT_PERMIT_READ,
+        0, simpleProfileChar3UserDesp },
+
+      // 11 Characteristic 4 Declaration
+      { { ATT_BT_UUID_SIZE, characterUUID },
+      GATT_PERMIT_READ,
+        0, &simpleProfileChar4Props },
+
+      // 12 Characteristic 4 Value
+      { { ATT_UUID_SIZE, simpleProfileChar4UUID },
+      GATT_PERMIT_READ | GATT_PERMIT_WRITE,
+        0, &simpleProfileChar4 },
+
+      // 13 Characteristic 4 User Description
+      { { ATT_BT_UUID_SIZE, charUserDescUUID },
+      GATT_PERMIT_READ,
+        0, simpleProfileChar4UserDesp },
 };
 
 gattAttribute_t *simpleProfileChar1ValueAttrHandle = &simpleProfileAttrTbl[2];
@@ -344,6 +386,16 @@ static bStatus_t simpleProfile_ReadAttrCB(uint16_t connHandle,
       *pLen = 1;
       break;
 
+    case SIMPLEPROFILE_CHAR3_UUID:
+      *pValue = simpleProfileChar3;
+      *pLen = 1;
+      break;
+
+    case SIMPLEPROFILE_CHAR4_UUID:
+      *pValue = simpleProfileChar4;
+      *pLen = 1;
+      break;
+
     default:
       // Should never get here! (characteristics 3 and 4 do not have read permissions)
       *pLen = 0;
@@ -362,20 +414,68 @@ static bStatus_t simpleProfile_ReadAttrCB(uint16_t connHandle,
 
 bool commandIsValid(uint8_t* pValue, uint16_t len)
 {
-  if (len == 1)
+  if (len > 1 && pValue[0] == IMT_START_READ_MULTI)
   {
-    return (pValue[0] <= IMT_START_READ);
+    uint16_t count = (len - 1) / 8;
+    if ((len - 1) % 8 || count > READ_RANGES_MAX)
+    {
+      return false;
+    }
+
+    for (uint16_t i = 0; i < count; i++)
+    {
+      uint32_t s, e;
+      memcpy(&s, &pValue[1 + i * 8], 4);
+      memcpy(&e, &pValue[5 + i * 8], 4);
+      if (!(s < e))
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+  else if (len == 1)
+  {
+    return (pValue[0] <= IMT_START_READ_V2 || pValue[0] == IMT_RESUME_READ
+        || pValue[0] == IMT_START_MONITOR || pValue[0] == IMT_STOP_MONITOR
+        || pValue[0] == IMT_LIST_RECS);
   }
   else if (len == 5)
   {
-    return (pValue[0] == IMT_START_READ);
+    return (pValue[0] == IMT_START_READ || pValue[0] == IMT_START_READ_V2
+        || pValue[0] == IMT_GRANT || pValue[0] == IMT_LIST_RECS);
   }
   else if (len == 9)
   {
     uint32_t s, e;
     memcpy(&s, &pValue[1], 4);
     memcpy(&e, &pValue[5], 4);
-    return s < e;
+    if (pValue[0] == IMT_ACK)
+    {
+      // (major, minor), minor is packet index (v1) or byte offset (v2)
+      return e < BADPCM_SECT_DATA_SIZE;
+    }
+    return (pValue[0] == IMT_START_READ || pValue[0] == IMT_START_READ_V2)
+        && s < e;
+  }
+  else if (len == 10)
+  {
+    // ack with the index of the range (major, minor) is in
+    uint32_t e;
+    memcpy(&e, &pValue[5], 4);
+    return pValue[0] == IMT_ACK && e < BADPCM_SECT_DATA_SIZE
+        && pValue[9] < READ_RANGES_MAX;
+  }
+  else if (len == 17)
+  {
+    // (sector, packet) pairs
+    uint32_t s, sp, e, ep;
+    memcpy(&s, &pValue[1], 4);
+    memcpy(&sp, &pValue[5], 4);
+    memcpy(&e, &pValue[9], 4);
+    memcpy(&ep, &pValue[13], 4);
+    return (pValue[0] == IMT_START_READ || pValue[0] == IMT_START_READ_V2)
+        && (s < e || (s == e && sp < ep));
   }
   else
   {
@@ -447,7 +547,8 @@ static bStatus_t simpleProfile_WriteAttrCB(uint16_t connHandle,
       // Make sure it's not a blob operation
       if (offset == 0)
       {
-        if (len == 1 || len == 5 || len == 9)
+        if (len == 1 || len == 5 || len == 9
+            || (len > 9 && len <= 1 + READ_RANGES_MAX * 8))
         {
           if (commandIsValid(pValue, len))
           {
@@ -471,6 +572,28 @@ static bStatus_t simpleProfile_WriteAttrCB(uint16_t connHandle,
               {
                 memcpy(&msg->start, &pValue[1], 4);
                 memcpy(&msg->end, &pValue[5], 4);
+                msg->range = ACK_RANGE_CURRENT;
+              }
+              else if (len == 10)
+              {
+                memcpy(&msg->start, &pValue[1], 4);
+                memcpy(&msg->end, &pValue[5], 4);
+                msg->range = pValue[9];
+              }
+              else if (len == 17 && msg->type != IMT_START_READ_MULTI)
+              {
+                memcpy(&msg->start, &pValue[1], 4);
+                memcpy(&msg->startMinor, &pValue[5], 4);
+                memcpy(&msg->end, &pValue[9], 4);
+                memcpy(&msg->endMinor, &pValue[13], 4);
+              }
+
+              if (msg->type == IMT_START_READ_MULTI)
+              {
+                msg->count = (len - 1) / 8;
+                memcpy(msg->ranges, &pValue[1], len - 1);
+                msg->start = msg->ranges[0][0];
+                msg->end = msg->ranges[0][1];
               }
 
               recvIncomingMsg(msg);
@@ -533,6 +656,60 @@ static bStatus_t simpleProfile_WriteAttrCB(uint16_t connHandle,
       }
       break;
 
+    case SIMPLEPROFILE_CHAR3_UUID:
+      // Make sure it's not a blob operation
+      if (offset == 0)
+      {
+        if (len == 1)
+        {
+          if (*pValue == 3 || *pValue == 4)
+          {
+            Audio_updateCodec(*pValue);
+            simpleProfileChar3 = *pValue;
+          }
+          else
+          {
+            status = ATT_ERR_INVALID_VALUE;
+          }
+        }
+        else
+        {
+          status = ATT_ERR_INVALID_VALUE_SIZE;
+        }
+      }
+      else
+      {
+        status = ATT_ERR_ATTR_NOT_LONG;
+      }
+      break;
+
+    case SIMPLEPROFILE_CHAR4_UUID:
+      // Make sure it's not a blob operation
+      if (offset == 0)
+      {
+        if (len == 1)
+        {
+          if (*pValue == 8 || *pValue == 16)
+          {
+            Audio_updateRate(*pValue);
+            simpleProfileChar4 = *pValue;
+          }
+          else
+          {
+            status = ATT_ERR_INVALID_VALUE;
+          }
+        }
+        else
+        {
+          status = ATT_ERR_INVALID_VALUE_SIZE;
+        }
+      }
+      else
+      {
+        status = ATT_ERR_ATTR_NOT_LONG;
+      }
+      break;
+
     default:
       // Should never get here! (characteristics 2 and 4 do not have write permissions)
       status = ATT_ERR_ATTR_NOT_FOUND;
@@ -64,6 +64,7 @@ extern "C" {
 #define SIMPLEPROFILE_CHAR1                     0  // RW uint8 - Profile Characteristic 4 value
 #define SIMPLEPROFILE_CHAR2                     1
 #define SIMPLEPROFILE_CHAR3                     2
+#define SIMPLEPROFILE_CHAR4                     3
 
 // Simple Profile 128-bit UUID base: 7c95XXXX-6d0c-436f-81c8-3fd7e3db0610
 #define SIMPLEPROFILE_BASE_UUID_128( uuid ) \
@@ -77,6 +78,7 @@ extern "C" {
 #define SIMPLEPROFILE_CHAR1_UUID                0x9501
 #define SIMPLEPROFILE_CHAR2_UUID                0x9502
 #define SIMPLEPROFILE_CHAR3_UUID                0x9503
+#define SIMPLEPROFILE_CHAR4_UUID                0x9504
 
 // Simple Keys Profile Services bit fields
 #define SIMPLEPROFILE_SERVICE                   0x00000001
@@ -84,6 +86,8 @@ extern "C" {
 // Length of Characteristic 1 in bytes
 #define SIMPLEPROFILE_CHAR1_LEN                 4
 #define SIMPLEPROFILE_CHAR2_LEN                 1
+#define SIMPLEPROFILE_CHAR3_LEN                 1
+#define SIMPLEPROFILE_CHAR4_LEN                 1
 
 
 /*********************************************************************
@@ -0,0 +1,34 @@
+/*
+ * bench.h
+ *
+ * Wall clock and cycle counter helpers for host benchmarks. Numbers are host numbers; the
+ * ratio between variants is what carries over to the target.
+ */
+
+#ifndef TEST_BENCH_H_
+#define TEST_BENCH_H_
+
+#include <stdint.h>
+#include <time.h>
+
+static inline uint64_t benchNow(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+/* cpu cycles where the host has a cycle counter, else nanoseconds */
+static inline uint64_t benchCycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+  return __builtin_ia32_rdtsc();
+#else
+  return benchNow();
+#endif
+}
+
+/* keeps results alive without printing them */
+extern volatile uint32_t benchSink;
+
+#endif /* TEST_BENCH_H_ */
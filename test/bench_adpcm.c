@@ -0,0 +1,190 @@
+/*
+ * bench_adpcm.c
+ *
+ * Host throughput of the codec variants in Application/adpcm.c, on the
+ * speech corpus at 16 kHz. One PCM frame is 80 samples (5 ms, one I2S
+ * buffer).
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "adpcm.h"
+#include "bench.h"
+#include "corpus.h"
+
+volatile uint32_t benchSink;
+
+#define BENCH_SAMPLES                     (16000 * 60)
+#define BENCH_ROUNDS                      5
+#define FRAME_SAMPLES                     80
+
+static int16_t pcm[BENCH_SAMPLES];
+static int16_t out[BENCH_SAMPLES];
+static uint8_t codes[BENCH_SAMPLES];
+static uint8_t packed[BENCH_SAMPLES / 2];
+
+/*
+ * State kept in a global struct and passed by pointer, as the firmware did
+ * with ctx.recAdpcmState before the block api.
+ */
+static struct
+{
+  int16_t sample;
+  uint8_t index;
+} state;
+
+static void report(const char *name, uint64_t ns, size_t samples)
+{
+  double perSample = (double) ns / samples;
+  printf("%-28s %8.2f ns/sample %10.1f ns/frame %8.1f Msample/s\n", name,
+         perSample, perSample * FRAME_SAMPLES, 1000.0 / perSample);
+}
+
+/* best of BENCH_ROUNDS, to keep scheduler noise out */
+#define BEST_OF(ns, ...)                                                    \
+  do                                                                        \
+  {                                                                         \
+    ns = UINT64_MAX;                                                        \
+    for (int round = 0; round < BENCH_ROUNDS; round++)                      \
+    {                                                                       \
+      uint64_t t0 = benchNow();                                             \
+      __VA_ARGS__;                                                          \
+      uint64_t t = benchNow() - t0;                                         \
+      ns = t < ns ? t : ns;                                                 \
+    }                                                                       \
+  } while (0)
+
+static void benchEncoder(void)
+{
+  uint64_t ns;
+
+  BEST_OF(ns, {
+    int16_t sample = 0;
+    uint8_t index = 0;
+    for (size_t i = 0; i < BENCH_SAMPLES; i++)
+      codes[i] = adpcmEncoder(pcm[i], &sample, &index);
+    benchSink += sample + index + codes[BENCH_SAMPLES / 2];
+  });
+  report("adpcmEncoder", ns, BENCH_SAMPLES);
+
+  BEST_OF(ns, {
+    int16_t sample = 0;
+    uint8_t index = 0;
+    for (size_t i = 0; i < BENCH_SAMPLES; i++)
+      codes[i] = adpcmEncoderFast(pcm[i], &sample, &index);
+    benchSink += sample + index + codes[BENCH_SAMPLES / 2];
+  });
+  report("adpcmEncoderFast", ns, BENCH_SAMPLES);
+}
+
+/*
+ * Per-sample encoder with nibble-or packing, against adpcmEncodeBlock(), one
+ * call per 80-sample frame as in the AUDIO_PCM_EVT handler.
+ */
+static void benchBlock(void)
+{
+  uint64_t ns;
+
+  BEST_OF(ns, {
+    state.sample = 0;
+    state.index = 0;
+    for (size_t f = 0; f < BENCH_SAMPLES; f += FRAME_SAMPLES)
+    {
+      uint8_t *buf = &packed[f / 2];
+      for (size_t i = 0; i < FRAME_SAMPLES; i++)
+      {
+        uint8_t code = adpcmEncoder(pcm[f + i], &state.sample, &state.index);
+        if (i % 2 == 0)
+          buf[i / 2] = code;
+        else
+          buf[i / 2] |= code << 4;
+      }
+    }
+    benchSink += state.sample + packed[BENCH_SAMPLES / 4];
+  });
+  report("adpcmEncoder per sample", ns, BENCH_SAMPLES);
+
+  BEST_OF(ns, {
+    AdpcmState_t st = { 0, 0, 0 };
+    for (size_t f = 0; f < BENCH_SAMPLES; f += FRAME_SAMPLES)
+      adpcmEncodeBlock(&pcm[f], FRAME_SAMPLES, &packed[f / 2], &st);
+    benchSink += st.sample + packed[BENCH_SAMPLES / 4];
+  });
+  report("adpcmEncodeBlock", ns, BENCH_SAMPLES);
+
+  BEST_OF(ns, {
+    state.sample = 0;
+    state.index = 0;
+    for (size_t i = 0; i < BENCH_SAMPLES; i += 2)
+    {
+      uint8_t x = packed[i / 2];
+      out[i] = adpcmDecoder(x & 0x0f, &state.sample, &state.index);
+      out[i + 1] = adpcmDecoder(x >> 4, &state.sample, &state.index);
+    }
+    benchSink += state.sample + out[BENCH_SAMPLES / 2];
+  });
+  report("adpcmDecoder per sample", ns, BENCH_SAMPLES);
+
+  BEST_OF(ns, {
+    AdpcmState_t st = { 0, 0, 0 };
+    for (size_t f = 0; f < BENCH_SAMPLES; f += FRAME_SAMPLES)
+      adpcmDecodeBlock(&packed[f / 2], FRAME_SAMPLES, &out[f], &st);
+    benchSink += st.sample + out[BENCH_SAMPLES / 2];
+  });
+  report("adpcmDecodeBlock", ns, BENCH_SAMPLES);
+}
+
+/*
+ * Read loop state update per 160-byte packet: full decode with samples
+ * thrown away (as the firmware did), against adpcmAdvanceState().
+ */
+#define PACKET_SIZE                       160
+#define PACKET_SAMPLES                    (PACKET_SIZE * 2)
+#define PACKETS                           (BENCH_SAMPLES / PACKET_SAMPLES)
+
+static void reportPackets(const char *name, uint64_t ns)
+{
+  printf("%-28s %8.1f ns/packet %12.0f packets/s\n", name,
+         (double) ns / PACKETS, PACKETS * 1e9 / ns);
+}
+
+static void benchAdvance(void)
+{
+  uint64_t ns;
+
+  BEST_OF(ns, {
+    state.sample = 0;
+    state.index = 0;
+    for (size_t p = 0; p < PACKETS; p++)
+    {
+      const uint8_t *data = &packed[p * PACKET_SIZE];
+      for (size_t i = 0; i < PACKET_SIZE; i++)
+      {
+        uint8_t x = data[i];
+        adpcmDecoder(x & 0x0f, &state.sample, &state.index);
+        adpcmDecoder((x >> 4) & 0x0f, &state.sample, &state.index);
+      }
+    }
+    benchSink += state.sample + state.index;
+  });
+  reportPackets("decode per packet", ns);
+
+  BEST_OF(ns, {
+    AdpcmState_t st = { 0, 0, 0 };
+    for (size_t p = 0; p < PACKETS; p++)
+      adpcmAdvanceState(&packed[p * PACKET_SIZE], PACKET_SAMPLES, &st);
+    benchSink += st.sample + st.index;
+  });
+  reportPackets("adpcmAdvanceState", ns);
+}
+
+int main(void)
+{
+  corpusFill(CORPUS_SPEECH, pcm, BENCH_SAMPLES, 16000, 1);
+
+  benchEncoder();
+  benchBlock();
+  benchAdvance();
+
+  return 0;
+}
@@ -0,0 +1,339 @@
+/*
+ * bench_link.c
+ *
+ * Read-back over the link on the simulator (sim/): the application records
+ * a while, then sends it with v2 packets, and the numbers are virtual time,
+ * so they are the modelled target's, not the host's. Each variant boots in
+ * a forked child on blank flash.
+ *
+ *   - notification drain woken at each connection event report, against
+ *     the fallback clock alone (a stack that refuses the report), and
+ *     against the 10 ms retry poll it replaced: read throughput and ble
+ *     task wakeups. The poll is bench_link_poll, the same file built with
+ *     NOTI_FALLBACK_PERIOD=10.
+ *   - spi transactions (NVS_read calls) per sector read, v2 packets from
+ *     the read-ahead cache against each packet's data read from flash by
+ *     the ble task, as before: bench_link_uncached is the same file built
+ *     with READ_CACHE_V2=0.
+ *   - a timing model of readPrefetch() at connection intervals from 7.5
+ *     to 50 ms: throughput, what share of the link it fills, the audio
+ *     task's spi time per sector and the connection events the link had
+ *     room in but nothing queued, against the cache filled on demand only
+ *     (bench_link_noprefetch, built with READ_PREFETCH=0).
+ *   - read throughput against the depth of the outgoing message queue
+ *     between audio and ble task: bench_link_q<n> is the same file built
+ *     with OUTGOING_MSG_NUM=n (the firmware's default is 4, bench_link),
+ *     at the default link and at one that sends every stack buffer in an
+ *     event.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "check.h"
+#include "sim.h"
+
+CHECK_DEFINE;
+
+#ifndef READ_CACHE_V2
+#define READ_CACHE_V2                     1
+#endif
+#ifndef READ_PREFETCH
+#define READ_PREFETCH                     1
+#endif
+
+#define BENCH_RECORD_SECONDS              20
+#define SP_TASK_PRIORITY                  4
+
+typedef struct Client
+{
+  StatusPacket_t status;
+  uint32_t statusCount;
+  uint32_t packets;
+  uint32_t bytes;
+} Client_t;
+
+static Client_t client;
+static uint32_t statusCount;
+
+static void clientFxn(const uint8_t *pkt, size_t len)
+{
+  if (len >= BADPCM_V2_HEADER_SIZE && pkt[0] == BADPCM_V2)
+  {
+    size_t n = len - BADPCM_V2_HEADER_SIZE;
+    if (pkt[1] & BADPCM_V2_STATE)
+    {
+      n -= BADPCM_V2_STATE_SIZE;
+    }
+    client.packets++;
+    client.bytes += n;
+  }
+  else if (len <= sizeof(StatusPacket_t) && pkt[0] < 8)
+  {
+    memcpy(&client.status, pkt, len);
+    client.statusCount++;
+  }
+}
+
+static bool statusArrived(void)
+{
+  return client.statusCount != statusCount;
+}
+
+static bool readDone(void)
+{
+  return statusArrived() && !(client.status.flags & 2);
+}
+
+static void commandWait(uint32_t type, uint32_t start, uint32_t end)
+{
+  IncomingMsg_t msg = { .type = type, .start = start, .end = end };
+  statusCount = client.statusCount;
+  simCommand(&msg);
+  CHECK(simRunUntil(statusArrived, 5 * SIM_S), "no status for command %u",
+        type);
+}
+
+typedef struct Result
+{
+  uint32_t bytes;
+  SimTime readUs;
+  uint32_t wakeups;           // ble task, while reading
+  uint32_t connEvents;
+  uint32_t allocFails;
+  uint32_t sectors;
+  uint32_t nvsReads;
+  uint64_t nvsReadBytes;
+  uint64_t nvsBusyUs;
+  uint32_t connEventsShort;
+} Result_t;
+
+/*
+ * Record, read it all back, in the calling process: boots once.
+ */
+static Result_t recordAndRead(void)
+{
+  Result_t r = { 0 };
+
+  simClient(clientFxn);
+  simBoot();
+  simConnect(247);
+  simRunFor(100 * SIM_MS);
+
+  commandWait(IMT_START_REC, 0, 0);
+  uint32_t start = client.status.recStart;
+  simRunFor(BENCH_RECORD_SECONDS * SIM_S);
+  commandWait(IMT_STOP_REC, 0, 0);
+  uint32_t end = client.status.recStart;
+
+  SimStats before = simStats;
+  client.bytes = 0;
+  commandWait(IMT_START_READ_V2, start, end);
+  SimTime t0 = simNow;
+  CHECK(simRunUntil(readDone, 600 * SIM_S), "read not done");
+
+  r.bytes = client.bytes;
+  r.readUs = simNow - t0;
+  r.wakeups = simStats.wakeups[SP_TASK_PRIORITY]
+      - before.wakeups[SP_TASK_PRIORITY];
+  r.connEvents = simStats.connEvents - before.connEvents;
+  r.allocFails = simStats.notifyAllocFails - before.notifyAllocFails;
+  r.sectors = end - start;
+  r.nvsReads = simStats.nvsReads - before.nvsReads;
+  r.nvsReadBytes = simStats.nvsReadBytes - before.nvsReadBytes;
+  r.nvsBusyUs = simStats.nvsBusyUs - before.nvsBusyUs;
+  r.connEventsShort = simStats.connEventsShort - before.connEventsShort;
+  CHECK(r.bytes >= (end - start - 1) * BADPCM_SECT_DATA_SIZE,
+        "read %u bytes of %u sectors", r.bytes, end - start);
+  CHECK(simStats.icallBadFrees == 0, "%u ICall blocks freed as the wrong kind",
+        simStats.icallBadFrees);
+  return r;
+}
+
+typedef void (*ReportFxn)(const char *name, const Result_t *r);
+
+static void reportLink(const char *name, const Result_t *r)
+{
+  double s = r->readUs / 1e6;
+  printf("  %4.1f ms %-20s %5.1f kB/s, ble task %6.1f wakeups/s "
+         "(%5.1f per conn event), %5u alloc fails, %4.1f spi reads "
+         "(%4.0f bytes) per sector\n", simConfig.connIntervalUs / 1000.0,
+         name, r->bytes / s / 1000, r->wakeups / s,
+         (double) r->wakeups / r->connEvents, r->allocFails,
+         (double) r->nvsReads / r->sectors,
+         (double) r->nvsReadBytes / r->sectors);
+}
+
+/*
+ * What the link could have carried (full v2 packets, pdusPerEvent each
+ * event), how much of the audio task's time per sector went to spi reads,
+ * and in how many events the link had room but nothing was queued.
+ */
+static void reportPrefetch(const char *name, const Result_t *r)
+{
+  double s = r->readUs / 1e6;
+  double link = (double) r->connEvents * simConfig.pdusPerEvent
+      * (BADPCM_V2_MAX_SIZE - BADPCM_V2_HEADER_SIZE);
+  printf("  %5.1f ms %-20s %5.1f kB/s (%3.0f%% of link), spi %4.1f ms per "
+         "sector, %4.1f%% conn events short\n",
+         simConfig.connIntervalUs / 1000.0, name, r->bytes / s / 1000,
+         100.0 * r->bytes / link, r->nvsBusyUs / 1000.0 / r->sectors,
+         100.0 * r->connEventsShort / r->connEvents);
+}
+
+/*
+ * Run variant in a child, which prints its line; false if it failed.
+ */
+static bool variant(const char *name, uint32_t intervalUs, void (*setup)(void),
+                    ReportFxn report)
+{
+  fflush(stdout);
+  pid_t pid = fork();
+  if (pid == 0)
+  {
+    simConfig.connIntervalUs = intervalUs;
+    setup();
+    Result_t r = recordAndRead();
+    report(name, &r);
+    fflush(stdout);
+    _exit(checkFailures ? 1 : 0);
+  }
+
+  int status = 1;
+  waitpid(pid, &status, 0);
+  return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+static const uint32_t intervals[] = { 7500, 15000 };
+
+#define BENCH_INTERVALS                   (sizeof(intervals) / sizeof(intervals[0]))
+
+/* connection intervals of the prefetch timing model */
+static const uint32_t modelIntervals[] = { 7500, 15000, 30000, 50000 };
+
+#define MODEL_INTERVALS                   (sizeof(modelIntervals) / sizeof(modelIntervals[0]))
+
+static void connEvtReports(void)
+{
+}
+
+/* a link that takes every buffer the stack has in one event */
+static void allPdus(void)
+{
+  simConfig.pdusPerEvent = simConfig.stackBuffers;
+}
+
+/* the same, with flash read at 1 MHz spi */
+static void allPdusSlowSpi(void)
+{
+  allPdus();
+  simConfig.spiNsPerByte = 8000;
+}
+
+static void fallbackClockOnly(void)
+{
+  simConfig.noConnEvtReports = true;
+}
+
+/*
+ * readPrefetch() timing at each model interval, at the default link and
+ * at one that sends every stack buffer in an event.
+ */
+static void prefetchModel(const char *name, const char *allName,
+                          const char *slowName)
+{
+  for (size_t i = 0; i < MODEL_INTERVALS; i++)
+  {
+    CHECK(variant(name, modelIntervals[i], connEvtReports, reportPrefetch),
+          "variant failed");
+    CHECK(variant(allName, modelIntervals[i], allPdus, reportPrefetch),
+          "variant failed");
+    CHECK(variant(slowName, modelIntervals[i], allPdusSlowSpi,
+                  reportPrefetch), "variant failed");
+  }
+}
+
+#ifdef NOTI_FALLBACK_PERIOD
+
+int main(void)
+{
+  for (size_t i = 0; i < BENCH_INTERVALS; i++)
+  {
+    CHECK(variant("10 ms poll (before)", intervals[i], fallbackClockOnly,
+                  reportLink), "variant failed");
+  }
+  return checkResult("bench_link_poll");
+}
+
+#elif !READ_CACHE_V2
+
+int main(void)
+{
+  for (size_t i = 0; i < BENCH_INTERVALS; i++)
+  {
+    CHECK(variant("v2 from flash (before)", intervals[i], connEvtReports,
+                  reportLink), "variant failed");
+  }
+  return checkResult("bench_link_uncached");
+}
+
+#elif !READ_PREFETCH
+
+int main(void)
+{
+  for (size_t i = 0; i < BENCH_INTERVALS; i++)
+  {
+    CHECK(variant("cache on demand", intervals[i], connEvtReports,
+                  reportLink), "variant failed");
+  }
+  prefetchModel("on demand (before)", "on demand, all pdus",
+                "on demand, 1 MHz spi");
+  return checkResult("bench_link_noprefetch");
+}
+
+#elif defined(OUTGOING_MSG_NUM)
+
+int main(void)
+{
+  char name[32];
+
+  snprintf(name, sizeof(name), "queue depth %u", OUTGOING_MSG_NUM);
+  for (size_t i = 0; i < BENCH_INTERVALS; i++)
+  {
+    CHECK(variant(name, intervals[i], connEvtReports, reportLink),
+          "variant failed");
+  }
+  snprintf(name, sizeof(name), "depth %u, all pdus", OUTGOING_MSG_NUM);
+  for (size_t i = 0; i < BENCH_INTERVALS; i++)
+  {
+    CHECK(variant(name, intervals[i], allPdus, reportLink), "variant failed");
+  }
+  snprintf(name, sizeof(name), "bench_link_q%u", OUTGOING_MSG_NUM);
+  return checkResult(name);
+}
+
+#else
+
+int main(void)
+{
+  printf("bench_link: %u s recorded, read back at mtu 247, %u pdus per "
+         "event, %u stack buffers\n", BENCH_RECORD_SECONDS,
+         simConfig.pdusPerEvent, simConfig.stackBuffers);
+
+  for (size_t i = 0; i < BENCH_INTERVALS; i++)
+  {
+    CHECK(variant("conn event reports", intervals[i], connEvtReports,
+                  reportLink), "variant failed");
+    CHECK(variant("50 ms fallback only", intervals[i], fallbackClockOnly,
+                  reportLink), "variant failed");
+  }
+
+  printf("bench_link: read prefetch timing model, spi at %u ns/byte + %u us "
+         "per read\n", simConfig.spiNsPerByte, simConfig.spiCommandUs);
+  prefetchModel("prefetch", "prefetch, all pdus", "prefetch, 1 MHz spi");
+
+  return checkResult("bench_link");
+}
+
+#endif
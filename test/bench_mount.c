@@ -0,0 +1,125 @@
+/*
+ * bench_mount.c
+ *
+ * What loadCounter() reads of the two counter sectors at boot, on the
+ * simulator (sim/): near-empty, half-full and full sectors, each booted in
+ * a forked child on flash holding just that counter. mountMarkedBits()
+ * binary-searches for the end of the marked prefix; bench_mount_scan is
+ * the same file built with COUNTER_MOUNT_SEARCH=0, which scans both
+ * sectors whole, as before. Bytes and spi reads are counted by the sim/
+ * NVS model, the time is its spi time for them (command plus transfer at
+ * simConfig's rate), the cpu counting bits is not in it.
+ */
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "check.h"
+#include "sim.h"
+
+CHECK_DEFINE;
+
+#ifndef COUNTER_MOUNT_SEARCH
+#define COUNTER_MOUNT_SEARCH              1
+#endif
+
+#if COUNTER_MOUNT_SEARCH
+#define BENCH_NAME                        "bench_mount"
+#define MOUNT_NAME                        "binary search"
+#else
+#define BENCH_NAME                        "bench_mount_scan"
+#define MOUNT_NAME                        "full scan (before)"
+#endif
+
+#define FLASH_SECTORS                     4096
+#define SECT_SIZE                         4096
+#define HI_BITS_SIZE                      2048
+#define MAGIC                             0x58D5BD30
+
+extern int markedBitsLo;
+extern int markedBitsHi;
+
+/* marked bits of the high and low sector */
+static const struct
+{
+  const char *name;
+  uint32_t hi;
+  uint32_t lo;
+} states[] = {
+  { "near-empty", 2, 11 },
+  { "half-full", HI_BITS_SIZE * 8 / 2, SECT_SIZE * 8 / 2 },
+  { "full", HI_BITS_SIZE * 8 - 2, SECT_SIZE * 8 - 1 },
+};
+
+#define BENCH_STATES                      (sizeof(states) / sizeof(states[0]))
+
+static uint32_t reads;
+static uint32_t bytes;
+static uint64_t spiUs;
+
+static void readFxn(size_t offset, size_t size)
+{
+  if (offset < (size_t) (FLASH_SECTORS - 2) * SECT_SIZE)
+    return;
+
+  reads++;
+  bytes += size;
+  spiUs += simConfig.spiCommandUs
+      + (size * simConfig.spiNsPerByte + 999) / 1000;
+}
+
+/* the first n bits marked (cleared), the rest blank */
+static void markBits(uint8_t *p, uint32_t n)
+{
+  memset(p, 0, n / 8);
+  if (n % 8)
+  {
+    p[n / 8] = 0xff >> (n % 8);
+  }
+}
+
+static bool mount(size_t i)
+{
+  fflush(stdout);
+  pid_t pid = fork();
+  if (pid == 0)
+  {
+    uint8_t *lo = &simFlash[(size_t) (FLASH_SECTORS - 2) * SECT_SIZE];
+    uint8_t *hi = &simFlash[(size_t) (FLASH_SECTORS - 1) * SECT_SIZE];
+    uint32_t magic = MAGIC;
+
+    markBits(hi, states[i].hi);
+    memcpy(&hi[HI_BITS_SIZE], &magic, sizeof(magic));
+    markBits(lo, states[i].lo);
+
+    simNvsReadTrace(readFxn);
+    simBoot();
+
+    CHECK(markedBitsHi == (int) states[i].hi
+          && markedBitsLo == (int) states[i].lo,
+          "%s: mounted %d/%d bits, expected %u/%u", states[i].name,
+          markedBitsHi, markedBitsLo, states[i].hi, states[i].lo);
+    printf("  %-10s %-18s %5u bytes in %2u spi reads, %6.2f ms\n",
+           states[i].name, MOUNT_NAME, bytes, reads, spiUs / 1000.0);
+    fflush(stdout);
+    _exit(checkFailures ? 1 : 0);
+  }
+
+  int status = 1;
+  waitpid(pid, &status, 0);
+  return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+int main(void)
+{
+#if COUNTER_MOUNT_SEARCH
+  printf("bench_mount: counter sectors read at boot, spi at %u ns/byte + "
+         "%u us per read\n", simConfig.spiNsPerByte, simConfig.spiCommandUs);
+#endif
+  for (size_t i = 0; i < BENCH_STATES; i++)
+  {
+    simNvsReset();
+    CHECK(mount(i), "%s: boot failed", states[i].name);
+  }
+  return checkResult(BENCH_NAME);
+}
@@ -0,0 +1,134 @@
+/*
+ * bench_read.c
+ *
+ * Host cost of getting one v2 packet of flash data into the notification
+ * buffer: the firmware's readOutgoingMsg() (header from the message, data
+ * read from flash straight into the buffer) against staging the data in
+ * OutgoingMsg_t first and copying the message into the buffer, as v1
+ * packets still do. Flash is the sim/ NVS model, whose NVS_read() is a
+ * memcpy here (no task is running, the modelled spi time is not charged to
+ * anything), so the numbers are the cpu part only. Also prints the RAM
+ * each path keeps per message.
+ */
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <ti/drivers/NVS.h>
+
+#include "bench.h"
+#include "sim.h"
+
+volatile uint32_t benchSink;
+
+#define BENCH_PACKETS                     (1 << 20)
+#define BENCH_ROUNDS                      5
+#define BENCH_SECTORS                     64
+#define SECT_SIZE                         4096
+#define SECT_HEADER_SIZE                  96
+#define SECT_DATA_SIZE                    4000
+
+static uint8_t notifyBuf[BADPCM_V2_MAX_SIZE];
+static OutgoingMsg_t msg;
+static uint8_t stage[BADPCM_V2_MAX_SIZE];   // message body big enough to stage
+
+/* best of BENCH_ROUNDS, to keep scheduler noise out */
+#define BEST_OF(ns, cycles, ...)                                            \
+  do                                                                        \
+  {                                                                         \
+    ns = cycles = UINT64_MAX;                                               \
+    for (int round = 0; round < BENCH_ROUNDS; round++)                      \
+    {                                                                       \
+      uint64_t c0 = benchCycles();                                          \
+      uint64_t t0 = benchNow();                                             \
+      __VA_ARGS__;                                                          \
+      uint64_t t = benchNow() - t0;                                         \
+      uint64_t c = benchCycles() - c0;                                      \
+      ns = t < ns ? t : ns;                                                 \
+      cycles = c < cycles ? c : cycles;                                     \
+    }                                                                       \
+  } while (0)
+
+/*
+ * Header (and state for offset 0) into the message, as readPacketV2()
+ * leaves it for readOutgoingMsg().
+ */
+static size_t fillHeader(OutgoingMsg_t *m, uint32_t k, size_t data)
+{
+  uint32_t sect = k / (SECT_DATA_SIZE / data) % BENCH_SECTORS;
+  uint32_t off = k % (SECT_DATA_SIZE / data) * data;
+  size_t hdr = BADPCM_V2_HEADER_SIZE + (off == 0 ? BADPCM_V2_STATE_SIZE : 0);
+
+  m->bad2.version = BADPCM_V2;
+  m->bad2.format = off == 0 ? BADPCM_V2_STATE : 0;
+  m->bad2.offset = off;
+  m->bad2.major = sect;
+  m->nvsOffset = sect * SECT_SIZE + SECT_HEADER_SIZE + off;
+  m->nvsLen = data;
+  m->len = hdr + data;
+  return hdr;
+}
+
+static void direct(size_t data)
+{
+  for (uint32_t k = 0; k < BENCH_PACKETS; k++)
+  {
+    fillHeader(&msg, k, data);
+    readOutgoingMsg(&msg, notifyBuf, msg.len);
+    benchSink += notifyBuf[msg.len - 1];
+  }
+}
+
+static void staged(size_t data)
+{
+  for (uint32_t k = 0; k < BENCH_PACKETS; k++)
+  {
+    size_t hdr = fillHeader(&msg, k, data);
+    memcpy(stage, msg.raw, hdr);                          // audio task
+    NVS_read(NULL, msg.nvsOffset, stage + hdr, data);
+    memcpy(notifyBuf, stage, msg.len);                    // ble task
+    benchSink += notifyBuf[msg.len - 1];
+  }
+}
+
+static void report(const char *name, size_t data, uint64_t ns,
+                   uint64_t cycles, size_t copied)
+{
+  printf("  %-8s %3zu data bytes: %6.1f ns/packet %7.1f cycles/packet, "
+         "%3zu bytes copied\n", name, data, (double) ns / BENCH_PACKETS,
+         (double) cycles / BENCH_PACKETS, copied);
+}
+
+int main(void)
+{
+  simNvsReset();
+  for (size_t i = 0; i < (size_t) BENCH_SECTORS * SECT_SIZE; i++)
+  {
+    simFlash[i] = (uint8_t) (i * 7 + 3);
+  }
+
+  printf("bench_read: v2 packet into notification buffer, host, best of %d\n",
+         BENCH_ROUNDS);
+
+  /* 244: mtu 247, full v2 packet; 160: what a v1 packet carries */
+  static const size_t sizes[] = { BADPCM_V2_MAX_SIZE - BADPCM_V2_HEADER_SIZE,
+                                  BADPCM_DATA_SIZE };
+  for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+  {
+    size_t data = sizes[i];
+    uint64_t ns, cycles;
+
+    BEST_OF(ns, cycles, direct(data));
+    report("direct", data, ns, cycles, BADPCM_V2_HEADER_SIZE + data);
+    BEST_OF(ns, cycles, staged(data));
+    report("staged", data, ns, cycles, BADPCM_V2_HEADER_SIZE + 2 * data);
+  }
+
+  /* host List_Elem is two 8-byte pointers, 8 bytes more than the target */
+  printf("  ram per message (host): OutgoingMsg_t %zu bytes, v2 uses %zu "
+         "(list, type, len, nvs, header, state), staging a full v2 packet "
+         "would need %zu\n", sizeof(OutgoingMsg_t),
+         offsetof(OutgoingMsg_t, raw) + sizeof(BadpcmPacketV2_t),
+         offsetof(OutgoingMsg_t, raw) + BADPCM_V2_MAX_SIZE);
+  return 0;
+}
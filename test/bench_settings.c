@@ -0,0 +1,90 @@
+/*
+ * bench_settings.c
+ *
+ * Cost of a settings change on the simulator (sim/): the client toggles
+ * the sample rate BENCH_CHANGES times, one write every 100 ms, and the
+ * audio task saves each. Latency is the flash time charged to the audio
+ * task for one change, from the sim/ NVS model (a 4 KB erase is 45 ms
+ * typ.); erases and page programs are its counters. The firmware appends
+ * a record to the settings log and erases only when compacting;
+ * bench_settings_rewrite is the same file built with SETTINGS_LOG=0,
+ * which erases the settings sector and writes it again at each change,
+ * as before.
+ */
+#include <string.h>
+
+#include "check.h"
+#include "sim.h"
+#include "simple_gatt_profile.h"
+
+CHECK_DEFINE;
+
+#ifndef SETTINGS_LOG
+#define SETTINGS_LOG                      1
+#endif
+
+#if SETTINGS_LOG
+#define BENCH_NAME                        "bench_settings"
+#define SAVE_NAME                         "log"
+#else
+#define BENCH_NAME                        "bench_settings_rewrite"
+#define SAVE_NAME                         "rewrite (before)"
+#endif
+
+#define BENCH_CHANGES                     10000
+#define FLASH_SECTORS                     4096
+#define SECT_SIZE                         4096
+
+/* settings sectors, SECT_COUNT - 4 and - 3 */
+#define SETTINGS_FIRST                    ((size_t) (FLASH_SECTORS - 4) * SECT_SIZE)
+#define SETTINGS_END                      ((size_t) (FLASH_SECTORS - 2) * SECT_SIZE)
+
+static uint32_t otherOps;
+
+static void traceFxn(uint32_t op, size_t offset, size_t size, bool erase)
+{
+  (void) op;
+  (void) size;
+  (void) erase;
+
+  if (offset < SETTINGS_FIRST || offset >= SETTINGS_END)
+  {
+    otherOps++;
+  }
+}
+
+int main(void)
+{
+  simBoot();
+  simConnect(247);
+  simRunFor(SIM_S);
+
+  SimStats before = simStats;
+  uint64_t maxUs = 0;
+
+  simNvsTrace(traceFxn);
+  for (uint32_t i = 0; i < BENCH_CHANGES; i++)
+  {
+    uint8_t khz = (i % 2) ? 16 : 8;
+    uint64_t busy = simStats.nvsBusyUs;
+
+    CHECK(simWrite(SIMPLEPROFILE_CHAR4_UUID, &khz, 1) == 0,
+          "change %u refused", i);
+    simRunFor(100 * SIM_MS);
+    if (simStats.nvsBusyUs - busy > maxUs)
+    {
+      maxUs = simStats.nvsBusyUs - busy;
+    }
+  }
+  simNvsTrace(NULL);
+
+  uint32_t erases = simStats.nvsErases - before.nvsErases;
+  uint32_t pages = simStats.nvsPages - before.nvsPages;
+  uint64_t busyUs = simStats.nvsBusyUs - before.nvsBusyUs;
+
+  CHECK(otherOps == 0, "%u flash ops outside the settings sectors", otherOps);
+  printf("%s: %u changes, %-16s %4u erases, %4u page programs, latency "
+         "%5.2f ms mean, %5.2f ms max\n", BENCH_NAME, BENCH_CHANGES, SAVE_NAME,
+         erases, pages, busyUs / 1000.0 / BENCH_CHANGES, maxUs / 1000.0);
+  return checkResult(BENCH_NAME);
+}
@@ -0,0 +1,113 @@
+/*
+ * bench_write.c
+ *
+ * Page programs of a recording on the simulator (sim/): BENCH_RECORD_SECONDS
+ * of noise at 16 kHz 4-bit, and the programs that went to the data sectors
+ * (not the counter, journal or settings), counted by the sim/ NVS model,
+ * one per 256-byte page a write touches. writeChunk() stages chunks into
+ * full pages; bench_write_unstaged is the same file built with
+ * STAGE_PAGES=0, which writes each 160-byte chunk at its offset, as
+ * before, every other one across a page boundary.
+ */
+#include <string.h>
+
+#include "check.h"
+#include "sim.h"
+
+CHECK_DEFINE;
+
+#ifndef STAGE_PAGES
+#define STAGE_PAGES                       1
+#endif
+
+#if STAGE_PAGES
+#define BENCH_NAME                        "bench_write"
+#define WRITE_NAME                        "staged"
+#else
+#define BENCH_NAME                        "bench_write_unstaged"
+#define WRITE_NAME                        "unstaged (before)"
+#endif
+
+#define BENCH_RECORD_SECONDS              20
+#define FLASH_SECTORS                     4096
+#define SECT_SIZE                         4096
+#define DATA_END                          ((size_t) (FLASH_SECTORS - 16) * SECT_SIZE)
+
+static StatusPacket_t status;
+static uint32_t statusCount;
+static uint32_t statusSeen;
+static uint32_t dataPages;
+
+static void noiseFxn(int16_t *pcm, size_t n, void *arg)
+{
+  static uint32_t seed = 0x2545f491;
+  (void) arg;
+
+  for (size_t i = 0; i < n; i++)
+  {
+    seed = seed * 1664525 + 1013904223;
+    pcm[i] = (int16_t) (seed >> 18) - 8192;
+  }
+}
+
+static void clientFxn(const uint8_t *pkt, size_t len)
+{
+  if (len <= sizeof(StatusPacket_t) && pkt[0] < 8)
+  {
+    memcpy(&status, pkt, len);
+    statusCount++;
+  }
+}
+
+static void traceFxn(uint32_t op, size_t offset, size_t size, bool erase)
+{
+  (void) op;
+  (void) size;
+
+  if (!erase && offset < DATA_END)
+  {
+    dataPages++;
+  }
+}
+
+static bool statusArrived(void)
+{
+  return statusCount != statusSeen;
+}
+
+static void commandWait(uint32_t type)
+{
+  IncomingMsg_t msg = { .type = type };
+  statusSeen = statusCount;
+  simCommand(&msg);
+  CHECK(simRunUntil(statusArrived, 5 * SIM_S), "no status for command %u",
+        type);
+}
+
+int main(void)
+{
+  simClient(clientFxn);
+  simI2sSource(noiseFxn, NULL);
+  simBoot();
+  simConnect(247);
+  simRunFor(100 * SIM_MS);
+
+  commandWait(IMT_START_REC);
+  uint32_t start = status.recStart;
+  SimStats before = simStats;
+  simNvsTrace(traceFxn);
+  simRunFor(BENCH_RECORD_SECONDS * SIM_S);
+  commandWait(IMT_STOP_REC);
+  simNvsTrace(NULL);
+  uint32_t sectors = status.recStart - start;
+
+  CHECK(simStats.i2sErrors == before.i2sErrors, "i2s queue ran empty");
+  CHECK(sectors > 0, "nothing recorded");
+
+  uint32_t pages = simStats.nvsPages - before.nvsPages;
+  printf("%s: %u s, %u sectors, %-17s %5u page programs (%4.1f per "
+         "sector, %4.1f/s), %5u in all\n", BENCH_NAME, BENCH_RECORD_SECONDS,
+         sectors, WRITE_NAME, dataPages, (double) dataPages / sectors,
+         (double) dataPages / BENCH_RECORD_SECONDS, pages);
+  return checkResult(BENCH_NAME);
+}
@@ -0,0 +1,43 @@
+/*
+ * check.h
+ *
+ * Minimal assertion helpers for host tests. A failed check prints where and
+ * why, and the test keeps going; main() returns checkResult().
+ */
+
+#ifndef TEST_CHECK_H_
+#define TEST_CHECK_H_
+
+#include <stdio.h>
+
+extern int checkFailures;
+
+#define CHECK(cond, ...)                                                    \
+  do                                                                        \
+  {                                                                         \
+    if (!(cond))                                                            \
+    {                                                                       \
+      if (checkFailures++ < 20)                                             \
+      {                                                                     \
+        fprintf(stderr, "%s:%d: check failed: %s: ", __FILE__, __LINE__,   \
+                #cond);                                                     \
+        fprintf(stderr, __VA_ARGS__);                                       \
+        fputc('\n', stderr);                                                \
+      }                                                                     \
+    }                                                                       \
+  } while (0)
+
+#define CHECK_DEFINE int checkFailures = 0
+
+static inline int checkResult(const char *name)
+{
+  if (checkFailures)
+  {
+    fprintf(stderr, "%s: %d check(s) failed\n", name, checkFailures);
+    return 1;
+  }
+  printf("%s: ok\n", name);
+  return 0;
+}
+
+#endif /* TEST_CHECK_H_ */
@@ -0,0 +1,230 @@
+/*
+ * corpus.c
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "corpus.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+static const char *names[CORPUS_KIND_NUM] = { "noise", "sweep", "speech",
+                                              "square", "silence" };
+
+const char *corpusName(CorpusKind_t kind)
+{
+  return names[kind];
+}
+
+/* xorshift32 */
+uint32_t corpusRand(uint32_t *seed)
+{
+  uint32_t x = *seed ? *seed : 1;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  *seed = x;
+  return x;
+}
+
+static double uniform(uint32_t *seed)
+{
+  return (corpusRand(seed) >> 8) / 16777216.0 * 2.0 - 1.0;
+}
+
+static int16_t clip(double x)
+{
+  if (x > 32767.0)
+    return 32767;
+  if (x < -32768.0)
+    return -32768;
+  return (int16_t) lrint(x);
+}
+
+/*
+ * Crude speech stand-in: syllables of about 200 ms with a harmonic source
+ * (f0 gliding 90 - 220 Hz) shaped by two fixed resonances, every third
+ * syllable a fricative (high-passed noise), and 300 ms pauses in between.
+ */
+static void fillSpeech(int16_t *pcm, size_t n, uint32_t rate, uint32_t seed)
+{
+  double phase = 0;
+  double y1 = 0, y2 = 0, z1 = 0, z2 = 0, hp = 0;
+  size_t syl = 0;
+  size_t pos = 0;
+
+  while (pos < n)
+  {
+    size_t len = rate / 5 + corpusRand(&seed) % (rate / 10);
+    size_t pause = rate * 3 / 10;
+    double f0 = 90 + corpusRand(&seed) % 130;
+    double amp = 3000 + corpusRand(&seed) % 9000;
+    int fricative = (syl++ % 3) == 2;
+
+    /* resonators around 700 Hz and 1800 Hz */
+    double r = 0.97;
+    double a1 = 2 * r * cos(2 * M_PI * 700 / rate), a2 = -r * r;
+    double b1 = 2 * r * cos(2 * M_PI * 1800 / rate), b2 = -r * r;
+
+    for (size_t i = 0; i < len + pause && pos < n; i++, pos++)
+    {
+      double env = i < len ? sin(M_PI * i / len) : 0;
+      double x;
+
+      if (fricative)
+      {
+        double w = uniform(&seed);
+        x = w - hp;
+        hp = w;
+        x *= amp * 0.5;
+      }
+      else
+      {
+        phase += 2 * M_PI * (f0 + 40.0 * i / len) / rate;
+        double src = 0;
+        for (int h = 1; h <= 12; h++)
+        {
+          src += sin(h * phase) / h;
+        }
+        double y = src + a1 * y1 + a2 * y2;
+        y2 = y1;
+        y1 = y;
+        double z = y + b1 * z1 + b2 * z2;
+        z2 = z1;
+        z1 = z;
+        x = (y * 0.05 + z * 0.02) * amp / 8;
+      }
+
+      pcm[pos] = clip(x * env + uniform(&seed) * 20);
+    }
+  }
+}
+
+void corpusFill(CorpusKind_t kind, int16_t *pcm, size_t n, uint32_t rate,
+                uint32_t seed)
+{
+  size_t i;
+  double phase = 0;
+
+  switch (kind)
+  {
+  case CORPUS_NOISE:
+    for (i = 0; i < n; i++)
+    {
+      pcm[i] = (int16_t) corpusRand(&seed);
+    }
+    break;
+
+  case CORPUS_SWEEP:
+    for (i = 0; i < n; i++)
+    {
+      double f = 50 * pow(7000.0 / 50, (double) i / n);
+      phase += 2 * M_PI * f / rate;
+      pcm[i] = clip(16384 * sin(phase));
+    }
+    break;
+
+  case CORPUS_SPEECH:
+    fillSpeech(pcm, n, rate, seed);
+    break;
+
+  case CORPUS_SQUARE:
+    for (i = 0; i < n; i++)
+    {
+      pcm[i] = ((i / 37) & 1) ? 32767 : -32768;
+    }
+    break;
+
+  case CORPUS_SILENCE:
+  default:
+    for (i = 0; i < n; i++)
+    {
+      pcm[i] = (int16_t) (corpusRand(&seed) % 9) - 4;
+    }
+    break;
+  }
+}
+
+static uint32_t le32(const uint8_t *p)
+{
+  return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t) p[3] << 24;
+}
+
+static uint16_t le16(const uint8_t *p)
+{
+  return p[0] | p[1] << 8;
+}
+
+int16_t *corpusLoadWav(const char *path, size_t *n, uint32_t *rate)
+{
+  FILE *fp = fopen(path, "rb");
+  uint8_t hdr[12];
+  uint16_t channels = 0, bits = 0;
+  int16_t *pcm = NULL;
+
+  if (!fp)
+    return NULL;
+
+  if (fread(hdr, 1, 12, fp) != 12 || memcmp(hdr, "RIFF", 4)
+      || memcmp(hdr + 8, "WAVE", 4))
+    goto out;
+
+  for (;;)
+  {
+    uint8_t ck[8];
+    if (fread(ck, 1, 8, fp) != 8)
+      goto out;
+
+    uint32_t size = le32(ck + 4);
+
+    if (!memcmp(ck, "fmt ", 4))
+    {
+      uint8_t fmt[16];
+      if (size < 16 || fread(fmt, 1, 16, fp) != 16)
+        goto out;
+      if (le16(fmt) != 1)       // PCM only
+        goto out;
+      channels = le16(fmt + 2);
+      *rate = le32(fmt + 4);
+      bits = le16(fmt + 14);
+      fseek(fp, (size - 16 + 1) & ~1u, SEEK_CUR);
+    }
+    else if (!memcmp(ck, "data", 4))
+    {
+      if (bits != 16 || channels == 0)
+        goto out;
+
+      size_t frames = size / 2 / channels;
+      int16_t *raw = malloc(size);
+      if (!raw || fread(raw, 2 * channels, frames, fp) != frames)
+      {
+        free(raw);
+        goto out;
+      }
+
+      pcm = malloc(frames * sizeof(int16_t));
+      if (pcm)
+      {
+        for (size_t i = 0; i < frames; i++)
+        {
+          pcm[i] = (int16_t) le16((const uint8_t *) &raw[i * channels]);
+        }
+        *n = frames;
+      }
+      free(raw);
+      goto out;
+    }
+    else
+    {
+      fseek(fp, (size + 1) & ~1u, SEEK_CUR);
+    }
+  }
+
+out:
+  fclose(fp);
+  return pcm;
+}
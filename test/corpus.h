@@ -0,0 +1,40 @@
+/*
+ * corpus.h
+ *
+ * Test signals for host builds of the codec. Everything is generated from a
+ * fixed seed, so test and benchmark runs are reproducible.
+ */
+
+#ifndef TEST_CORPUS_H_
+#define TEST_CORPUS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum CorpusKind
+{
+  CORPUS_NOISE,         // uniform full scale, worst case for the quantizer
+  CORPUS_SWEEP,         // sine sweep 50 Hz - 7 kHz, half scale
+  CORPUS_SPEECH,        // voiced harmonics, fricatives and pauses
+  CORPUS_SQUARE,        // full scale square, drives predictor into clamps
+  CORPUS_SILENCE,       // low level noise around zero
+  CORPUS_KIND_NUM
+} CorpusKind_t;
+
+const char *corpusName(CorpusKind_t kind);
+
+/*
+ * Fill pcm with n samples of kind at rate hz, seeded by seed.
+ */
+void corpusFill(CorpusKind_t kind, int16_t *pcm, size_t n, uint32_t rate,
+                uint32_t seed);
+
+/*
+ * Load a 16-bit PCM wav file (first channel if not mono). Returns a malloc'd
+ * buffer and sets *n and *rate, or NULL on error.
+ */
+int16_t *corpusLoadWav(const char *path, size_t *n, uint32_t *rate);
+
+uint32_t corpusRand(uint32_t *seed);
+
+#endif /* TEST_CORPUS_H_ */
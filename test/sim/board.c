@@ -0,0 +1,168 @@
+/*
+ * board.c
+ *
+ * What main.c and the board give the three tasks: the globals of main.c,
+ * the power button on Board_GPIO_BTN1, the wakeup pins and shutdown, and
+ * the display. simBoot() does what main() does, and holds the button down
+ * the way a user powers the recorder on.
+ */
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <ti/display/Display.h>
+#include <ti/drivers/GPIO.h>
+#include <ti/drivers/Power.h>
+#include <ti/drivers/pin/PINCC26XX.h>
+#include <ti/sysbios/knl/Semaphore.h>
+
+#include <board.h>
+#include <hal_types.h>
+
+#include "button.h"
+#include "simple_peripheral.h"
+#include "sim.h"
+
+#define SIM_LONG_PRESS_MS                 2300  // button.c takes 2 s
+#define SIM_CLICK_MS                      150   // 80 to 300 ms
+#define SIM_BOOT_TIMEOUT                  (60 * SIM_S)
+
+/* main.c */
+bool isWakingFromShutdown = true;
+Display_Handle dispHandle;
+
+extern Event_Handle audioEvent;
+
+static bool pressed;
+
+void AssertHandler(uint8 assertCause, uint8 assertSubcause)
+{
+  fprintf(stderr, "sim: assert, cause %u, subcause %u\n", assertCause,
+          assertSubcause);
+  abort();
+}
+
+void simDisplay(const char *fmt, ...)
+{
+  static int verbose = -1;
+  if (verbose < 0)
+  {
+    verbose = getenv("SIM_VERBOSE") != NULL;
+  }
+  if (!verbose)
+    return;
+
+  va_list ap;
+  va_start(ap, fmt);
+  printf("%10.3f ", simNow / 1000.0);
+  vprintf(fmt, ap);
+  putchar('\n');
+  va_end(ap);
+}
+
+/*
+ * GPIO, the button is active low
+ */
+uint_fast8_t GPIO_read(uint_least8_t index)
+{
+  return index == Board_GPIO_BTN1 ? !pressed : 0;
+}
+
+void GPIO_write(uint_least8_t index, unsigned int value)
+{
+  (void) index;
+  (void) value;
+}
+
+void GPIO_toggle(uint_least8_t index)
+{
+  (void) index;
+}
+
+int_fast16_t GPIO_setConfig(uint_least8_t index, GPIO_PinConfig pinConfig)
+{
+  (void) index;
+  (void) pinConfig;
+  return 0;
+}
+
+int PINCC26XX_setWakeup(const PIN_Config pinConfig[])
+{
+  (void) pinConfig;
+  return 0;
+}
+
+int_fast16_t Power_shutdown(unsigned int shutdownState,
+                            uint_fast32_t shutdownTime)
+{
+  (void) shutdownState;
+  (void) shutdownTime;
+
+  simDisplay("power off");
+  simPowerOff();
+  return 0;
+}
+
+static void buttonFxn(void *arg)
+{
+  pressed = arg != NULL;
+}
+
+void simButton(SimTime at, SimTime ms)
+{
+  simAt(at, buttonFxn, (void*) 1);
+  simAt(at + ms * SIM_MS, buttonFxn, NULL);
+}
+
+/*
+ * main(): semaphores and tasks, then the button wakes the device.
+ */
+static void power(void)
+{
+  launchAudioSem = Semaphore_create(0, NULL, Error_IGNORE);
+  launchBleSem = Semaphore_create(0, NULL, Error_IGNORE);
+
+  Audio_createTask();
+  SimplePeripheral_createTask();
+  Button_createTask();
+}
+
+static bool booted(void)
+{
+  return !pressed && simBleUp() && simPending(audioEvent);
+}
+
+void simBoot(void)
+{
+  power();
+  pressed = true;
+  simButton(simNow, SIM_LONG_PRESS_MS);
+
+  if (!simRunUntil(booted, SIM_BOOT_TIMEOUT))
+  {
+    fprintf(stderr, "sim: tasks did not come up\n");
+    exit(2);
+  }
+}
+
+static bool recording(void)
+{
+  return simI2sRunning();
+}
+
+/*
+ * Double click: the audio task alone, recording from the start.
+ */
+void simBootRecording(void)
+{
+  power();
+  pressed = true;
+  simButton(simNow, SIM_CLICK_MS);
+  simButton(simNow + 2 * SIM_CLICK_MS * SIM_MS, SIM_CLICK_MS);
+
+  if (!simRunUntil(recording, SIM_BOOT_TIMEOUT))
+  {
+    fprintf(stderr, "sim: recording did not start\n");
+    exit(2);
+  }
+}
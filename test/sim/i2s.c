@@ -0,0 +1,172 @@
+/*
+ * i2s.c
+ *
+ * Microphone on the I2S transaction queue, as the CC26XX driver runs it
+ * for audio.c: at the end of each period (fixedBufferLength bytes of
+ * 16-bit mono samples) the buffer being filled is done, the driver moves
+ * on to the next transaction in the queue and calls readCallback with it.
+ * If there is no next one, the queue ran empty: the driver stops and calls
+ * errorCallback. That is the starvation the stats count.
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include <ti/drivers/I2S.h>
+
+#include "sim.h"
+
+struct I2S_Config
+{
+  bool open;
+  bool running;
+  I2S_Params params;
+  I2S_Transaction *cur;       // being filled
+  uint32_t queued;            // transactions in queue at start
+  uint32_t timer;
+};
+
+static struct I2S_Config i2s;
+
+static SimSourceFxn sourceFxn;
+static void *sourceArg;
+
+void simI2sSource(SimSourceFxn fxn, void *arg)
+{
+  sourceFxn = fxn;
+  sourceArg = arg;
+}
+
+bool simI2sRunning(void)
+{
+  return i2s.running;
+}
+
+static SimTime period(void)
+{
+  return (SimTime) i2s.params.fixedBufferLength / sizeof(int16_t) * SIM_S
+      / i2s.params.samplingFrequency;
+}
+
+static void tick(void *arg)
+{
+  I2S_Handle handle = arg;
+  if (!handle->running)
+    return;
+
+  I2S_Transaction *t = handle->cur;
+  size_t n = t->bufSize / sizeof(int16_t);
+  if (sourceFxn)
+  {
+    sourceFxn(t->bufPtr, n, sourceArg);
+  }
+  else
+  {
+    memset(t->bufPtr, 0, t->bufSize);
+  }
+  t->bytesTransferred = t->bufSize;
+  t->numberOfCompletions++;
+  simStats.i2sBuffers++;
+
+  I2S_Transaction *next = (I2S_Transaction*) List_next(&t->queueElement);
+  if (next == NULL)
+  {
+    simStats.i2sErrors++;
+    handle->running = false;
+    if (handle->params.errorCallback)
+    {
+      handle->params.errorCallback(handle, I2S_PTR_READ_ERROR, t);
+    }
+    return;
+  }
+
+  handle->cur = next;
+  handle->params.readCallback(handle, I2S_TRANSACTION_SUCCESS, next);
+
+  uint32_t ahead = 0;
+  for (List_Elem *e = List_next(&next->queueElement); e; e = List_next(e))
+  {
+    ahead++;
+  }
+  if (ahead < simStats.i2sMinAhead)
+  {
+    simStats.i2sMinAhead = ahead;
+  }
+  if (handle->queued - 1 - ahead > simStats.i2sMaxBacklog)
+  {
+    simStats.i2sMaxBacklog = handle->queued - 1 - ahead;
+  }
+
+  handle->timer = simAt(simNow + period(), tick, handle);
+}
+
+void I2S_init(void)
+{
+}
+
+void I2S_Params_init(I2S_Params *params)
+{
+  memset(params, 0, sizeof(*params));
+}
+
+void I2S_Transaction_init(I2S_Transaction *transaction)
+{
+  memset(transaction, 0, sizeof(*transaction));
+}
+
+I2S_Handle I2S_open(unsigned int index, I2S_Params *params)
+{
+  (void) index;
+
+  if (i2s.open)
+    return NULL;
+
+  i2s.open = true;
+  i2s.running = false;
+  i2s.params = *params;
+  i2s.cur = NULL;
+  return &i2s;
+}
+
+void I2S_close(I2S_Handle handle)
+{
+  I2S_stopRead(handle);
+  handle->open = false;
+}
+
+void I2S_setReadQueueHead(I2S_Handle handle, I2S_Transaction *transaction)
+{
+  handle->cur = transaction;
+  handle->queued = 0;
+  for (List_Elem *e = &transaction->queueElement; e; e = List_next(e))
+  {
+    handle->queued++;
+  }
+}
+
+void I2S_startClocks(I2S_Handle handle)
+{
+  (void) handle;
+}
+
+void I2S_stopClocks(I2S_Handle handle)
+{
+  I2S_stopRead(handle);
+}
+
+void I2S_startRead(I2S_Handle handle)
+{
+  if (!handle->open || handle->running || handle->cur == NULL)
+    return;
+
+  handle->running = true;
+  handle->timer = simAt(simNow + period(), tick, handle);
+}
+
+void I2S_stopRead(I2S_Handle handle)
+{
+  if (handle->running)
+  {
+    simCancel(handle->timer);
+    handle->running = false;
+  }
+}
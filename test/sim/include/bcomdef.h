@@ -0,0 +1,35 @@
+/*
+ * bcomdef.h
+ *
+ * Host stand-in, status codes and byte helpers of the ble stack, values
+ * as in the stack's headers.
+ */
+
+#ifndef SIM_BCOMDEF_H_
+#define SIM_BCOMDEF_H_
+
+#include <hal_types.h>
+
+typedef uint8 bStatus_t;
+
+#define SUCCESS                           0x00
+#define FAILURE                           0x01
+#define INVALIDPARAMETER                  0x02
+#define bleIncorrectMode                  0x12
+#define bleMemAllocError                  0x13
+#define bleNotConnected                   0x14
+#define bleInvalidRange                   0x18
+#define bleNoResources                    0x1a
+#define bleInvalidMtuSize                 0x1b
+
+#define B_ADDR_LEN                        6
+
+#define CONNHANDLE_INVALID                0xfffe
+#define CONNHANDLE_ALL                    0xfffd
+
+#define LO_UINT16(a)                      ((a) & 0xff)
+#define HI_UINT16(a)                      (((a) >> 8) & 0xff)
+#define BUILD_UINT16(lo, hi)              ((uint16) (((lo) & 0xff) \
+                                                     + (((hi) & 0xff) << 8)))
+
+#endif /* SIM_BCOMDEF_H_ */
@@ -0,0 +1,36 @@
+/*
+ * board.h
+ *
+ * Host stand-in, driver and pin indices only.
+ */
+
+#ifndef SIM_BOARD_H_
+#define SIM_BOARD_H_
+
+#define Board_NVSEXTERNAL                 1
+#define Board_I2S0                        0
+#define Board_UART0                       0
+
+#define Board_GPIO_BTN1                   0
+#define Board_GPIO_1V8_EN                 1
+#define Board_GPIO_I2S_SELECT             2
+#define Board_GPIO_FLASH_CS               3
+#define Board_GPIO_FLASH_RESET            4
+#define Board_GPIO_FLASH_WP               5
+
+#define CC2640R2DK_5MM_KEY_POWER          0
+#define CC2640R2DK_5MM_I2S_SELECT         1
+#define CC2640R2DK_5MM_I2S_ADI            2
+#define CC2640R2DK_5MM_I2S_BCLK           3
+#define CC2640R2DK_5MM_I2S_WCLK           4
+#define CC2640R2DK_5MM_SPI_FLASH_CS       5
+#define CC2640R2DK_5MM_SPI_FLASH_RESET    6
+#define CC2640R2DK_5MM_SPI_FLASH_WP       7
+#define CC2640R2DK_5MM_1V8_EN             8
+#define CC2640R2DK_5MM_UART_RX            9
+#define CC2640R2DK_5MM_UART_TX            10
+#define CC2640R2DK_5MM_SPI0_MOSI          11
+#define CC2640R2DK_5MM_SPI0_MISO          12
+#define CC2640R2DK_5MM_SPI0_CLK           13
+
+#endif /* SIM_BOARD_H_ */
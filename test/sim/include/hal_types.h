@@ -0,0 +1,21 @@
+/*
+ * hal_types.h
+ *
+ * Host stand-in, the ble stack's integer types.
+ */
+
+#ifndef SIM_HAL_TYPES_H_
+#define SIM_HAL_TYPES_H_
+
+#include <stdint.h>
+
+typedef int8_t int8;
+typedef uint8_t uint8;
+typedef int16_t int16;
+typedef uint16_t uint16;
+typedef int32_t int32;
+typedef uint32_t uint32;
+
+#define CONST                             const
+
+#endif /* SIM_HAL_TYPES_H_ */
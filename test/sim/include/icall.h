@@ -0,0 +1,55 @@
+/*
+ * icall.h
+ *
+ * Host stand-in, the ICall calls the application makes, see
+ * test/sim/stack.c. Messages and ICall_malloc() blocks are tagged, so
+ * that a block freed with the wrong call is counted.
+ */
+
+#ifndef SIM_ICALL_H_
+#define SIM_ICALL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <ti/sysbios/BIOS.h>
+#include <ti/sysbios/knl/Event.h>
+
+typedef uint8_t ICall_EntityID;
+typedef uint8_t ICall_ServiceEnum;
+typedef int_fast16_t ICall_Errno;
+typedef Event_Handle ICall_SyncHandle;
+
+#define ICALL_SERVICE_CLASS_BLE           0x10
+#define ICALL_ERRNO_SUCCESS               0
+#define ICALL_ERRNO_NOMSG                 (-4)
+#define ICALL_MSG_EVENT_ID                Event_Id_31
+#define ICALL_TIMEOUT_FOREVER             BIOS_WAIT_FOREVER
+
+typedef struct ICall_Hdr
+{
+  uint8_t event;
+  uint8_t status;
+} ICall_Hdr;
+
+typedef struct ICall_Stack_Event
+{
+  ICall_Hdr hdr;
+  uint16_t signature;
+} ICall_Stack_Event;
+
+typedef struct ICall_HciExtEvt
+{
+  ICall_Hdr hdr;
+} ICall_HciExtEvt;
+
+ICall_Errno ICall_registerApp(ICall_EntityID *entity,
+                              ICall_SyncHandle *msgSyncHdl);
+ICall_Errno ICall_fetchServiceMsg(ICall_ServiceEnum *src,
+                                  ICall_EntityID *dest, void **msg);
+void *ICall_allocMsg(size_t size);
+void ICall_freeMsg(void *msg);
+void *ICall_malloc(uint_least16_t size);
+void ICall_free(void *msg);
+
+#endif /* SIM_ICALL_H_ */
@@ -0,0 +1,316 @@
+/*
+ * icall_ble_api.h
+ *
+ * Host stand-in, the GAP, GATT and HCI part of the ble stack API that
+ * simple_peripheral.c and simple_gatt_profile.c use, see test/sim/stack.c.
+ * Values as in the stack's headers.
+ */
+
+#ifndef SIM_ICALL_BLE_API_H_
+#define SIM_ICALL_BLE_API_H_
+
+#include <stdint.h>
+
+#include <bcomdef.h>
+#include <icall.h>
+
+typedef struct osal_event_hdr_t
+{
+  uint8 event;
+  uint8 status;
+} osal_event_hdr_t;
+
+#define HAL_ASSERT_CAUSE_HARDWARE_ERROR   0x02
+
+/*
+ * HCI
+ */
+#define HCI_GAP_EVENT_EVENT               0x91
+#define HCI_COMMAND_COMPLETE_EVENT_CODE   0x0e
+#define HCI_COMMAND_STATUS_EVENT_CODE     0x0f
+#define HCI_BLE_HARDWARE_ERROR_EVENT_CODE 0x10
+#define HCI_LE_EVENT_CODE                 0x3e
+
+bStatus_t HCI_LE_WriteSuggestedDefaultDataLenCmd(uint16 txOctets,
+                                                 uint16 txTime);
+
+/*
+ * GAP
+ */
+#define GAP_MSG_EVENT                     0xd0
+#define GAP_DEVICE_INIT_DONE_EVENT        0x00
+#define GAP_LINK_ESTABLISHED_EVENT        0x05
+#define GAP_LINK_TERMINATED_EVENT         0x06
+
+#define GAP_PROFILE_PERIPHERAL            0x04
+#define GAP_DEVICE_NAME_LEN               21
+
+#define GAP_ADTYPE_FLAGS                  0x01
+#define GAP_ADTYPE_128BIT_COMPLETE        0x07
+#define GAP_ADTYPE_LOCAL_NAME_COMPLETE    0x09
+#define GAP_ADTYPE_POWER_LEVEL            0x0a
+#define GAP_ADTYPE_SLAVE_CONN_INTERVAL_RANGE 0x12
+#define GAP_ADTYPE_FLAGS_GENERAL          0x02
+#define GAP_ADTYPE_FLAGS_BREDR_NOT_SUPPORTED 0x04
+
+#define GAP_PARAM_LINK_UPDATE_DECISION    0x0f
+#define GAP_UPDATE_REQ_ACCEPT_ALL         0x01
+
+typedef enum
+{
+  ADDRMODE_PUBLIC,
+  ADDRMODE_RANDOM,
+  ADDRMODE_RP_WITH_PUBLIC_ID,
+  ADDRMODE_RP_WITH_RANDOM_ID
+} GAP_Addr_Modes_t;
+
+typedef struct gapEventHdr_t
+{
+  osal_event_hdr_t hdr;
+  uint8 opcode;
+} gapEventHdr_t;
+
+typedef struct gapDeviceInitDoneEvent_t
+{
+  osal_event_hdr_t hdr;
+  uint8 opcode;
+  uint8 devAddr[B_ADDR_LEN];
+  uint16 dataPktLen;
+  uint8 numDataPkts;
+} gapDeviceInitDoneEvent_t;
+
+typedef struct gapEstLinkReqEvent_t
+{
+  osal_event_hdr_t hdr;
+  uint8 opcode;
+  uint8 devAddrType;
+  uint8 devAddr[B_ADDR_LEN];
+  uint16 connectionHandle;
+  uint8 connRole;
+  uint16 connInterval;                  // 1.25 ms
+  uint16 connLatency;
+  uint16 connTimeout;
+  uint8 clockAccuracy;
+} gapEstLinkReqEvent_t;
+
+typedef struct gapTerminateLinkEvent_t
+{
+  osal_event_hdr_t hdr;
+  uint8 opcode;
+  uint16 connectionHandle;
+  uint8 reason;
+} gapTerminateLinkEvent_t;
+
+bStatus_t GAP_DeviceInit(uint8 profileRole, uint8 taskID,
+                         GAP_Addr_Modes_t addrMode, uint8 *pRandomAddr);
+bStatus_t GAP_SetParamValue(uint16 paramID, uint16 paramValue);
+void GAP_RegisterForMsgs(uint8 taskID);
+uint8 linkDB_NumActive(void);
+
+/* advertising */
+#define GAP_EVT_ADV_START_AFTER_ENABLE    (1u << 0)
+#define GAP_EVT_ADV_END_AFTER_DISABLE     (1u << 1)
+#define GAP_EVT_ADV_SET_TERMINATED        (1u << 4)
+#define GAP_EVT_INSUFFICIENT_MEMORY       (1u << 31)
+
+#define GAP_ADV_EVT_MASK_START_AFTER_ENABLE GAP_EVT_ADV_START_AFTER_ENABLE
+#define GAP_ADV_EVT_MASK_END_AFTER_DISABLE  GAP_EVT_ADV_END_AFTER_DISABLE
+#define GAP_ADV_EVT_MASK_SET_TERMINATED     GAP_EVT_ADV_SET_TERMINATED
+
+typedef enum
+{
+  GAP_ADV_DATA_TYPE_ADV,
+  GAP_ADV_DATA_TYPE_SCAN_RSP
+} GapAdv_dataTypes_t;
+
+typedef enum
+{
+  GAP_ADV_ENABLE_OPTIONS_USE_MAX,
+  GAP_ADV_ENABLE_OPTIONS_USE_DURATION,
+  GAP_ADV_ENABLE_OPTIONS_USE_MAX_EVENTS
+} GapAdv_enableOptions_t;
+
+typedef struct GapAdv_params_t
+{
+  uint16 eventProps;
+  uint32 primIntMin;                    // 0.625 ms
+  uint32 primIntMax;
+} GapAdv_params_t;
+
+#define GAPADV_PARAMS_LEGACY_SCANN_CONN   { .eventProps = 0x13,            \
+                                            .primIntMin = 160,             \
+                                            .primIntMax = 160 }
+
+typedef void (*pfnGapCB_t)(uint32_t event, void *pBuf, uintptr_t arg);
+
+bStatus_t GapAdv_create(pfnGapCB_t cb, GapAdv_params_t *advParam,
+                        uint8 *advHandle);
+bStatus_t GapAdv_loadByHandle(uint8 handle, GapAdv_dataTypes_t dataType,
+                              uint16 len, uint8 *pBuf);
+bStatus_t GapAdv_setEventMask(uint8 handle, uint32_t mask);
+bStatus_t GapAdv_enable(uint8 handle, GapAdv_enableOptions_t enableOptions,
+                        uint16 durationOrMaxEvents);
+
+/* connection event report, the receiver frees it with ICall_free() */
+typedef enum
+{
+  GAP_CB_UNREGISTER,
+  GAP_CB_REGISTER
+} GAP_CB_Action_t;
+
+typedef enum
+{
+  GAP_CONN_EVT_STAT_SUCCESS,
+  GAP_CONN_EVT_STAT_CRC_ERROR,
+  GAP_CONN_EVT_STAT_MISSED
+} GAP_ConnEvtStat_t;
+
+typedef struct Gap_ConnEventRpt_t
+{
+  GAP_ConnEvtStat_t status;
+  uint16_t handle;
+  uint8_t channel;
+  uint8_t phy;
+  int8_t lastRssi;
+  uint16_t packets;                     // sent in this event
+  uint16_t errors;
+  uint8_t nextTaskType;
+  uint32_t nextTaskTime;
+  uint16_t eventCounter;
+  uint32_t timeStamp;
+} Gap_ConnEventRpt_t;
+
+typedef void (*pfnGapConnEvtCB_t)(Gap_ConnEventRpt_t *pReport);
+
+bStatus_t Gap_RegisterConnEventCb(pfnGapConnEvtCB_t cb,
+                                  GAP_CB_Action_t action, uint16_t connHandle);
+
+/*
+ * GATT
+ */
+#define GATT_MSG_EVENT                    0xb0
+
+#define ATT_MTU_SIZE                      23
+#define ATT_BT_UUID_SIZE                  2
+#define ATT_UUID_SIZE                     16
+
+#define ATT_HANDLE_VALUE_NOTI             0x1b
+#define ATT_MTU_UPDATED_EVENT             0x7f
+
+#define ATT_ERR_INVALID_HANDLE            0x01
+#define ATT_ERR_ATTR_NOT_FOUND            0x0a
+#define ATT_ERR_ATTR_NOT_LONG             0x0b
+#define ATT_ERR_INVALID_VALUE_SIZE        0x0d
+#define ATT_ERR_UNLIKELY                  0x0e
+#define ATT_ERR_INSUFFICIENT_RESOURCES    0x11
+#define ATT_ERR_INVALID_VALUE             0x80
+
+#define GATT_PERMIT_READ                  0x01
+#define GATT_PERMIT_WRITE                 0x02
+
+#define GATT_PROP_READ                    0x02
+#define GATT_PROP_WRITE                   0x08
+#define GATT_PROP_NOTIFY                  0x10
+
+#define GATT_CLIENT_CHAR_CFG_UUID         0x2902
+#define GATT_CFG_NO_OPERATION             0x0000
+#define GATT_CLIENT_CFG_NOTIFY            0x0001
+
+#define GATT_MAX_ENCRYPT_KEY_SIZE         16
+#define GATT_ALL_SERVICES                 0xffffffff
+#define GGS_DEVICE_NAME_ATT               0
+
+#define GATT_NUM_ATTRS(attrs)             (sizeof(attrs) / sizeof(gattAttribute_t))
+
+typedef struct gattAttrType_t
+{
+  uint8 len;
+  const uint8 *uuid;
+} gattAttrType_t;
+
+typedef struct gattAttribute_t
+{
+  gattAttrType_t type;
+  uint8 permissions;
+  uint16 handle;
+  uint8 *const pValue;
+} gattAttribute_t;
+
+typedef struct gattCharCfg_t
+{
+  uint16 connHandle;
+  uint8 value;
+} gattCharCfg_t;
+
+typedef bStatus_t (*pfnGATTReadAttrCB_t)(uint16 connHandle,
+                                         gattAttribute_t *pAttr,
+                                         uint8 *pValue, uint16 *pLen,
+                                         uint16 offset, uint16 maxLen,
+                                         uint8 method);
+typedef bStatus_t (*pfnGATTWriteAttrCB_t)(uint16 connHandle,
+                                          gattAttribute_t *pAttr,
+                                          uint8 *pValue, uint16 len,
+                                          uint16 offset, uint8 method);
+typedef bStatus_t (*pfnGATTAuthorizeAttrCB_t)(uint16 connHandle,
+                                              gattAttribute_t *pAttr,
+                                              uint8 opcode);
+
+typedef struct gattServiceCBs_t
+{
+  pfnGATTReadAttrCB_t pfnReadAttrCB;
+  pfnGATTWriteAttrCB_t pfnWriteAttrCB;
+  pfnGATTAuthorizeAttrCB_t pfnAuthorizeAttrCB;
+} gattServiceCBs_t;
+
+typedef struct attHandleValueNoti_t
+{
+  uint16 handle;
+  uint16 len;
+  uint8 *pValue;
+} attHandleValueNoti_t;
+
+typedef struct attMtuUpdatedEvt_t
+{
+  uint16 MTU;
+} attMtuUpdatedEvt_t;
+
+typedef union gattMsg_t
+{
+  attHandleValueNoti_t handleValueNoti;
+  attMtuUpdatedEvt_t mtuEvt;
+} gattMsg_t;
+
+typedef struct gattMsgEvent_t
+{
+  osal_event_hdr_t hdr;
+  uint16 connHandle;
+  uint8 method;
+  gattMsg_t msg;
+} gattMsgEvent_t;
+
+extern CONST uint8 primaryServiceUUID[ATT_BT_UUID_SIZE];
+extern CONST uint8 characterUUID[ATT_BT_UUID_SIZE];
+extern CONST uint8 clientCharCfgUUID[ATT_BT_UUID_SIZE];
+extern CONST uint8 charUserDescUUID[ATT_BT_UUID_SIZE];
+
+void *GATT_bm_alloc(uint16 connHandle, uint8 opcode, uint16 size,
+                    uint16 *pSizeAlloc);
+void GATT_bm_free(gattMsg_t *pMsg, uint8 opcode);
+bStatus_t GATT_Notification(uint16 connHandle, attHandleValueNoti_t *pNoti,
+                            uint8 authenticated);
+void GATT_RegisterForMsgs(uint8 taskId);
+bStatus_t GATT_InitClient(void);
+
+bStatus_t GGS_SetParameter(uint8 param, uint8 len, void *value);
+bStatus_t GGS_AddService(uint32 services);
+bStatus_t GATTServApp_AddService(uint32 services);
+bStatus_t GATTServApp_RegisterService(gattAttribute_t *pAttrs,
+                                      uint16 numAttrs, uint8 encKeySize,
+                                      CONST gattServiceCBs_t *pServiceCBs);
+void GATTServApp_InitCharCfg(uint16 connHandle, gattCharCfg_t *charCfgTbl);
+bStatus_t GATTServApp_ProcessCCCWriteReq(uint16 connHandle,
+                                         gattAttribute_t *pAttr,
+                                         uint8 *pValue, uint16 len,
+                                         uint16 offset, uint16 validCfg);
+
+#endif /* SIM_ICALL_BLE_API_H_ */
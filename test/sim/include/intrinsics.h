@@ -0,0 +1,10 @@
+/*
+ * intrinsics.h
+ *
+ * Host stand-in, nothing of it is used.
+ */
+
+#ifndef SIM_INTRINSICS_H_
+#define SIM_INTRINSICS_H_
+
+#endif /* SIM_INTRINSICS_H_ */
@@ -0,0 +1,22 @@
+/*
+ * ti/display/Display.h
+ *
+ * Host stand-in, prints to stdout with SIM_VERBOSE set in the environment,
+ * see test/sim/board.c.
+ */
+
+#ifndef SIM_TI_DISPLAY_DISPLAY_H_
+#define SIM_TI_DISPLAY_DISPLAY_H_
+
+typedef struct Display_Config *Display_Handle;
+
+void simDisplay(const char *fmt, ...);
+
+#define Display_print0(h, l, c, fmt)                      simDisplay(fmt)
+#define Display_print1(h, l, c, fmt, a0)                  simDisplay(fmt, a0)
+#define Display_print2(h, l, c, fmt, a0, a1)              simDisplay(fmt, a0, a1)
+#define Display_print3(h, l, c, fmt, a0, a1, a2)          simDisplay(fmt, a0, a1, a2)
+#define Display_print4(h, l, c, fmt, a0, a1, a2, a3)      simDisplay(fmt, a0, a1, a2, a3)
+#define Display_print5(h, l, c, fmt, a0, a1, a2, a3, a4)  simDisplay(fmt, a0, a1, a2, a3, a4)
+
+#endif /* SIM_TI_DISPLAY_DISPLAY_H_ */
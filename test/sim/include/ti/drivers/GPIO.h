@@ -0,0 +1,24 @@
+/*
+ * ti/drivers/GPIO.h
+ *
+ * Host stand-in, see test/sim/board.c. The button reads low while
+ * pressed; outputs are ignored.
+ */
+
+#ifndef SIM_TI_DRIVERS_GPIO_H_
+#define SIM_TI_DRIVERS_GPIO_H_
+
+#include <stdint.h>
+
+typedef uint32_t GPIO_PinConfig;
+
+#define GPIO_CFG_OUT_STD                  (1u << 16)
+#define GPIO_CFG_OUT_HIGH                 (1u << 0)
+#define GPIO_CFG_OUT_LOW                  (0u << 0)
+
+uint_fast8_t GPIO_read(uint_least8_t index);
+void GPIO_write(uint_least8_t index, unsigned int value);
+void GPIO_toggle(uint_least8_t index);
+int_fast16_t GPIO_setConfig(uint_least8_t index, GPIO_PinConfig pinConfig);
+
+#endif /* SIM_TI_DRIVERS_GPIO_H_ */
@@ -0,0 +1,92 @@
+/*
+ * ti/drivers/I2S.h
+ *
+ * Host stand-in, a microphone on a transaction queue, see test/sim/i2s.c.
+ * Only what audio.c uses of the CC26XX driver.
+ */
+
+#ifndef SIM_TI_DRIVERS_I2S_H_
+#define SIM_TI_DRIVERS_I2S_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <ti/drivers/utils/List.h>
+
+#define I2S_TRANSACTION_SUCCESS           (0)
+#define I2S_PTR_READ_ERROR                (-4)  // queue ran empty
+
+typedef enum
+{
+  I2S_MEMORY_LENGTH_8BITS = 8,
+  I2S_MEMORY_LENGTH_16BITS = 16,
+  I2S_MEMORY_LENGTH_24BITS = 24
+} I2S_MemoryLength;
+
+typedef enum { I2S_SLAVE, I2S_MASTER } I2S_Role;
+typedef enum { I2S_SAMPLING_EDGE_FALLING, I2S_SAMPLING_EDGE_RISING } I2S_SamplingEdge;
+typedef enum { I2S_SD0_DISABLED, I2S_SD0_INPUT, I2S_SD0_OUTPUT } I2S_DataInterfaceUse;
+typedef enum { I2S_SD1_DISABLED = I2S_SD0_DISABLED } I2S_SD1Use;
+typedef enum
+{
+  I2S_CHANNELS_NONE,
+  I2S_CHANNELS_MONO,
+  I2S_CHANNELS_MONO_INV,
+  I2S_CHANNELS_STEREO
+} I2S_ChannelConfig;
+typedef enum { I2S_PHASE_TYPE_SINGLE, I2S_PHASE_TYPE_DUAL } I2S_PhaseType;
+
+typedef struct I2S_Config *I2S_Handle;
+
+typedef struct I2S_Transaction
+{
+  List_Elem queueElement;
+  void *bufPtr;
+  size_t bufSize;
+  size_t bytesTransferred;
+  size_t untransferredBytes;
+  uint16_t numberOfCompletions;
+  uintptr_t arg;
+} I2S_Transaction;
+
+typedef void (*I2S_Callback)(I2S_Handle handle, int_fast16_t status,
+                             I2S_Transaction *transactionPtr);
+
+typedef struct I2S_Params
+{
+  bool trueI2sFormat;
+  bool invertWS;
+  bool isMSBFirst;
+  bool isDMAUnused;
+  I2S_MemoryLength memorySlotLength;
+  uint8_t beforeWordPadding;
+  uint8_t afterWordPadding;
+  uint8_t bitsPerWord;
+  I2S_Role moduleRole;
+  I2S_SamplingEdge samplingEdge;
+  int SD0Use;
+  int SD1Use;
+  I2S_ChannelConfig SD0Channels;
+  I2S_ChannelConfig SD1Channels;
+  I2S_PhaseType phaseType;
+  uint16_t fixedBufferLength;
+  uint16_t startUpDelay;
+  uint16_t MCLKDivider;
+  uint32_t samplingFrequency;
+  I2S_Callback readCallback;
+  I2S_Callback writeCallback;
+  I2S_Callback errorCallback;
+} I2S_Params;
+
+void I2S_init(void);
+void I2S_Params_init(I2S_Params *params);
+void I2S_Transaction_init(I2S_Transaction *transaction);
+I2S_Handle I2S_open(unsigned int index, I2S_Params *params);
+void I2S_close(I2S_Handle handle);
+void I2S_setReadQueueHead(I2S_Handle handle, I2S_Transaction *transaction);
+void I2S_startClocks(I2S_Handle handle);
+void I2S_stopClocks(I2S_Handle handle);
+void I2S_startRead(I2S_Handle handle);
+void I2S_stopRead(I2S_Handle handle);
+
+#endif /* SIM_TI_DRIVERS_I2S_H_ */
@@ -0,0 +1,44 @@
+/*
+ * ti/drivers/NVS.h
+ *
+ * Host stand-in, a SPI NOR flash model, see test/sim/nvs.c.
+ */
+
+#ifndef SIM_TI_DRIVERS_NVS_H_
+#define SIM_TI_DRIVERS_NVS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define NVS_STATUS_SUCCESS                (0)
+#define NVS_STATUS_ERROR                  (-1)
+#define NVS_STATUS_INV_OFFSET             (-3)
+
+#define NVS_WRITE_ERASE                   (0x1)
+#define NVS_WRITE_PRE_VERIFY              (0x2)
+#define NVS_WRITE_POST_VERIFY             (0x4)
+
+typedef struct NVS_Config *NVS_Handle;
+
+typedef struct NVS_Params
+{
+  void *custom;
+} NVS_Params;
+
+typedef struct NVS_Attrs
+{
+  void *regionBase;
+  size_t regionSize;
+  size_t sectorSize;
+} NVS_Attrs;
+
+void NVS_Params_init(NVS_Params *params);
+NVS_Handle NVS_open(unsigned int index, NVS_Params *params);
+void NVS_getAttrs(NVS_Handle handle, NVS_Attrs *attrs);
+int_fast16_t NVS_read(NVS_Handle handle, size_t offset, void *buffer,
+                      size_t bufferSize);
+int_fast16_t NVS_write(NVS_Handle handle, size_t offset, void *buffer,
+                       size_t bufferSize, unsigned int flags);
+int_fast16_t NVS_erase(NVS_Handle handle, size_t offset, size_t size);
+
+#endif /* SIM_TI_DRIVERS_NVS_H_ */
@@ -0,0 +1,20 @@
+/*
+ * ti/drivers/PIN.h
+ *
+ * Host stand-in, the pin table button.c hands to PINCC26XX_setWakeup().
+ */
+
+#ifndef SIM_TI_DRIVERS_PIN_H_
+#define SIM_TI_DRIVERS_PIN_H_
+
+#include <stdint.h>
+
+typedef uint32_t PIN_Config;
+
+#define PIN_TERMINATE                     0xfe
+#define PIN_INPUT_EN                      (1u << 29)
+#define PIN_NOPULL                        (0u << 13)
+#define PIN_PULLUP                        (1u << 13)
+#define PIN_PULLDOWN                      (2u << 13)
+
+#endif /* SIM_TI_DRIVERS_PIN_H_ */
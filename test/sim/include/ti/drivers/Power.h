@@ -0,0 +1,15 @@
+/*
+ * ti/drivers/Power.h
+ *
+ * Host stand-in, see test/sim/board.c. Shutdown stops the simulation.
+ */
+
+#ifndef SIM_TI_DRIVERS_POWER_H_
+#define SIM_TI_DRIVERS_POWER_H_
+
+#include <stdint.h>
+
+int_fast16_t Power_shutdown(unsigned int shutdownState,
+                            uint_fast32_t shutdownTime);
+
+#endif /* SIM_TI_DRIVERS_POWER_H_ */
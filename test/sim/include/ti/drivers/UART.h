@@ -0,0 +1,12 @@
+/*
+ * ti/drivers/UART.h
+ *
+ * Host stand-in, only used under LOG_*, which the simulator does not build.
+ */
+
+#ifndef SIM_TI_DRIVERS_UART_H_
+#define SIM_TI_DRIVERS_UART_H_
+
+typedef struct UART_Config *UART_Handle;
+
+#endif /* SIM_TI_DRIVERS_UART_H_ */
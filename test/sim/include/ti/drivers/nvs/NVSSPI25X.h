@@ -0,0 +1,10 @@
+/*
+ * ti/drivers/nvs/NVSSPI25X.h
+ *
+ * Host stand-in, nothing of it is used.
+ */
+
+#ifndef SIM_TI_DRIVERS_NVS_NVSSPI25X_H_
+#define SIM_TI_DRIVERS_NVS_NVSSPI25X_H_
+
+#endif /* SIM_TI_DRIVERS_NVS_NVSSPI25X_H_ */
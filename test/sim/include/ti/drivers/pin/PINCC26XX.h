@@ -0,0 +1,16 @@
+/*
+ * ti/drivers/pin/PINCC26XX.h
+ *
+ * Host stand-in, see test/sim/board.c.
+ */
+
+#ifndef SIM_TI_DRIVERS_PIN_PINCC26XX_H_
+#define SIM_TI_DRIVERS_PIN_PINCC26XX_H_
+
+#include <ti/drivers/PIN.h>
+
+#define PINCC26XX_WAKEUP_NEGEDGE          (2u << 27)
+
+int PINCC26XX_setWakeup(const PIN_Config pinConfig[]);
+
+#endif /* SIM_TI_DRIVERS_PIN_PINCC26XX_H_ */
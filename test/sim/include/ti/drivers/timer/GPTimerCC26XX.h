@@ -0,0 +1,11 @@
+/*
+ * ti/drivers/timer/GPTimerCC26XX.h
+ *
+ * Host stand-in, nothing of it is used (simple_peripheral.c has the timer
+ * commented out).
+ */
+
+#ifndef SIM_TI_DRIVERS_TIMER_GPTIMERCC26XX_H_
+#define SIM_TI_DRIVERS_TIMER_GPTIMERCC26XX_H_
+
+#endif /* SIM_TI_DRIVERS_TIMER_GPTIMERCC26XX_H_ */
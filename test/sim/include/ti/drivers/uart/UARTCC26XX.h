@@ -0,0 +1,10 @@
+/*
+ * ti/drivers/uart/UARTCC26XX.h
+ *
+ * Host stand-in, nothing of it is used.
+ */
+
+#ifndef SIM_TI_DRIVERS_UART_UARTCC26XX_H_
+#define SIM_TI_DRIVERS_UART_UARTCC26XX_H_
+
+#endif /* SIM_TI_DRIVERS_UART_UARTCC26XX_H_ */
@@ -0,0 +1,58 @@
+/*
+ * ti/drivers/utils/List.h
+ *
+ * Host stand-in, same API and behaviour as the SDK list, without the
+ * interrupt locks (the simulator is single threaded).
+ */
+
+#ifndef SIM_TI_DRIVERS_UTILS_LIST_H_
+#define SIM_TI_DRIVERS_UTILS_LIST_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct List_Elem
+{
+  struct List_Elem *next;
+  struct List_Elem *prev;
+} List_Elem;
+
+typedef struct List_List
+{
+  List_Elem *head;
+  List_Elem *tail;
+} List_List;
+
+void List_clearList(List_List *list);
+List_Elem *List_get(List_List *list);
+void List_insert(List_List *list, List_Elem *newElem, List_Elem *curElem);
+void List_put(List_List *list, List_Elem *elem);
+void List_putHead(List_List *list, List_Elem *elem);
+void List_remove(List_List *list, List_Elem *elem);
+
+static inline bool List_empty(List_List *list)
+{
+  return list->head == NULL;
+}
+
+static inline List_Elem *List_head(List_List *list)
+{
+  return list->head;
+}
+
+static inline List_Elem *List_tail(List_List *list)
+{
+  return list->tail;
+}
+
+static inline List_Elem *List_next(List_Elem *elem)
+{
+  return elem->next;
+}
+
+static inline List_Elem *List_prev(List_Elem *elem)
+{
+  return elem->prev;
+}
+
+#endif /* SIM_TI_DRIVERS_UTILS_LIST_H_ */
@@ -0,0 +1,15 @@
+/*
+ * ti/sysbios/BIOS.h
+ *
+ * Host stand-in, see test/sim/kernel.c.
+ */
+
+#ifndef SIM_TI_SYSBIOS_BIOS_H_
+#define SIM_TI_SYSBIOS_BIOS_H_
+
+#include <xdc/std.h>
+
+#define BIOS_WAIT_FOREVER                 (~(UInt32) 0)
+#define BIOS_NO_WAIT                      ((UInt32) 0)
+
+#endif /* SIM_TI_SYSBIOS_BIOS_H_ */
@@ -0,0 +1,10 @@
+/*
+ * ti/sysbios/hal/Hwi.h
+ *
+ * Host stand-in, nothing of it is used.
+ */
+
+#ifndef SIM_TI_SYSBIOS_HAL_HWI_H_
+#define SIM_TI_SYSBIOS_HAL_HWI_H_
+
+#endif /* SIM_TI_SYSBIOS_HAL_HWI_H_ */
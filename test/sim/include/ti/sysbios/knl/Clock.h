@@ -0,0 +1,49 @@
+/*
+ * ti/sysbios/knl/Clock.h
+ *
+ * Host stand-in, ticks of virtual time, see test/sim/kernel.c. Instances
+ * run their function in scheduler context, as a Swi would.
+ */
+
+#ifndef SIM_TI_SYSBIOS_KNL_CLOCK_H_
+#define SIM_TI_SYSBIOS_KNL_CLOCK_H_
+
+#include <xdc/std.h>
+
+#define Clock_tickPeriod                  10    // us, as in the ble projects
+
+typedef void (*Clock_FuncPtr)(UArg arg);
+
+typedef struct Clock_Params
+{
+  UInt32 period;
+  Bool startFlag;
+  UArg arg;
+} Clock_Params;
+
+typedef struct Clock_Struct
+{
+  Clock_FuncPtr fxn;
+  UInt32 timeout;
+  UInt32 period;
+  UArg arg;
+  Bool active;
+  uint32_t timer;                       // simAt() id, 0 if none
+} Clock_Struct;
+
+typedef Clock_Struct *Clock_Handle;
+
+#define Clock_handle(obj)                 ((Clock_Handle) (obj))
+
+UInt32 Clock_getTicks(void);
+
+void Clock_Params_init(Clock_Params *params);
+void Clock_construct(Clock_Struct *obj, Clock_FuncPtr fxn, UInt32 timeout,
+                     const Clock_Params *params);
+void Clock_start(Clock_Handle handle);
+void Clock_stop(Clock_Handle handle);
+Bool Clock_isActive(Clock_Handle handle);
+void Clock_setTimeout(Clock_Handle handle, UInt32 timeout);
+void Clock_setPeriod(Clock_Handle handle, UInt32 period);
+
+#endif /* SIM_TI_SYSBIOS_KNL_CLOCK_H_ */
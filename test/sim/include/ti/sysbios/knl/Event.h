@@ -0,0 +1,61 @@
+/*
+ * ti/sysbios/knl/Event.h
+ *
+ * Host stand-in, see test/sim/kernel.c.
+ */
+
+#ifndef SIM_TI_SYSBIOS_KNL_EVENT_H_
+#define SIM_TI_SYSBIOS_KNL_EVENT_H_
+
+#include <xdc/std.h>
+#include <xdc/runtime/Error.h>
+
+#define Event_Id_NONE                     0
+#define Event_Id_00                       (1u << 0)
+#define Event_Id_01                       (1u << 1)
+#define Event_Id_02                       (1u << 2)
+#define Event_Id_03                       (1u << 3)
+#define Event_Id_04                       (1u << 4)
+#define Event_Id_05                       (1u << 5)
+#define Event_Id_06                       (1u << 6)
+#define Event_Id_07                       (1u << 7)
+#define Event_Id_08                       (1u << 8)
+#define Event_Id_09                       (1u << 9)
+#define Event_Id_10                       (1u << 10)
+#define Event_Id_11                       (1u << 11)
+#define Event_Id_12                       (1u << 12)
+#define Event_Id_13                       (1u << 13)
+#define Event_Id_14                       (1u << 14)
+#define Event_Id_15                       (1u << 15)
+#define Event_Id_16                       (1u << 16)
+#define Event_Id_17                       (1u << 17)
+#define Event_Id_18                       (1u << 18)
+#define Event_Id_19                       (1u << 19)
+#define Event_Id_20                       (1u << 20)
+#define Event_Id_21                       (1u << 21)
+#define Event_Id_22                       (1u << 22)
+#define Event_Id_23                       (1u << 23)
+#define Event_Id_24                       (1u << 24)
+#define Event_Id_25                       (1u << 25)
+#define Event_Id_26                       (1u << 26)
+#define Event_Id_27                       (1u << 27)
+#define Event_Id_28                       (1u << 28)
+#define Event_Id_29                       (1u << 29)
+#define Event_Id_30                       (1u << 30)
+#define Event_Id_31                       (1u << 31)
+
+typedef struct Event_Object *Event_Handle;
+typedef struct Event_Params Event_Params;
+
+Event_Handle Event_create(const Event_Params *params, Error_Block *eb);
+void Event_post(Event_Handle handle, UInt eventMask);
+
+/* andMask is passed as NULL by the firmware */
+UInt simEventPend(Event_Handle handle, UInt andMask, UInt orMask,
+                  UInt32 timeout);
+
+#define Event_pend(handle, andMask, orMask, timeout)                        \
+        simEventPend((handle), (UInt) (uintptr_t) (andMask), (orMask),    \
+                     (timeout))
+
+#endif /* SIM_TI_SYSBIOS_KNL_EVENT_H_ */
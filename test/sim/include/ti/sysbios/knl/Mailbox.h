@@ -0,0 +1,14 @@
+/*
+ * ti/sysbios/knl/Mailbox.h
+ *
+ * Host stand-in, not used by the firmware any more.
+ */
+
+#ifndef SIM_TI_SYSBIOS_KNL_MAILBOX_H_
+#define SIM_TI_SYSBIOS_KNL_MAILBOX_H_
+
+#include <xdc/std.h>
+
+typedef struct Mailbox_Object *Mailbox_Handle;
+
+#endif /* SIM_TI_SYSBIOS_KNL_MAILBOX_H_ */
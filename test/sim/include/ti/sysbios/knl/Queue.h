@@ -0,0 +1,16 @@
+/*
+ * ti/sysbios/knl/Queue.h
+ *
+ * Host stand-in, the element type util.c declares only.
+ */
+
+#ifndef SIM_TI_SYSBIOS_KNL_QUEUE_H_
+#define SIM_TI_SYSBIOS_KNL_QUEUE_H_
+
+typedef struct Queue_Elem
+{
+  struct Queue_Elem *next;
+  struct Queue_Elem *prev;
+} Queue_Elem;
+
+#endif /* SIM_TI_SYSBIOS_KNL_QUEUE_H_ */
@@ -0,0 +1,36 @@
+/*
+ * ti/sysbios/knl/Semaphore.h
+ *
+ * Host stand-in, see test/sim/kernel.c. A semaphore with an event keeps
+ * the event bit in sync with its count, as Event_sync() does.
+ */
+
+#ifndef SIM_TI_SYSBIOS_KNL_SEMAPHORE_H_
+#define SIM_TI_SYSBIOS_KNL_SEMAPHORE_H_
+
+#include <xdc/std.h>
+#include <xdc/runtime/Error.h>
+#include <ti/sysbios/knl/Event.h>
+
+typedef enum Semaphore_Mode
+{
+  Semaphore_Mode_COUNTING,
+  Semaphore_Mode_BINARY
+} Semaphore_Mode;
+
+typedef struct Semaphore_Params
+{
+  Event_Handle event;
+  UInt eventId;
+  Semaphore_Mode mode;
+} Semaphore_Params;
+
+typedef struct Semaphore_Object *Semaphore_Handle;
+
+void Semaphore_Params_init(Semaphore_Params *params);
+Semaphore_Handle Semaphore_create(Int count, const Semaphore_Params *params,
+                                  Error_Block *eb);
+Bool Semaphore_pend(Semaphore_Handle handle, UInt32 timeout);
+void Semaphore_post(Semaphore_Handle handle);
+
+#endif /* SIM_TI_SYSBIOS_KNL_SEMAPHORE_H_ */
@@ -0,0 +1,37 @@
+/*
+ * ti/sysbios/knl/Task.h
+ *
+ * Host stand-in, see test/sim/kernel.c. The highest-priority ready task
+ * runs; the stack given is ignored, each task gets one of the host's.
+ */
+
+#ifndef SIM_TI_SYSBIOS_KNL_TASK_H_
+#define SIM_TI_SYSBIOS_KNL_TASK_H_
+
+#include <xdc/std.h>
+#include <xdc/runtime/Error.h>
+
+typedef void (*Task_FuncPtr)(UArg a0, UArg a1);
+
+typedef struct Task_Params
+{
+  void *stack;
+  size_t stackSize;
+  Int priority;
+  UArg arg0;
+  UArg arg1;
+} Task_Params;
+
+typedef struct Task_Struct
+{
+  Task_FuncPtr fxn;
+  UArg arg0;
+  UArg arg1;
+} Task_Struct;
+
+void Task_Params_init(Task_Params *params);
+void Task_construct(Task_Struct *obj, Task_FuncPtr fxn,
+                    const Task_Params *params, Error_Block *eb);
+void Task_sleep(UInt32 ticks);
+
+#endif /* SIM_TI_SYSBIOS_KNL_TASK_H_ */
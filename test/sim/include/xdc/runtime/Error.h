@@ -0,0 +1,16 @@
+/*
+ * xdc/runtime/Error.h
+ *
+ * Host stand-in, creation never fails.
+ */
+
+#ifndef SIM_XDC_RUNTIME_ERROR_H_
+#define SIM_XDC_RUNTIME_ERROR_H_
+
+#include <xdc/std.h>
+
+typedef struct Error_Block Error_Block;
+
+#define Error_IGNORE                      ((Error_Block*) NULL)
+
+#endif /* SIM_XDC_RUNTIME_ERROR_H_ */
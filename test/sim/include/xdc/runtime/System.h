@@ -0,0 +1,12 @@
+/*
+ * xdc/runtime/System.h
+ *
+ * Host stand-in, nothing of it is used.
+ */
+
+#ifndef SIM_XDC_RUNTIME_SYSTEM_H_
+#define SIM_XDC_RUNTIME_SYSTEM_H_
+
+#include <xdc/std.h>
+
+#endif /* SIM_XDC_RUNTIME_SYSTEM_H_ */
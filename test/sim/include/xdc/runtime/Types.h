@@ -0,0 +1,12 @@
+/*
+ * xdc/runtime/Types.h
+ *
+ * Host stand-in, nothing of it is used.
+ */
+
+#ifndef SIM_XDC_RUNTIME_TYPES_H_
+#define SIM_XDC_RUNTIME_TYPES_H_
+
+#include <xdc/std.h>
+
+#endif /* SIM_XDC_RUNTIME_TYPES_H_ */
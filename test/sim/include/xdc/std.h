@@ -0,0 +1,23 @@
+/*
+ * xdc/std.h
+ *
+ * Host stand-in, types only.
+ */
+
+#ifndef SIM_XDC_STD_H_
+#define SIM_XDC_STD_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef uintptr_t UArg;
+typedef unsigned int UInt;
+typedef uint32_t UInt32;
+typedef int Int;
+typedef bool Bool;
+
+#define TRUE                              true
+#define FALSE                             false
+
+#endif /* SIM_XDC_STD_H_ */
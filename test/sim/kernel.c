@@ -0,0 +1,795 @@
+/*
+ * kernel.c
+ *
+ * Virtual time kernel of the simulator: the TI-RTOS calls the application
+ * makes (Task, Event, Semaphore, Clock) and the driver list. Each task
+ * runs as a coroutine, the highest-priority ready one runs, as on target.
+ * A task gives the scheduler control back when it blocks, or when a task
+ * of higher priority becomes ready: at a post from task code, or at a
+ * timer that falls due while the task is busy. A busy task advances time
+ * itself (simCharge() from the driver models), running whatever falls due
+ * meanwhile as interrupts would; if it is preempted, the rest of its busy
+ * time is spent after the other task blocks.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ucontext.h>
+
+#include <ti/sysbios/BIOS.h>
+#include <ti/sysbios/knl/Clock.h>
+#include <ti/sysbios/knl/Event.h>
+#include <ti/sysbios/knl/Semaphore.h>
+#include <ti/sysbios/knl/Task.h>
+#include <ti/drivers/utils/List.h>
+
+#include "sim.h"
+
+#define SIM_TIMER_NUM                     1024
+#define SIM_TASK_NUM                      4
+#define SIM_TASK_STACK_SIZE               (256 * 1024)
+
+SimConfig simConfig = {
+  .flashSize = 4096 * 4096,
+  .eraseUs = 45000,           // 4 KB erase typ. 45 ms, max 400 ms
+  .programUs = 700,           // typ. 0.7 ms, max 3 ms
+  .spiNsPerByte = 2000,       // 4 MHz
+  .spiCommandUs = 20,
+  .connIntervalUs = 15000,
+  .pdusPerEvent = 4,
+  .stackBuffers = 6,
+  .notifyUs = 100,
+};
+
+SimStats simStats = {
+  .i2sMinAhead = ~0u,
+};
+
+SimTime simNow;
+
+struct Event_Object
+{
+  UInt posted;
+};
+
+struct Semaphore_Object
+{
+  Int count;
+  Event_Handle event;
+  UInt eventId;
+  bool binary;
+};
+
+typedef struct SimTimer
+{
+  SimTime t;
+  uint32_t id;                // also breaks ties, fifo
+  SimFxn fxn;
+  void *arg;
+} SimTimer;
+
+/* binary heap on (t, id) */
+static SimTimer timers[SIM_TIMER_NUM];
+static int timerNum;
+static uint32_t timerSeq;
+
+typedef enum
+{
+  TASK_NONE,
+  TASK_READY,
+  TASK_RUNNING,
+  TASK_BLOCKED
+} TaskState;
+
+typedef struct SimTask
+{
+  TaskState state;
+  ucontext_t ctx;
+  Task_Struct *obj;
+  Int priority;
+  uint32_t timer;             // timeout, 0 if none
+  bool timedOut;
+  Event_Handle event;         // waited for, with mask
+  UInt mask;
+  Semaphore_Handle sem;
+} SimTask;
+
+static SimTask tasks[SIM_TASK_NUM];
+static int taskNum;
+static SimTask *cur;          // running task, NULL in scheduler context
+static ucontext_t sched;
+
+static bool inTask;           // task code runs, not a callback inside it
+static uint64_t stolen;       // scheduler context time owed by the task
+static bool poweredOff;
+
+static bool timerBefore(const SimTimer *a, const SimTimer *b)
+{
+  return a->t < b->t || (a->t == b->t && a->id < b->id);
+}
+
+static void timerSwap(int i, int j)
+{
+  SimTimer tmp = timers[i];
+  timers[i] = timers[j];
+  timers[j] = tmp;
+}
+
+static void siftUp(int i)
+{
+  while (i > 0 && timerBefore(&timers[i], &timers[(i - 1) / 2]))
+  {
+    timerSwap(i, (i - 1) / 2);
+    i = (i - 1) / 2;
+  }
+}
+
+static void siftDown(int i)
+{
+  for (;;)
+  {
+    int m = i, l = 2 * i + 1, r = 2 * i + 2;
+    if (l < timerNum && timerBefore(&timers[l], &timers[m]))
+      m = l;
+    if (r < timerNum && timerBefore(&timers[r], &timers[m]))
+      m = r;
+    if (m == i)
+      break;
+
+    timerSwap(i, m);
+    i = m;
+  }
+}
+
+uint32_t simAt(SimTime t, SimFxn fxn, void *arg)
+{
+  if (timerNum == SIM_TIMER_NUM)
+  {
+    fprintf(stderr, "sim: too many timers\n");
+    abort();
+  }
+
+  int i = timerNum++;
+  timers[i] = (SimTimer) { t < simNow ? simNow : t, ++timerSeq, fxn, arg };
+  siftUp(i);
+  return timerSeq;
+}
+
+void simCancel(uint32_t id)
+{
+  for (int i = 0; i < timerNum; i++)
+  {
+    if (timers[i].id == id)
+    {
+      timers[i] = timers[--timerNum];
+      if (i < timerNum)
+      {
+        siftUp(i);
+        siftDown(i);
+      }
+      return;
+    }
+  }
+}
+
+static SimTime timerNext(void)
+{
+  return timerNum ? timers[0].t : SIM_FOREVER;
+}
+
+/*
+ * Run the first timer, in scheduler context (interrupt or stack).
+ */
+static void dispatchOne(void)
+{
+  SimTimer tm = timers[0];
+  timers[0] = timers[--timerNum];
+  siftDown(0);
+
+  if (tm.t > simNow)
+  {
+    simNow = tm.t;
+  }
+
+  bool saved = inTask;
+  inTask = false;
+  tm.fxn(tm.arg);
+  inTask = saved;
+}
+
+static SimTask *highestReady(void)
+{
+  SimTask *best = NULL;
+  for (int i = 0; i < taskNum; i++)
+  {
+    if (tasks[i].state == TASK_READY
+        && (best == NULL || tasks[i].priority > best->priority))
+    {
+      best = &tasks[i];
+    }
+  }
+  return best;
+}
+
+/*
+ * Running task gives way to a ready task of higher priority, and goes on
+ * when that one blocks.
+ */
+static void preempt(void)
+{
+  SimTask *t = highestReady();
+  if (cur == NULL || poweredOff || t == NULL || t->priority <= cur->priority)
+    return;
+
+  SimTask *self = cur;
+  self->state = TASK_READY;
+  bool saved = inTask;
+  inTask = false;
+  swapcontext(&self->ctx, &sched);
+  inTask = saved;
+}
+
+/*
+ * Task is busy for us, interrupts and higher-priority tasks run meanwhile.
+ */
+static void busy(uint64_t us)
+{
+  SimTime end = simNow + us;
+  while (timerNext() <= end)
+  {
+    dispatchOne();
+
+    SimTime left = end - simNow;
+    preempt();
+    end = simNow + left;
+  }
+  simNow = end;
+}
+
+static void payStolen(void)
+{
+  while (stolen)
+  {
+    uint64_t us = stolen;
+    stolen = 0;
+    busy(us);
+  }
+}
+
+void simCharge(uint32_t us)
+{
+  if (inTask)
+  {
+    busy(us);
+    payStolen();
+  }
+  else
+  {
+    stolen += us;
+  }
+}
+
+bool simInTask(void)
+{
+  return inTask;
+}
+
+static void wake(SimTask *t)
+{
+  if (t->state == TASK_BLOCKED)
+  {
+    t->state = TASK_READY;
+    t->timedOut = false;
+    if (t->timer)
+    {
+      simCancel(t->timer);
+      t->timer = 0;
+    }
+  }
+}
+
+static void timeout(void *arg)
+{
+  SimTask *t = arg;
+
+  t->timer = 0;
+  if (t->state == TASK_BLOCKED)
+  {
+    t->state = TASK_READY;
+    t->timedOut = true;
+  }
+}
+
+/*
+ * Block the running task for timeout ticks, false if it ran out.
+ */
+static bool block(UInt32 ticks)
+{
+  if (!inTask)
+  {
+    fprintf(stderr, "sim: blocking call outside a task\n");
+    abort();
+  }
+
+  SimTask *self = cur;
+  self->timedOut = false;
+  self->timer = (ticks == BIOS_WAIT_FOREVER) ? 0 :
+      simAt(simNow + (SimTime) ticks * Clock_tickPeriod, timeout, self);
+  self->state = TASK_BLOCKED;
+
+  inTask = false;
+  swapcontext(&self->ctx, &sched);
+  inTask = true;
+  simStats.wakeups[self->priority & 7]++;
+
+  payStolen();
+  return !self->timedOut;
+}
+
+static void taskEntry(int i)
+{
+  SimTask *t = &tasks[i];
+  t->obj->fxn(t->obj->arg0, t->obj->arg1);
+  t->state = TASK_NONE;
+}
+
+/*
+ * One scheduling step no later than limit, false if there is none.
+ */
+static bool step(SimTime limit)
+{
+  if (poweredOff)
+    return false;
+
+  SimTask *t = highestReady();
+  if (t)
+  {
+    cur = t;
+    t->state = TASK_RUNNING;
+    inTask = true;
+    swapcontext(&sched, &t->ctx);
+    inTask = false;
+    cur = NULL;
+    return true;
+  }
+
+  if (timerNext() > limit)
+    return false;
+
+  dispatchOne();
+  return true;
+}
+
+void simRun(SimTime t)
+{
+  while (step(t))
+    ;
+
+  if (t != SIM_FOREVER && t > simNow && !poweredOff)
+  {
+    simNow = t;
+  }
+}
+
+void simRunFor(SimTime us)
+{
+  simRun(simNow + us);
+}
+
+bool simRunUntil(bool (*cond)(void), SimTime timeout)
+{
+  SimTime limit = simNow + timeout;
+  while (!cond())
+  {
+    if (!step(limit))
+      return false;
+  }
+  return true;
+}
+
+bool simIdle(void)
+{
+  for (int i = 0; i < taskNum; i++)
+  {
+    if (tasks[i].state == TASK_READY || tasks[i].state == TASK_RUNNING)
+      return false;
+  }
+  return true;
+}
+
+bool simPending(Event_Handle handle)
+{
+  for (int i = 0; i < taskNum; i++)
+  {
+    if (tasks[i].state == TASK_BLOCKED && tasks[i].event == handle)
+      return true;
+  }
+  return false;
+}
+
+/*
+ * Power_shutdown(): nothing runs any more, the calling task stays blocked.
+ */
+void simPowerOff(void)
+{
+  poweredOff = true;
+  if (inTask)
+  {
+    block(BIOS_WAIT_FOREVER);
+  }
+}
+
+bool simPoweredOff(void)
+{
+  return poweredOff;
+}
+
+/*
+ * Task
+ */
+void Task_Params_init(Task_Params *params)
+{
+  memset(params, 0, sizeof(*params));
+  params->priority = 1;
+}
+
+void Task_construct(Task_Struct *obj, Task_FuncPtr fxn,
+                    const Task_Params *params, Error_Block *eb)
+{
+  (void) eb;
+
+  if (taskNum == SIM_TASK_NUM)
+  {
+    fprintf(stderr, "sim: too many tasks\n");
+    abort();
+  }
+
+  obj->fxn = fxn;
+  obj->arg0 = params ? params->arg0 : 0;
+  obj->arg1 = params ? params->arg1 : 0;
+
+  SimTask *t = &tasks[taskNum];
+  t->obj = obj;
+  t->priority = params ? params->priority : 1;
+  getcontext(&t->ctx);
+  t->ctx.uc_stack.ss_sp = malloc(SIM_TASK_STACK_SIZE);
+  t->ctx.uc_stack.ss_size = SIM_TASK_STACK_SIZE;
+  t->ctx.uc_link = &sched;
+  makecontext(&t->ctx, (void (*)(void)) taskEntry, 1, taskNum);
+  t->state = TASK_READY;
+  taskNum++;
+}
+
+void Task_sleep(UInt32 ticks)
+{
+  block(ticks);
+}
+
+/*
+ * Clock, instances run their function in scheduler context (Swi).
+ */
+UInt32 Clock_getTicks(void)
+{
+  return (UInt32) (simNow / Clock_tickPeriod);
+}
+
+void Clock_Params_init(Clock_Params *params)
+{
+  memset(params, 0, sizeof(*params));
+}
+
+static void clockFire(void *arg)
+{
+  Clock_Handle handle = arg;
+
+  handle->timer = 0;
+  if (handle->period)
+  {
+    handle->timer = simAt(simNow + (SimTime) handle->period * Clock_tickPeriod,
+                          clockFire, handle);
+  }
+  else
+  {
+    handle->active = false;
+  }
+  handle->fxn(handle->arg);
+}
+
+void Clock_construct(Clock_Struct *obj, Clock_FuncPtr fxn, UInt32 timeout,
+                     const Clock_Params *params)
+{
+  memset(obj, 0, sizeof(*obj));
+  obj->fxn = fxn;
+  obj->timeout = timeout;
+  if (params)
+  {
+    obj->period = params->period;
+    obj->arg = params->arg;
+    if (params->startFlag)
+    {
+      Clock_start(obj);
+    }
+  }
+}
+
+void Clock_start(Clock_Handle handle)
+{
+  Clock_stop(handle);
+  handle->active = true;
+  handle->timer = simAt(simNow + (SimTime) handle->timeout * Clock_tickPeriod,
+                        clockFire, handle);
+}
+
+void Clock_stop(Clock_Handle handle)
+{
+  if (handle->timer)
+  {
+    simCancel(handle->timer);
+    handle->timer = 0;
+  }
+  handle->active = false;
+}
+
+Bool Clock_isActive(Clock_Handle handle)
+{
+  return handle->active;
+}
+
+void Clock_setTimeout(Clock_Handle handle, UInt32 timeout)
+{
+  handle->timeout = timeout;
+}
+
+void Clock_setPeriod(Clock_Handle handle, UInt32 period)
+{
+  handle->period = period;
+}
+
+/*
+ * Event
+ */
+Event_Handle Event_create(const Event_Params *params, Error_Block *eb)
+{
+  (void) params;
+  (void) eb;
+
+  return calloc(1, sizeof(struct Event_Object));
+}
+
+static void eventSet(Event_Handle handle, UInt eventMask)
+{
+  handle->posted |= eventMask;
+  for (int i = 0; i < taskNum; i++)
+  {
+    if (tasks[i].event == handle && (handle->posted & tasks[i].mask))
+    {
+      wake(&tasks[i]);
+    }
+  }
+}
+
+void Event_post(Event_Handle handle, UInt eventMask)
+{
+  eventSet(handle, eventMask);
+  if (inTask)
+  {
+    preempt();
+  }
+}
+
+UInt simEventPend(Event_Handle handle, UInt andMask, UInt orMask,
+                  UInt32 timeout)
+{
+  (void) andMask;
+
+  for (;;)
+  {
+    UInt m = handle->posted & orMask;
+    if (m)
+    {
+      handle->posted &= ~m;
+      return m;
+    }
+
+    if (timeout == BIOS_NO_WAIT)
+      return 0;
+
+    SimTask *self = cur;
+    self->event = handle;
+    self->mask = orMask;
+    bool ok = block(timeout);
+    self->event = NULL;
+
+    if (!ok)
+    {
+      m = handle->posted & orMask;
+      handle->posted &= ~m;
+      return m;
+    }
+  }
+}
+
+/*
+ * Semaphore
+ */
+static void semSync(Semaphore_Handle handle)
+{
+  if (handle->event == NULL)
+    return;
+
+  if (handle->count > 0)
+  {
+    eventSet(handle->event, handle->eventId);
+  }
+  else
+  {
+    handle->event->posted &= ~handle->eventId;
+  }
+}
+
+void Semaphore_Params_init(Semaphore_Params *params)
+{
+  memset(params, 0, sizeof(*params));
+  params->mode = Semaphore_Mode_COUNTING;
+}
+
+Semaphore_Handle Semaphore_create(Int count, const Semaphore_Params *params,
+                                  Error_Block *eb)
+{
+  (void) eb;
+
+  Semaphore_Handle handle = calloc(1, sizeof(struct Semaphore_Object));
+  handle->count = count;
+  if (params)
+  {
+    handle->event = params->event;
+    handle->eventId = params->eventId;
+    handle->binary = params->mode == Semaphore_Mode_BINARY;
+  }
+  semSync(handle);
+  return handle;
+}
+
+Bool Semaphore_pend(Semaphore_Handle handle, UInt32 timeout)
+{
+  for (;;)
+  {
+    if (handle->count > 0)
+    {
+      handle->count--;
+      semSync(handle);
+      return true;
+    }
+
+    if (timeout == BIOS_NO_WAIT)
+      return false;
+
+    SimTask *self = cur;
+    self->sem = handle;
+    bool ok = block(timeout);
+    self->sem = NULL;
+
+    if (!ok && handle->count == 0)
+      return false;
+  }
+}
+
+void Semaphore_post(Semaphore_Handle handle)
+{
+  if (!handle->binary || handle->count == 0)
+  {
+    handle->count++;
+  }
+  semSync(handle);
+
+  // highest priority waiter first
+  SimTask *t = NULL;
+  for (int i = 0; i < taskNum; i++)
+  {
+    if (tasks[i].sem == handle && tasks[i].state == TASK_BLOCKED
+        && (t == NULL || tasks[i].priority > t->priority))
+    {
+      t = &tasks[i];
+    }
+  }
+  if (t)
+  {
+    wake(t);
+  }
+
+  if (inTask)
+  {
+    preempt();
+  }
+}
+
+/*
+ * List, as ti/drivers/utils/List.c
+ */
+void List_clearList(List_List *list)
+{
+  list->head = list->tail = NULL;
+}
+
+List_Elem *List_get(List_List *list)
+{
+  List_Elem *elem = list->head;
+  if (elem != NULL)
+  {
+    list->head = elem->next;
+    if (elem->next != NULL)
+    {
+      elem->next->prev = NULL;
+    }
+    else
+    {
+      list->tail = NULL;
+    }
+  }
+  return elem;
+}
+
+void List_insert(List_List *list, List_Elem *newElem, List_Elem *curElem)
+{
+  newElem->next = curElem;
+  newElem->prev = curElem->prev;
+  if (curElem->prev != NULL)
+  {
+    curElem->prev->next = newElem;
+  }
+  else
+  {
+    list->head = newElem;
+  }
+  curElem->prev = newElem;
+}
+
+void List_put(List_List *list, List_Elem *elem)
+{
+  elem->next = NULL;
+  elem->prev = list->tail;
+  if (list->tail != NULL)
+  {
+    list->tail->next = elem;
+  }
+  else
+  {
+    list->head = elem;
+  }
+  list->tail = elem;
+}
+
+void List_putHead(List_List *list, List_Elem *elem)
+{
+  elem->next = list->head;
+  elem->prev = NULL;
+  if (list->head != NULL)
+  {
+    list->head->prev = elem;
+  }
+  else
+  {
+    list->tail = elem;
+  }
+  list->head = elem;
+}
+
+void List_remove(List_List *list, List_Elem *elem)
+{
+  if (elem->next != NULL)
+  {
+    elem->next->prev = elem->prev;
+  }
+  if (elem->prev != NULL)
+  {
+    elem->prev->next = elem->next;
+  }
+  if (list->head == elem)
+  {
+    list->head = elem->next;
+  }
+  if (list->tail == elem)
+  {
+    list->tail = elem->prev;
+  }
+}
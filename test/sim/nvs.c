@@ -0,0 +1,333 @@
+/*
+ * nvs.c
+ *
+ * SPI NOR flash model behind the NVS calls audio.c makes. Erase sets a
+ * 4096-byte sector to 0xff, program only clears bits and is done one page
+ * (256 bytes) at a time. Each call takes spi transfer time plus erase or
+ * program time, charged to whoever calls it (see simCharge()). Calls from
+ * tasks hold the driver lock for their whole time, as NVSSPI25X does: a
+ * reader of higher priority waits for the erase or program under way.
+ * Content changes when the call starts, which only the caller can tell.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include <ti/drivers/NVS.h>
+#include <ti/sysbios/BIOS.h>
+#include <ti/sysbios/knl/Semaphore.h>
+
+#include "sim.h"
+
+#define SIM_SECT_SIZE                     4096
+#define SIM_PAGE_SIZE                     256
+
+struct NVS_Config
+{
+  bool open;
+};
+
+uint8_t *simFlash;
+
+static struct NVS_Config nvs;
+
+static uint32_t failOp = ~0u;
+static uint32_t failSeed;
+static void (*failFxn)(void);
+static SimNvsTraceFxn traceFxn;
+static SimNvsReadFxn readFxn;
+static Semaphore_Handle lock;
+
+static void flashInit(void)
+{
+  if (simFlash)
+    return;
+
+  simFlash = mmap(NULL, simConfig.flashSize, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (simFlash == MAP_FAILED)
+  {
+    perror("sim: flash");
+    exit(2);
+  }
+  memset(simFlash, 0xff, simConfig.flashSize);
+}
+
+void simNvsReset(void)
+{
+  flashInit();
+  memset(simFlash, 0xff, simConfig.flashSize);
+}
+
+static uint32_t failRand(void)
+{
+  failSeed ^= failSeed << 13;
+  failSeed ^= failSeed >> 17;
+  failSeed ^= failSeed << 5;
+  return failSeed;
+}
+
+static void failDefault(void)
+{
+  _exit(0);
+}
+
+void simNvsFail(uint32_t op, uint32_t seed, void (*fxn)(void))
+{
+  failOp = op;
+  failSeed = seed ? seed : 1;
+  failFxn = fxn ? fxn : failDefault;
+}
+
+void simNvsTrace(SimNvsTraceFxn fxn)
+{
+  traceFxn = fxn;
+}
+
+void simNvsReadTrace(SimNvsReadFxn fxn)
+{
+  readFxn = fxn;
+}
+
+/* outside tasks (tests, benches) there is no one to wait for */
+static void nvsLock(void)
+{
+  if (!simInTask())
+    return;
+
+  if (lock == NULL)
+  {
+    Semaphore_Params params;
+    Semaphore_Params_init(&params);
+    params.mode = Semaphore_Mode_BINARY;
+    lock = Semaphore_create(1, &params, Error_IGNORE);
+  }
+  Semaphore_pend(lock, BIOS_WAIT_FOREVER);
+}
+
+static void nvsUnlock(void)
+{
+  if (simInTask())
+  {
+    Semaphore_post(lock);
+  }
+}
+
+static uint32_t transferUs(size_t n)
+{
+  return simConfig.spiCommandUs
+      + (uint32_t) ((n * simConfig.spiNsPerByte + 999) / 1000);
+}
+
+static void charge(uint32_t us)
+{
+  simStats.nvsBusyUs += us;
+  simCharge(us);
+}
+
+static bool inRegion(size_t offset, size_t size)
+{
+  if (offset + size > simConfig.flashSize || offset + size < offset)
+  {
+    fprintf(stderr, "sim: nvs access out of region, %zu + %zu\n", offset,
+            size);
+    abort();
+  }
+  return true;
+}
+
+/*
+ * Count a mutating op, and tear it if power is to fail here.
+ */
+static bool opFails(size_t offset, size_t size, bool erase)
+{
+  if (traceFxn)
+  {
+    traceFxn(simStats.nvsOps, offset, size, erase);
+  }
+  return simStats.nvsOps++ == failOp;
+}
+
+static void program(size_t offset, const uint8_t *src, size_t n)
+{
+  if (opFails(offset, n, false))
+  {
+    size_t k = failRand() % (n + 1);
+    for (size_t i = 0; i < k; i++)
+    {
+      simFlash[offset + i] &= src[i];
+    }
+    if (k < n)
+    {
+      simFlash[offset + k] &= src[k] | (uint8_t) failRand();
+    }
+    failFxn();
+  }
+
+  for (size_t i = 0; i < n; i++)
+  {
+    simFlash[offset + i] &= src[i];
+  }
+}
+
+static void eraseSector(size_t offset)
+{
+  if (opFails(offset, SIM_SECT_SIZE, true))
+  {
+    for (size_t i = 0; i < SIM_SECT_SIZE; i++)
+    {
+      uint32_t r = failRand();
+      simFlash[offset + i] |= (r & 0x100) ? 0xff : (uint8_t) r;
+    }
+    failFxn();
+  }
+
+  memset(&simFlash[offset], 0xff, SIM_SECT_SIZE);
+}
+
+void NVS_Params_init(NVS_Params *params)
+{
+  params->custom = NULL;
+}
+
+NVS_Handle NVS_open(unsigned int index, NVS_Params *params)
+{
+  (void) index;
+  (void) params;
+
+  flashInit();
+  nvs.open = true;
+  return &nvs;
+}
+
+void NVS_getAttrs(NVS_Handle handle, NVS_Attrs *attrs)
+{
+  (void) handle;
+
+  attrs->regionBase = NULL;
+  attrs->regionSize = simConfig.flashSize;
+  attrs->sectorSize = SIM_SECT_SIZE;
+}
+
+int_fast16_t NVS_read(NVS_Handle handle, size_t offset, void *buffer,
+                      size_t bufferSize)
+{
+  (void) handle;
+
+  inRegion(offset, bufferSize);
+  nvsLock();
+  memcpy(buffer, &simFlash[offset], bufferSize);
+
+  simStats.nvsReads++;
+  simStats.nvsReadBytes += bufferSize;
+  if (readFxn)
+  {
+    readFxn(offset, bufferSize);
+  }
+
+  uint32_t us = transferUs(bufferSize);
+  if (us > simStats.nvsMaxOpUs)
+  {
+    simStats.nvsMaxOpUs = us;
+  }
+  charge(us);
+  nvsUnlock();
+  return NVS_STATUS_SUCCESS;
+}
+
+static uint32_t erase(size_t offset, size_t size)
+{
+  uint32_t total = 0;
+  for (size_t s = 0; s < size; s += SIM_SECT_SIZE)
+  {
+    eraseSector(offset + s);
+    simStats.nvsErases++;
+
+    uint32_t us = simConfig.spiCommandUs + simConfig.eraseUs;
+    total += us;
+    charge(us);
+  }
+  return total;
+}
+
+int_fast16_t NVS_erase(NVS_Handle handle, size_t offset, size_t size)
+{
+  (void) handle;
+
+  if (offset % SIM_SECT_SIZE || size % SIM_SECT_SIZE)
+    return NVS_STATUS_INV_OFFSET;
+
+  inRegion(offset, size);
+
+  nvsLock();
+  uint32_t total = erase(offset, size);
+  nvsUnlock();
+
+  if (total > simStats.nvsMaxOpUs)
+  {
+    simStats.nvsMaxOpUs = total;
+  }
+  return NVS_STATUS_SUCCESS;
+}
+
+/*
+ * Page by page, as the driver splits a write. Verify reads back.
+ */
+int_fast16_t NVS_write(NVS_Handle handle, size_t offset, void *buffer,
+                       size_t bufferSize, unsigned int flags)
+{
+  const uint8_t *src = buffer;
+  uint32_t total = 0;
+
+  (void) handle;
+
+  inRegion(offset, bufferSize);
+  nvsLock();
+
+  if (flags & NVS_WRITE_ERASE)
+  {
+    size_t first = offset / SIM_SECT_SIZE * SIM_SECT_SIZE;
+    size_t last = (offset + bufferSize + SIM_SECT_SIZE - 1) / SIM_SECT_SIZE
+        * SIM_SECT_SIZE;
+    total += erase(first, last - first);
+  }
+
+  for (size_t done = 0; done < bufferSize;)
+  {
+    size_t n = SIM_PAGE_SIZE - (offset + done) % SIM_PAGE_SIZE;
+    if (n > bufferSize - done)
+    {
+      n = bufferSize - done;
+    }
+
+    program(offset + done, src + done, n);
+    simStats.nvsPages++;
+
+    uint32_t us = transferUs(n) + simConfig.programUs;
+    total += us;
+    charge(us);
+    done += n;
+  }
+
+  int_fast16_t status = NVS_STATUS_SUCCESS;
+  if (flags & NVS_WRITE_POST_VERIFY)
+  {
+    uint32_t us = transferUs(bufferSize);
+    total += us;
+    charge(us);
+
+    if (memcmp(&simFlash[offset], src, bufferSize) != 0)
+    {
+      status = NVS_STATUS_ERROR;
+    }
+  }
+  nvsUnlock();
+
+  if (total > simStats.nvsMaxOpUs)
+  {
+    simStats.nvsMaxOpUs = total;
+  }
+  return status;
+}
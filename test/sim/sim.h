@@ -0,0 +1,183 @@
+/*
+ * sim.h
+ *
+ * Discrete-event host simulator of the recorder. The application of the
+ * firmware (Application/audio.c, simple_peripheral.c, button.c, util.c
+ * and PROFILES/simple_gatt_profile.c) is compiled unmodified against the
+ * stand-in headers in sim/include; its three tasks run at their priorities
+ * on virtual time (kernel.c), against models of
+ *
+ *   - the SPI NOR flash (nvs.c): erase and page program latency, program
+ *     only clears bits, and power-fail injection,
+ *   - the I2S microphone (i2s.c): one buffer per period on the transaction
+ *     queue, and an error when the queue runs empty,
+ *   - the ble stack (stack.c): ICall messages, the GATT server, stack
+ *     buffers, connection events and their reports, and a client that
+ *     gets the notifications and writes commands,
+ *   - the board (board.c): main.c, the power button and shutdown.
+ *
+ * What the stack and the drivers do runs in scheduler context (timed
+ * callbacks), as interrupts and the stack task would; its cpu time is
+ * charged to the task that runs next.
+ */
+
+#ifndef TEST_SIM_H_
+#define TEST_SIM_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "audio.h"
+
+typedef uint64_t SimTime;               // us
+
+#define SIM_MS                            ((SimTime) 1000)
+#define SIM_S                             ((SimTime) 1000000)
+#define SIM_FOREVER                       (~(SimTime) 0)
+
+typedef struct SimConfig
+{
+  /* flash, defaults are a 128 Mbit part (CC2640R2DK_5MM) at 4 MHz spi */
+  uint32_t flashSize;                   // bytes, 4096-byte sectors
+  uint32_t eraseUs;                     // sector erase
+  uint32_t programUs;                   // page program, after transfer
+  uint32_t spiNsPerByte;
+  uint32_t spiCommandUs;                // per command, incl. driver
+
+  /* link */
+  uint32_t connIntervalUs;
+  uint32_t pdusPerEvent;                // notifications per connection event
+  uint32_t stackBuffers;                // MAX_NUM_PDU
+  uint32_t notifyUs;                    // ble task cpu per notification
+  bool noConnEvtReports;                // Gap_RegisterConnEventCb() fails
+} SimConfig;
+
+typedef struct SimStats
+{
+  uint32_t i2sBuffers;                  // periods completed
+  uint32_t i2sErrors;                   // queue ran empty, driver stopped
+  uint32_t i2sMinAhead;                 // fewest buffers queued behind dma
+  uint32_t i2sMaxBacklog;               // most buffers waiting for the task
+
+  uint32_t nvsReads;
+  uint64_t nvsReadBytes;
+  uint32_t nvsPages;                    // page programs
+  uint32_t nvsErases;
+  uint32_t nvsOps;                      // programs and erases, see simNvsFail
+  uint64_t nvsBusyUs;                   // charged to the audio task
+  uint32_t nvsMaxOpUs;                  // longest single call
+
+  uint32_t notifications;
+  uint64_t notifyBytes;
+  uint32_t notifyAllocFails;            // stack buffers exhausted
+  uint32_t connEvents;
+  uint32_t connEventsShort;             // room for more, nothing queued
+  uint32_t icallBadFrees;               // freed with the other ICall call
+
+  uint32_t wakeups[8];                  // blocked task ran again, by priority
+} SimStats;
+
+extern SimConfig simConfig;
+extern SimStats simStats;
+extern SimTime simNow;
+
+/*
+ * Kernel (kernel.c)
+ */
+typedef void (*SimFxn)(void *arg);
+
+/* run fxn(arg) at time t in scheduler context, returns an id for cancel */
+uint32_t simAt(SimTime t, SimFxn fxn, void *arg);
+void simCancel(uint32_t id);
+
+/* advance virtual time to t, running the task and everything due */
+void simRun(SimTime t);
+void simRunFor(SimTime us);
+
+/* run until cond() holds, checked after each step, false on timeout */
+bool simRunUntil(bool (*cond)(void), SimTime timeout);
+
+/* time taken by the code running now, see sim.h header */
+void simCharge(uint32_t us);
+
+bool simInTask(void);                   // task code runs, not a callback
+bool simIdle(void);                     // no task ready
+bool simPending(Event_Handle handle);   // a task waits for handle
+
+/* Power_shutdown(), nothing runs after it */
+void simPowerOff(void);
+bool simPoweredOff(void);
+
+/*
+ * Flash (nvs.c). Content lives in a shared mapping, so that a forked
+ * child's writes survive it, see simNvsFail.
+ */
+extern uint8_t *simFlash;
+
+void simNvsReset(void);                 // all blank
+
+/*
+ * Power fails during mutating op number op (counted in simStats.nvsOps from
+ * 0): a program is torn after a random number of bytes, an erase leaves
+ * random bytes. Then fxn is called, which must not return; default is
+ * _exit(0).
+ */
+void simNvsFail(uint32_t op, uint32_t seed, void (*fxn)(void));
+
+/*
+ * fxn is called at the start of each mutating op (one page program or one
+ * sector erase), with the op number simNvsFail counts.
+ */
+typedef void (*SimNvsTraceFxn)(uint32_t op, size_t offset, size_t size,
+                               bool erase);
+
+void simNvsTrace(SimNvsTraceFxn fxn);
+
+/* fxn is called at each NVS_read(), before its time is charged */
+typedef void (*SimNvsReadFxn)(size_t offset, size_t size);
+
+void simNvsReadTrace(SimNvsReadFxn fxn);
+
+/*
+ * Microphone (i2s.c), source fills n samples at each period, default is
+ * silence.
+ */
+typedef void (*SimSourceFxn)(int16_t *pcm, size_t n, void *arg);
+
+void simI2sSource(SimSourceFxn fxn, void *arg);
+bool simI2sRunning(void);
+
+/*
+ * Link (stack.c). The client gets each notification at the connection
+ * event it goes out in. simConnect() sets up the link at mtu and the
+ * client subscribes two connection intervals later; simWrite() writes an
+ * attribute by its (16-bit, or bytes 12 and 13 of the 128-bit) uuid and
+ * returns the att status; simCommand() writes msg to characteristic 1 as
+ * the client would.
+ */
+typedef void (*SimClientFxn)(const uint8_t *pkt, size_t len);
+
+void simClient(SimClientFxn fxn);
+void simConnect(uint16_t mtu);
+void simDisconnect(void);
+uint8_t simWrite(uint16_t uuid, const void *value, size_t len);
+void simCommand(const IncomingMsg_t *msg);
+bool simBleUp(void);                    // advertising or connected
+
+/*
+ * Board (board.c). Power on: flash is allocated blank on first use, the
+ * tasks are created as main() does, and the button is held down until
+ * button.c takes it for a long press; runs until the ble task advertises
+ * and the audio task waits for events. Once per process, firmware state
+ * lives in statics; fork() for another boot on the same flash.
+ */
+void simBoot(void);
+
+/* power on with a double click, runs until the microphone runs */
+void simBootRecording(void);
+
+/* button down at time at for ms */
+void simButton(SimTime at, SimTime ms);
+
+#endif /* TEST_SIM_H_ */
@@ -0,0 +1,658 @@
+/*
+ * stack.c
+ *
+ * The ble stack under simple_peripheral.c and simple_gatt_profile.c: ICall
+ * messages to the ble task, the GATT server's attribute table and write
+ * callbacks, notification buffers (GATT_bm_alloc()), connection events
+ * and their reports, and the client on the other end of the link.
+ *
+ * What the stack task does runs in scheduler context (timed callbacks);
+ * what the application does runs in its tasks and is charged to them. A
+ * notification reaches the client at a later connection event, at most
+ * pdusPerEvent per event, and its buffer is free again after that event.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <icall.h>
+#include <icall_ble_api.h>
+#include <ti/sysbios/knl/Event.h>
+
+#include "simple_gatt_profile.h"
+#include "sim.h"
+
+#define SIM_STACK_BUFFERS_MAX             32
+#define SIM_CONN_HANDLE                   0
+#define SIM_APP_ENTITY                    1
+#define SIM_ATTR_TABLES                   4
+#define SIM_ATTR_VALUE_MAX                512
+
+#define ICALL_TAG_MSG                     0x4d534721u
+#define ICALL_TAG_MALLOC                  0x4d414c21u
+
+/* GATT declaration uuids */
+CONST uint8 primaryServiceUUID[ATT_BT_UUID_SIZE] = { 0x00, 0x28 };
+CONST uint8 characterUUID[ATT_BT_UUID_SIZE] = { 0x03, 0x28 };
+CONST uint8 clientCharCfgUUID[ATT_BT_UUID_SIZE] = { 0x02, 0x29 };
+CONST uint8 charUserDescUUID[ATT_BT_UUID_SIZE] = { 0x01, 0x29 };
+
+/* ICall_allocMsg() and ICall_malloc() blocks */
+typedef struct Block
+{
+  List_Elem elem;                       // app queue, messages only
+  uint32_t tag;
+  _Alignas(max_align_t) uint8_t data[];
+} Block_t;
+
+typedef struct StackBuffer
+{
+  uint8_t data[BADPCM_V2_MAX_SIZE + 4];
+  size_t len;
+  bool used;
+} StackBuffer_t;
+
+static ICall_SyncHandle appEvent;
+static List_List appMsgs;
+
+static struct
+{
+  gattAttribute_t *attrs;
+  uint16 num;
+  CONST gattServiceCBs_t *cbs;
+} tables[SIM_ATTR_TABLES];
+static int tableNum;
+static uint16 nextHandle = 1;
+
+static StackBuffer_t buffers[SIM_STACK_BUFFERS_MAX];
+static StackBuffer_t *tx[SIM_STACK_BUFFERS_MAX];   // sent, in order
+static uint32_t txHead;
+static uint32_t txCount;
+
+static bool advertising;
+static pfnGapCB_t advCb;
+static uint32_t advMask;
+
+static bool connected;
+static uint16_t mtu = ATT_MTU_SIZE;
+static uint32_t connTimer;
+static uint16_t connEvents;
+static pfnGapConnEvtCB_t connEvtCb;
+static SimClientFxn clientFxn;
+
+/*
+ * ICall
+ */
+static Block_t *blockOf(void *p)
+{
+  return (Block_t*) ((uint8_t*) p - offsetof(Block_t, data));
+}
+
+static void *blockAlloc(size_t size, uint32_t tag)
+{
+  Block_t *b = calloc(1, sizeof(Block_t) + size);
+  b->tag = tag;
+  return b->data;
+}
+
+static void blockFree(void *p, uint32_t tag)
+{
+  if (p == NULL)
+    return;
+
+  Block_t *b = blockOf(p);
+  if (b->tag != tag)
+  {
+    simStats.icallBadFrees++;
+  }
+  b->tag = 0;
+  free(b);
+}
+
+ICall_Errno ICall_registerApp(ICall_EntityID *entity,
+                              ICall_SyncHandle *msgSyncHdl)
+{
+  appEvent = Event_create(NULL, Error_IGNORE);
+  List_clearList(&appMsgs);
+  *entity = SIM_APP_ENTITY;
+  *msgSyncHdl = appEvent;
+  return ICALL_ERRNO_SUCCESS;
+}
+
+void *ICall_allocMsg(size_t size)
+{
+  return blockAlloc(size, ICALL_TAG_MSG);
+}
+
+void ICall_freeMsg(void *msg)
+{
+  blockFree(msg, ICALL_TAG_MSG);
+}
+
+void *ICall_malloc(uint_least16_t size)
+{
+  return blockAlloc(size, ICALL_TAG_MALLOC);
+}
+
+void ICall_free(void *msg)
+{
+  blockFree(msg, ICALL_TAG_MALLOC);
+}
+
+/* one message per fetch, the event stays posted while more wait */
+ICall_Errno ICall_fetchServiceMsg(ICall_ServiceEnum *src,
+                                  ICall_EntityID *dest, void **msg)
+{
+  List_Elem *elem = List_get(&appMsgs);
+  if (elem == NULL)
+    return ICALL_ERRNO_NOMSG;
+
+  if (!List_empty(&appMsgs))
+  {
+    Event_post(appEvent, ICALL_MSG_EVENT_ID);
+  }
+
+  *src = ICALL_SERVICE_CLASS_BLE;
+  *dest = SIM_APP_ENTITY;
+  *msg = ((Block_t*) elem)->data;
+  return ICALL_ERRNO_SUCCESS;
+}
+
+static void *stackMsg(size_t size, uint8 event)
+{
+  osal_event_hdr_t *hdr = ICall_allocMsg(size);
+  hdr->event = event;
+  hdr->status = SUCCESS;
+  return hdr;
+}
+
+static void sendMsg(void *msg)
+{
+  if (appEvent == NULL)
+  {
+    ICall_freeMsg(msg);
+    return;
+  }
+
+  List_put(&appMsgs, &blockOf(msg)->elem);
+  Event_post(appEvent, ICALL_MSG_EVENT_ID);
+}
+
+/*
+ * HCI, GAP
+ */
+bStatus_t HCI_LE_WriteSuggestedDefaultDataLenCmd(uint16 txOctets,
+                                                 uint16 txTime)
+{
+  (void) txOctets;
+  (void) txTime;
+  return SUCCESS;
+}
+
+bStatus_t GAP_DeviceInit(uint8 profileRole, uint8 taskID,
+                         GAP_Addr_Modes_t addrMode, uint8 *pRandomAddr)
+{
+  (void) profileRole;
+  (void) taskID;
+  (void) addrMode;
+  (void) pRandomAddr;
+
+  gapDeviceInitDoneEvent_t *evt = stackMsg(sizeof(*evt), GAP_MSG_EVENT);
+  evt->opcode = GAP_DEVICE_INIT_DONE_EVENT;
+  evt->dataPktLen = 251;
+  evt->numDataPkts = (uint8) simConfig.stackBuffers;
+  sendMsg(evt);
+  return SUCCESS;
+}
+
+bStatus_t GAP_SetParamValue(uint16 paramID, uint16 paramValue)
+{
+  (void) paramID;
+  (void) paramValue;
+  return SUCCESS;
+}
+
+void GAP_RegisterForMsgs(uint8 taskID)
+{
+  (void) taskID;
+}
+
+uint8 linkDB_NumActive(void)
+{
+  return connected ? 1 : 0;
+}
+
+static void advEvent(void *arg)
+{
+  uint32_t event = (uint32_t) (uintptr_t) arg;
+  if (advCb && (advMask & event))
+  {
+    advCb(event, ICall_malloc(sizeof(uint8)), 0);
+  }
+}
+
+bStatus_t GapAdv_create(pfnGapCB_t cb, GapAdv_params_t *advParam,
+                        uint8 *advHandle)
+{
+  (void) advParam;
+
+  advCb = cb;
+  *advHandle = 0;
+  return SUCCESS;
+}
+
+bStatus_t GapAdv_loadByHandle(uint8 handle, GapAdv_dataTypes_t dataType,
+                              uint16 len, uint8 *pBuf)
+{
+  (void) handle;
+  (void) dataType;
+  (void) len;
+  (void) pBuf;
+  return SUCCESS;
+}
+
+bStatus_t GapAdv_setEventMask(uint8 handle, uint32_t mask)
+{
+  (void) handle;
+
+  advMask = mask;
+  return SUCCESS;
+}
+
+bStatus_t GapAdv_enable(uint8 handle, GapAdv_enableOptions_t enableOptions,
+                        uint16 durationOrMaxEvents)
+{
+  (void) handle;
+  (void) enableOptions;
+  (void) durationOrMaxEvents;
+
+  if (!advertising && !connected)
+  {
+    advertising = true;
+    simAt(simNow, advEvent, (void*) (uintptr_t) GAP_EVT_ADV_START_AFTER_ENABLE);
+  }
+  return SUCCESS;
+}
+
+bStatus_t Gap_RegisterConnEventCb(pfnGapConnEvtCB_t cb,
+                                  GAP_CB_Action_t action, uint16_t connHandle)
+{
+  if (!connected || connHandle != SIM_CONN_HANDLE)
+    return bleNotConnected;
+  if (simConfig.noConnEvtReports)
+    return bleIncorrectMode;
+
+  connEvtCb = action == GAP_CB_REGISTER ? cb : NULL;
+  return SUCCESS;
+}
+
+/*
+ * GATT server
+ */
+void GATT_RegisterForMsgs(uint8 taskId)
+{
+  (void) taskId;
+}
+
+bStatus_t GATT_InitClient(void)
+{
+  return SUCCESS;
+}
+
+bStatus_t GGS_SetParameter(uint8 param, uint8 len, void *value)
+{
+  (void) param;
+  (void) len;
+  (void) value;
+  return SUCCESS;
+}
+
+bStatus_t GGS_AddService(uint32 services)
+{
+  (void) services;
+  return SUCCESS;
+}
+
+bStatus_t GATTServApp_AddService(uint32 services)
+{
+  (void) services;
+  return SUCCESS;
+}
+
+bStatus_t GATTServApp_RegisterService(gattAttribute_t *pAttrs,
+                                      uint16 numAttrs, uint8 encKeySize,
+                                      CONST gattServiceCBs_t *pServiceCBs)
+{
+  (void) encKeySize;
+
+  if (tableNum == SIM_ATTR_TABLES)
+    return bleNoResources;
+
+  for (uint16 i = 0; i < numAttrs; i++)
+  {
+    pAttrs[i].handle = nextHandle++;
+  }
+
+  tables[tableNum].attrs = pAttrs;
+  tables[tableNum].num = numAttrs;
+  tables[tableNum].cbs = pServiceCBs;
+  tableNum++;
+  return SUCCESS;
+}
+
+void GATTServApp_InitCharCfg(uint16 connHandle, gattCharCfg_t *charCfgTbl)
+{
+  for (int i = 0; i < MAX_NUM_BLE_CONNS; i++)
+  {
+    if (connHandle == CONNHANDLE_INVALID
+        || charCfgTbl[i].connHandle == connHandle)
+    {
+      charCfgTbl[i].connHandle = CONNHANDLE_INVALID;
+      charCfgTbl[i].value = GATT_CFG_NO_OPERATION;
+    }
+  }
+}
+
+bStatus_t GATTServApp_ProcessCCCWriteReq(uint16 connHandle,
+                                         gattAttribute_t *pAttr,
+                                         uint8 *pValue, uint16 len,
+                                         uint16 offset, uint16 validCfg)
+{
+  if (offset != 0)
+    return ATT_ERR_ATTR_NOT_LONG;
+  if (len != 2)
+    return ATT_ERR_INVALID_VALUE_SIZE;
+
+  uint16 value = BUILD_UINT16(pValue[0], pValue[1]);
+  if (value != GATT_CFG_NO_OPERATION && value != validCfg)
+    return ATT_ERR_INVALID_VALUE;
+
+  gattCharCfg_t *tbl = *(gattCharCfg_t**) pAttr->pValue;
+  tbl[0].connHandle = connHandle;
+  tbl[0].value = (uint8) value;
+  return SUCCESS;
+}
+
+/* by 16-bit uuid, or bytes 12 and 13 of a 128-bit one */
+static bool findAttr(uint16_t uuid, gattAttribute_t **attr,
+                     CONST gattServiceCBs_t **cbs)
+{
+  for (int t = 0; t < tableNum; t++)
+  {
+    for (uint16 i = 0; i < tables[t].num; i++)
+    {
+      gattAttribute_t *a = &tables[t].attrs[i];
+      uint16 u = a->type.len == ATT_UUID_SIZE ?
+          BUILD_UINT16(a->type.uuid[12], a->type.uuid[13]) :
+          BUILD_UINT16(a->type.uuid[0], a->type.uuid[1]);
+      if (u == uuid)
+      {
+        *attr = a;
+        *cbs = tables[t].cbs;
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+uint8_t simWrite(uint16_t uuid, const void *value, size_t len)
+{
+  gattAttribute_t *attr;
+  CONST gattServiceCBs_t *cbs;
+  if (!connected || !findAttr(uuid, &attr, &cbs))
+    return ATT_ERR_INVALID_HANDLE;
+
+  uint8 buf[SIM_ATTR_VALUE_MAX];
+  if (len > sizeof(buf) || len > (size_t) mtu - 3)
+    return ATT_ERR_INVALID_VALUE_SIZE;
+
+  memcpy(buf, value, len);
+  return cbs->pfnWriteAttrCB(SIM_CONN_HANDLE, attr, buf, (uint16) len, 0, 0);
+}
+
+/*
+ * Notifications
+ */
+static uint32_t bufferMax(void)
+{
+  return simConfig.stackBuffers < SIM_STACK_BUFFERS_MAX ?
+      simConfig.stackBuffers : SIM_STACK_BUFFERS_MAX;
+}
+
+void *GATT_bm_alloc(uint16 connHandle, uint8 opcode, uint16 size,
+                    uint16 *pSizeAlloc)
+{
+  (void) connHandle;
+  (void) opcode;
+
+  uint32_t used = 0;
+  StackBuffer_t *free = NULL;
+  for (uint32_t i = 0; i < SIM_STACK_BUFFERS_MAX; i++)
+  {
+    if (buffers[i].used)
+    {
+      used++;
+    }
+    else if (free == NULL)
+    {
+      free = &buffers[i];
+    }
+  }
+
+  if (used >= bufferMax())
+  {
+    simStats.notifyAllocFails++;
+    return NULL;
+  }
+
+  free->used = true;
+  free->len = size < mtu - 3 ? size : mtu - 3;
+  *pSizeAlloc = (uint16) free->len;
+  return free->data;
+}
+
+static StackBuffer_t *bufferOf(const uint8 *p)
+{
+  return (StackBuffer_t*) (p - offsetof(StackBuffer_t, data));
+}
+
+void GATT_bm_free(gattMsg_t *pMsg, uint8 opcode)
+{
+  if (opcode == ATT_HANDLE_VALUE_NOTI && pMsg->handleValueNoti.pValue)
+  {
+    bufferOf(pMsg->handleValueNoti.pValue)->used = false;
+    pMsg->handleValueNoti.pValue = NULL;
+  }
+}
+
+bStatus_t GATT_Notification(uint16 connHandle, attHandleValueNoti_t *pNoti,
+                            uint8 authenticated)
+{
+  (void) authenticated;
+
+  if (!connected || connHandle != SIM_CONN_HANDLE)
+    return bleNotConnected;
+
+  StackBuffer_t *buf = bufferOf(pNoti->pValue);
+  buf->len = pNoti->len;
+  tx[(txHead + txCount) % SIM_STACK_BUFFERS_MAX] = buf;
+  txCount++;
+
+  simStats.notifications++;
+  simStats.notifyBytes += pNoti->len;
+  simCharge(simConfig.notifyUs);
+  return SUCCESS;
+}
+
+/*
+ * Link
+ */
+static void connEvent(void *arg)
+{
+  (void) arg;
+
+  if (!connected)
+    return;
+
+  uint16_t sent = 0;
+  for (; sent < simConfig.pdusPerEvent && txCount > 0; sent++)
+  {
+    StackBuffer_t *buf = tx[txHead];
+    txHead = (txHead + 1) % SIM_STACK_BUFFERS_MAX;
+    txCount--;
+
+    if (clientFxn)
+    {
+      clientFxn(buf->data, buf->len);
+    }
+    buf->used = false;
+  }
+
+  simStats.connEvents++;
+  if (sent < simConfig.pdusPerEvent)
+  {
+    simStats.connEventsShort++;
+  }
+  if (connEvtCb)
+  {
+    Gap_ConnEventRpt_t *rpt = ICall_malloc(sizeof(Gap_ConnEventRpt_t));
+    rpt->status = GAP_CONN_EVT_STAT_SUCCESS;
+    rpt->handle = SIM_CONN_HANDLE;
+    rpt->packets = sent;
+    rpt->eventCounter = connEvents;
+    rpt->timeStamp = (uint32_t) simNow;
+    connEvtCb(rpt);
+  }
+  connEvents++;
+
+  connTimer = simAt(simNow + simConfig.connIntervalUs, connEvent, NULL);
+}
+
+/* the client turns notifications on, once the link is set up */
+static void subscribe(void *arg)
+{
+  (void) arg;
+
+  uint8_t ccc[2] = { LO_UINT16(GATT_CLIENT_CFG_NOTIFY),
+                     HI_UINT16(GATT_CLIENT_CFG_NOTIFY) };
+  uint8_t status = simWrite(GATT_CLIENT_CHAR_CFG_UUID, ccc, sizeof(ccc));
+  if (status != SUCCESS)
+  {
+    fprintf(stderr, "sim: subscribe failed, status %02x\n", status);
+  }
+}
+
+bool simBleUp(void)
+{
+  return advertising || connected;
+}
+
+void simClient(SimClientFxn fxn)
+{
+  clientFxn = fxn;
+}
+
+void simConnect(uint16_t newMtu)
+{
+  if (connected)
+    return;
+
+  connected = true;
+  advertising = false;
+  mtu = newMtu;
+  connEvents = 0;
+
+  gapEstLinkReqEvent_t *est = stackMsg(sizeof(*est), GAP_MSG_EVENT);
+  est->opcode = GAP_LINK_ESTABLISHED_EVENT;
+  est->connectionHandle = SIM_CONN_HANDLE;
+  est->connInterval = (uint16) (simConfig.connIntervalUs / 1250);
+  sendMsg(est);
+
+  gattMsgEvent_t *evt = stackMsg(sizeof(*evt), GATT_MSG_EVENT);
+  evt->connHandle = SIM_CONN_HANDLE;
+  evt->method = ATT_MTU_UPDATED_EVENT;
+  evt->msg.mtuEvt.MTU = mtu;
+  sendMsg(evt);
+
+  connTimer = simAt(simNow + simConfig.connIntervalUs, connEvent, NULL);
+  simAt(simNow + 2 * simConfig.connIntervalUs, subscribe, NULL);
+}
+
+void simDisconnect(void)
+{
+  if (!connected)
+    return;
+
+  connected = false;
+  simCancel(connTimer);
+  connEvtCb = NULL;
+  mtu = ATT_MTU_SIZE;
+
+  // what was not sent is lost with the link
+  while (txCount > 0)
+  {
+    tx[txHead]->used = false;
+    txHead = (txHead + 1) % SIM_STACK_BUFFERS_MAX;
+    txCount--;
+  }
+
+  gapTerminateLinkEvent_t *term = stackMsg(sizeof(*term), GAP_MSG_EVENT);
+  term->opcode = GAP_LINK_TERMINATED_EVENT;
+  term->connectionHandle = SIM_CONN_HANDLE;
+  term->reason = 0x08;                  // supervision timeout
+  sendMsg(term);
+}
+
+/*
+ * As the client writes a command to characteristic 1, in the length the
+ * profile takes for it.
+ */
+void simCommand(const IncomingMsg_t *msg)
+{
+  uint8_t buf[1 + READ_RANGES_MAX * 8];
+  size_t len = 1;
+
+  buf[0] = (uint8_t) msg->type;
+  if (msg->type == IMT_START_READ_MULTI)
+  {
+    memcpy(&buf[1], msg->ranges, msg->count * 8);
+    len = 1 + msg->count * 8;
+  }
+  else if (msg->type == IMT_GRANT
+           || (msg->type == IMT_LIST_RECS && msg->start != 0))
+  {
+    memcpy(&buf[1], &msg->start, 4);
+    len = 5;
+  }
+  else if ((msg->type == IMT_START_READ || msg->type == IMT_START_READ_V2)
+           && (msg->startMinor || msg->endMinor))
+  {
+    memcpy(&buf[1], &msg->start, 4);
+    memcpy(&buf[5], &msg->startMinor, 4);
+    memcpy(&buf[9], &msg->end, 4);
+    memcpy(&buf[13], &msg->endMinor, 4);
+    len = 17;
+  }
+  else if (msg->type == IMT_ACK && msg->range != ACK_RANGE_CURRENT)
+  {
+    memcpy(&buf[1], &msg->start, 4);
+    memcpy(&buf[5], &msg->end, 4);
+    buf[9] = (uint8_t) msg->range;
+    len = 10;
+  }
+  else if (msg->type == IMT_ACK || msg->type == IMT_START_READ
+           || msg->type == IMT_START_READ_V2)
+  {
+    memcpy(&buf[1], &msg->start, 4);
+    memcpy(&buf[5], &msg->end, 4);
+    len = 9;
+  }
+
+  uint8_t status = simWrite(SIMPLEPROFILE_CHAR1_UUID, buf, len);
+  if (status != SUCCESS)
+  {
+    fprintf(stderr, "sim: command %u refused, status %02x\n",
+            (unsigned) msg->type, status);
+  }
+}
@@ -0,0 +1,139 @@
+/*
+ * snr_adpcm.c
+ *
+ * SNR against size for the 4-bit and 3-bit codecs, as stored by the
+ * firmware: 4000 data bytes per sector, 4-bit packs 2 samples per byte,
+ * 3-bit packs 424 samples per 160-byte chunk (last byte pad).
+ *
+ *   snr_adpcm [file.wav ...]
+ *
+ * Without arguments the generated speech-like signal is used, at 16 kHz
+ * and 8 kHz. Wav files must be 16-bit PCM; the first channel is used.
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "adpcm.h"
+#include "corpus.h"
+
+#define SECT_DATA_SIZE                    4000
+#define CHUNK_SIZE                        160
+#define CHUNK_SAMPLES_3                   (CHUNK_SIZE / 3 * 8)
+#define SEG_MS                            20
+#define SEG_MIN_RMS                       100.0   // skip pauses in segsnr
+
+typedef struct Snr
+{
+  double snr;           // dB over the whole signal
+  double segsnr;        // dB, mean over voiced 20 ms segments
+} Snr_t;
+
+static Snr_t measure(const int16_t *ref, const int16_t *dec, size_t n,
+                     uint32_t rate)
+{
+  Snr_t r;
+  double sig = 0, err = 0, seg = 0;
+  size_t segs = 0;
+  size_t len = rate * SEG_MS / 1000;
+
+  for (size_t base = 0; base + len <= n; base += len)
+  {
+    double s = 0, e = 0;
+    for (size_t i = base; i < base + len; i++)
+    {
+      double d = (double) ref[i] - dec[i];
+      s += (double) ref[i] * ref[i];
+      e += d * d;
+    }
+    sig += s;
+    err += e;
+
+    if (sqrt(s / len) >= SEG_MIN_RMS)
+    {
+      double db = 10 * log10(s / (e + 1e-9));
+      db = db > 60 ? 60 : (db < -10 ? -10 : db);   // usual segsnr limits
+      seg += db;
+      segs++;
+    }
+  }
+
+  r.snr = 10 * log10(sig / (err + 1e-9));
+  r.segsnr = segs ? seg / segs : 0;
+  return r;
+}
+
+static void report(const char *name, const int16_t *pcm, size_t n,
+                   uint32_t rate)
+{
+  int16_t *dec = malloc(n * sizeof(int16_t));
+  uint8_t *codes = malloc(n);
+  AdpcmState_t st;
+  Snr_t s4, s3;
+
+  st = (AdpcmState_t) { 0, 0, 0 };
+  adpcmEncodeBlock(pcm, n, codes, &st);
+  st = (AdpcmState_t) { 0, 0, 0 };
+  adpcmDecodeBlock(codes, n, dec, &st);
+  s4 = measure(pcm, dec, n, rate);
+
+  /* chunk by chunk, as recorded */
+  AdpcmState_t enc = { 0, 0, 0 }, d = { 0, 0, 0 };
+  for (size_t base = 0; base < n; base += CHUNK_SAMPLES_3)
+  {
+    size_t k = n - base < CHUNK_SAMPLES_3 ? n - base : CHUNK_SAMPLES_3;
+    adpcm3EncodeBlock(&pcm[base], k, codes, &enc);
+    adpcm3DecodeBlock(codes, k, &dec[base], &d);
+  }
+  s3 = measure(pcm, dec, n, rate);
+
+  double sect4 = SECT_DATA_SIZE * 2.0 / rate;
+  double sect3 = SECT_DATA_SIZE / CHUNK_SIZE * CHUNK_SAMPLES_3 / (double) rate;
+
+  printf("%s, %u Hz, %.1f s\n", name, rate, (double) n / rate);
+  printf("  %-6s %9s %9s %12s %14s\n", "codec", "snr dB", "segsnr dB",
+         "s/sector", "ble bytes/s");
+  printf("  %-6s %9.2f %9.2f %12.3f %14.0f\n", "4-bit", s4.snr, s4.segsnr,
+         sect4, SECT_DATA_SIZE / sect4);
+  printf("  %-6s %9.2f %9.2f %12.3f %14.0f\n", "3-bit", s3.snr, s3.segsnr,
+         sect3, SECT_DATA_SIZE / sect3);
+  printf("  3-bit: %.1f%% less flash and transfer, %.2f dB snr\n",
+         100 * (1 - sect4 / sect3), s3.snr - s4.snr);
+
+  free(dec);
+  free(codes);
+}
+
+int main(int argc, char *argv[])
+{
+  if (argc < 2)
+  {
+    static const uint32_t rates[] = { 16000, 8000 };
+    for (int r = 0; r < 2; r++)
+    {
+      size_t n = rates[r] * 60;
+      int16_t *pcm = malloc(n * sizeof(int16_t));
+      corpusFill(CORPUS_SPEECH, pcm, n, rates[r], 1);
+      report("generated speech", pcm, n, rates[r]);
+      free(pcm);
+    }
+    return 0;
+  }
+
+  for (int i = 1; i < argc; i++)
+  {
+    size_t n;
+    uint32_t rate;
+    int16_t *pcm = corpusLoadWav(argv[i], &n, &rate);
+
+    if (!pcm)
+    {
+      fprintf(stderr, "%s: not a 16-bit pcm wav\n", argv[i]);
+      return 1;
+    }
+    report(argv[i], pcm, n, rate);
+    free(pcm);
+  }
+
+  return 0;
+}
@@ -0,0 +1,343 @@
+/*
+ * test_adpcm.c
+ *
+ * Host bit-exactness tests for the codec in Application/adpcm.c. The
+ * per-sample adpcmEncoder() / adpcmDecoder() are the reference.
+ */
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "adpcm.h"
+#include "check.h"
+#include "corpus.h"
+
+CHECK_DEFINE;
+
+#define CORPUS_SAMPLES                    (16000 * 10)
+#define RANDOM_STEPS                      4000000
+#define PCM_FRAME                         80      // PCM_SAMPLES_PER_BUF
+#define BADPCM_SAMPLES_4                  320     // one 160-byte packet
+
+static int16_t pcm[CORPUS_SAMPLES];
+static int16_t out[CORPUS_SAMPLES];
+static uint8_t refCodes[CORPUS_SAMPLES];     // odd blocks take a byte more
+static uint8_t blockCodes[CORPUS_SAMPLES];
+
+/* block sizes, firmware frame first, odd sizes leave a half byte */
+static const size_t blockSizes[] = { PCM_FRAME, 1, 7, 160, 4000, 33 };
+
+#define BLOCK_SIZE_NUM (sizeof(blockSizes) / sizeof(blockSizes[0]))
+
+/* initial states, including both clamps and both ends of the index */
+static const AdpcmState_t initStates[] = {
+  { 0, 0, 0 },
+  { 0, 88, 0 },
+  { 32767, 44, 0 },
+  { -32767, 60, 0 },
+  { -32768, 88, 0 },
+  { 1234, 17, 0 },
+};
+
+#define INIT_STATE_NUM (sizeof(initStates) / sizeof(initStates[0]))
+
+/*
+ * adpcmEncoderFast() against adpcmEncoder(), code and state after every
+ * sample, over the corpus from several initial states, and over random
+ * (sample, state) pairs.
+ */
+static void testEncoderFast(void)
+{
+  for (int kind = 0; kind < CORPUS_KIND_NUM; kind++)
+  {
+    corpusFill(kind, pcm, CORPUS_SAMPLES, 16000, 1 + kind);
+
+    for (size_t s = 0; s < INIT_STATE_NUM; s++)
+    {
+      int16_t refSample = initStates[s].sample;
+      uint8_t refIndex = initStates[s].index;
+      int16_t fastSample = refSample;
+      uint8_t fastIndex = refIndex;
+
+      for (size_t i = 0; i < CORPUS_SAMPLES; i++)
+      {
+        char ref = adpcmEncoder(pcm[i], &refSample, &refIndex);
+        char fast = adpcmEncoderFast(pcm[i], &fastSample, &fastIndex);
+
+        if (ref != fast || refSample != fastSample || refIndex != fastIndex)
+        {
+          CHECK(0, "%s init %zu sample %zu: code %d/%d state %d,%u/%d,%u",
+                corpusName(kind), s, i, ref, fast, refSample, refIndex,
+                fastSample, fastIndex);
+          break;
+        }
+      }
+    }
+  }
+
+  uint32_t seed = 12345;
+  for (int i = 0; i < RANDOM_STEPS; i++)
+  {
+    uint32_t r = corpusRand(&seed);
+    int16_t sample = (int16_t) corpusRand(&seed);
+    int16_t refSample = (int16_t) r;
+    uint8_t refIndex = (r >> 16) % 89;
+    int16_t fastSample = refSample;
+    uint8_t fastIndex = refIndex;
+
+    char ref = adpcmEncoder(sample, &refSample, &refIndex);
+    char fast = adpcmEncoderFast(sample, &fastSample, &fastIndex);
+
+    if (ref != fast || refSample != fastSample || refIndex != fastIndex)
+    {
+      CHECK(0, "random step %d: sample %d from %d,%u: code %d/%d", i, sample,
+            (int16_t) r, (unsigned) ((r >> 16) % 89), ref, fast);
+      break;
+    }
+  }
+}
+
+static bool sameState(const AdpcmState_t *a, const AdpcmState_t *b)
+{
+  return a->sample == b->sample && a->index == b->index;
+}
+
+/*
+ * Encode pcm with per-sample adpcmEncoder(), packing two codes per byte the
+ * same way as the firmware did before the block api. Each block of size
+ * samples starts on a new byte.
+ */
+static void encodeReference(const int16_t *in, size_t n, size_t size,
+                            uint8_t *codes, AdpcmState_t *st)
+{
+  int16_t sample = st->sample;
+  uint8_t index = st->index;
+
+  memset(codes, 0, n);
+
+  for (size_t base = 0, byte = 0; base < n; base += size)
+  {
+    size_t k = n - base < size ? n - base : size;
+    for (size_t i = 0; i < k; i++)
+    {
+      uint8_t code = adpcmEncoder(in[base + i], &sample, &index);
+      codes[byte + i / 2] |= (i & 1) ? code << 4 : code;
+    }
+    byte += (k + 1) / 2;
+  }
+
+  st->sample = sample;
+  st->index = index;
+}
+
+/*
+ * adpcmEncodeBlock() and adpcmDecodeBlock() against the per-sample
+ * functions: bytes, decoded samples and the state after each block.
+ */
+static void testBlock(void)
+{
+  for (int kind = 0; kind < CORPUS_KIND_NUM; kind++)
+  {
+    corpusFill(kind, pcm, CORPUS_SAMPLES, 16000, 1 + kind);
+
+    for (size_t s = 0; s < INIT_STATE_NUM; s++)
+    {
+      for (size_t b = 0; b < BLOCK_SIZE_NUM; b++)
+      {
+        size_t size = blockSizes[b];
+        AdpcmState_t ref = initStates[s];
+        AdpcmState_t st = initStates[s];
+        size_t byte = 0;
+        bool ok = true;
+
+        encodeReference(pcm, CORPUS_SAMPLES, size, refCodes, &ref);
+
+        memset(blockCodes, 0, sizeof(blockCodes));
+        for (size_t base = 0; base < CORPUS_SAMPLES; base += size)
+        {
+          size_t k = CORPUS_SAMPLES - base < size ? CORPUS_SAMPLES - base : size;
+          adpcmEncodeBlock(&pcm[base], k, &blockCodes[byte], &st);
+          byte += (k + 1) / 2;
+        }
+
+        ok = !memcmp(refCodes, blockCodes, byte) && sameState(&ref, &st);
+        CHECK(ok, "encode %s init %zu block %zu", corpusName(kind), s, size);
+
+        /* decode the same codes both ways */
+        int16_t refSample = initStates[s].sample;
+        uint8_t refIndex = initStates[s].index;
+        AdpcmState_t dst = initStates[s];
+        byte = 0;
+        for (size_t base = 0; base < CORPUS_SAMPLES && ok; base += size)
+        {
+          size_t k = CORPUS_SAMPLES - base < size ? CORPUS_SAMPLES - base : size;
+
+          adpcmDecodeBlock(&blockCodes[byte], k, &out[base], &dst);
+          for (size_t i = 0; i < k; i++)
+          {
+            uint8_t x = blockCodes[byte + i / 2];
+            int16_t y = adpcmDecoder((i & 1) ? x >> 4 : x & 0x0f,
+                                     &refSample, &refIndex);
+            if (y != out[base + i])
+            {
+              ok = false;
+              break;
+            }
+          }
+
+          ok = ok && refSample == dst.sample && refIndex == dst.index;
+          byte += (k + 1) / 2;
+        }
+        CHECK(ok, "decode %s init %zu block %zu", corpusName(kind), s, size);
+      }
+    }
+  }
+}
+
+/*
+ * adpcmAdvanceState() against decoding with adpcmDecoder(), packet by
+ * packet (160 bytes, 320 samples, as in the read loop), over random code
+ * bytes and over encoded corpus signals, from several initial states.
+ */
+static void checkAdvance(const uint8_t *codes, size_t n, AdpcmState_t init,
+                         const char *name)
+{
+  AdpcmState_t st = init;
+  int16_t sample = init.sample;
+  uint8_t index = init.index;
+
+  for (size_t base = 0; base + BADPCM_SAMPLES_4 <= n; base += BADPCM_SAMPLES_4)
+  {
+    const uint8_t *packet = &codes[base / 2];
+
+    for (size_t i = 0; i < BADPCM_SAMPLES_4; i += 2)
+    {
+      adpcmDecoder(packet[i / 2] & 0x0f, &sample, &index);
+      adpcmDecoder(packet[i / 2] >> 4, &sample, &index);
+    }
+    adpcmAdvanceState(packet, BADPCM_SAMPLES_4, &st);
+
+    if (st.sample != sample || st.index != index)
+    {
+      CHECK(0, "%s: packet at %zu: %d,%u vs %d,%u", name, base, st.sample,
+            st.index, sample, index);
+      return;
+    }
+  }
+}
+
+static void testAdvance(void)
+{
+  uint32_t seed = 777;
+
+  for (size_t i = 0; i < CORPUS_SAMPLES / 2; i++)
+  {
+    blockCodes[i] = (uint8_t) corpusRand(&seed);
+  }
+
+  for (size_t s = 0; s < INIT_STATE_NUM; s++)
+  {
+    checkAdvance(blockCodes, CORPUS_SAMPLES, initStates[s], "random");
+  }
+
+  for (int kind = 0; kind < CORPUS_KIND_NUM; kind++)
+  {
+    corpusFill(kind, pcm, CORPUS_SAMPLES, 16000, 1 + kind);
+
+    for (size_t s = 0; s < INIT_STATE_NUM; s++)
+    {
+      AdpcmState_t st = initStates[s];
+      adpcmEncodeBlock(pcm, CORPUS_SAMPLES, blockCodes, &st);
+      checkAdvance(blockCodes, CORPUS_SAMPLES, initStates[s], corpusName(kind));
+    }
+  }
+
+  /* random state, single random packet */
+  for (int i = 0; i < 100000; i++)
+  {
+    AdpcmState_t init;
+    uint32_t r = corpusRand(&seed);
+
+    init.sample = (int16_t) r;
+    init.index = (r >> 16) % 89;
+    init.format = 0;
+    for (size_t j = 0; j < BADPCM_SAMPLES_4 / 2; j++)
+    {
+      blockCodes[j] = (uint8_t) corpusRand(&seed);
+    }
+    checkAdvance(blockCodes, BADPCM_SAMPLES_4, init, "random state");
+  }
+}
+
+/*
+ * 3-bit round trip. The encoder's state after every sample must be the
+ * state the decoder reconstructs from the codes, otherwise states written
+ * to sector headers and states advanced by adpcm3AdvanceState() (seek,
+ * read) drift apart. Then block decode and state advance are checked
+ * against each other per packet (424 samples) and per frame (80), which
+ * leaves partial 3-byte groups.
+ */
+static void testAdpcm3(void)
+{
+  static const size_t sizes[] = { 424, PCM_FRAME, 1, 13 };
+
+  for (int kind = 0; kind < CORPUS_KIND_NUM; kind++)
+  {
+    corpusFill(kind, pcm, CORPUS_SAMPLES, 16000, 1 + kind);
+
+    for (size_t s = 0; s < INIT_STATE_NUM; s++)
+    {
+      AdpcmState_t enc = initStates[s];
+      AdpcmState_t dec = initStates[s];
+
+      for (size_t i = 0; i < CORPUS_SAMPLES; i++)
+      {
+        uint8_t code;
+        int16_t y;
+
+        adpcm3EncodeBlock(&pcm[i], 1, &code, &enc);
+        adpcm3DecodeBlock(&code, 1, &y, &dec);
+
+        if (!sameState(&enc, &dec) || y != enc.sample)
+        {
+          CHECK(0, "%s init %zu sample %zu: encoder %d,%u decoder %d,%u",
+                corpusName(kind), s, i, enc.sample, enc.index, dec.sample,
+                dec.index);
+          break;
+        }
+      }
+
+      for (size_t b = 0; b < sizeof(sizes) / sizeof(sizes[0]); b++)
+      {
+        size_t size = sizes[b];
+        AdpcmState_t st = initStates[s];
+        AdpcmState_t dst = initStates[s];
+        AdpcmState_t ast = initStates[s];
+        bool ok = true;
+
+        for (size_t base = 0; base < CORPUS_SAMPLES && ok; base += size)
+        {
+          size_t k = CORPUS_SAMPLES - base < size ? CORPUS_SAMPLES - base : size;
+
+          adpcm3EncodeBlock(&pcm[base], k, blockCodes, &st);
+          adpcm3DecodeBlock(blockCodes, k, &out[base], &dst);
+          adpcm3AdvanceState(blockCodes, k, &ast);
+
+          ok = sameState(&st, &dst) && sameState(&st, &ast)
+              && out[base + k - 1] == st.sample;
+        }
+        CHECK(ok, "adpcm3 %s init %zu block %zu", corpusName(kind), s, size);
+      }
+    }
+  }
+}
+
+int main(void)
+{
+  testEncoderFast();
+  testBlock();
+  testAdvance();
+  testAdpcm3();
+
+  return checkResult("test_adpcm");
+}
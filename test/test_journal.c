@@ -0,0 +1,412 @@
+/*
+ * test_journal.c
+ *
+ * Recording journal on the simulator (sim/). The journal sectors (and the
+ * monotonic counter) are written directly into the flash model in the
+ * layout audio.h documents, each boot is a fork()ed child on that flash,
+ * and the client reads the journal back with LIST_RECS pages:
+ *
+ *   - mount keeps valid sectors in seq order, stops a sector at a torn or
+ *     bad entry, and erases sectors without a complete header, with stray
+ *     bits, and the sources of a completed compaction, or an unfinished
+ *     compaction copy;
+ *   - an append that needs a sector with none to spare erases a sector of
+ *     dead entries (recordings overwritten in the data area), compacts the
+ *     live entries of the oldest sectors into one, or, all live and full,
+ *     drops the oldest;
+ *   - power failing at each flash op of the stop that compacts leaves the
+ *     journal as before, as after compaction, or with the new entry too.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "check.h"
+#include "sim.h"
+
+CHECK_DEFINE;
+
+#define FLASH_SECTORS                     4096
+#define SECT_SIZE                         4096
+#define DATA_SECTORS                      (FLASH_SECTORS - 16)
+#define JOURNAL_SECTS                     12
+#define PER_SECT                          (SECT_SIZE / sizeof(RecEntry_t) - 1)
+#define COUNTER_MAGIC                     0x58D5BD30  // MAGIC in audio.c
+#define MAX_ENTRIES                       (JOURNAL_SECTS * PER_SECT)
+
+#define JOURNAL_OFFSET(s)                 ((size_t) (FLASH_SECTORS - 16 + (s)) * SECT_SIZE)
+
+/* written by the children */
+typedef struct Shared
+{
+  RecEntry_t got[MAX_ENTRIES + 1];
+  uint32_t count;
+  uint32_t total;                       // of the first page
+  uint32_t stopOps;                     // nvsOps when stop was sent
+  uint32_t ops;
+} Shared_t;
+
+static Shared_t *shared;
+static uint32_t pages;
+static uint32_t pageCount;
+
+static void clientFxn(const uint8_t *pkt, size_t len)
+{
+  if (len >= RECS_HEADER_SIZE && pkt[0] == BADPCM_RECS)
+  {
+    RecsPacket_t page;
+    memcpy(&page, pkt, len);
+    for (uint32_t k = 0; k < page.count && shared->count <= MAX_ENTRIES; k++)
+    {
+      shared->got[shared->count++] = page.entries[k];
+    }
+    if (pages == 0)
+    {
+      shared->total = page.total;
+    }
+    pageCount = page.count;
+    pages++;
+  }
+}
+
+static uint32_t pagesSeen;
+
+static bool pageArrived(void)
+{
+  return pages != pagesSeen;
+}
+
+static void command(uint32_t type, uint32_t start)
+{
+  IncomingMsg_t msg = { .type = type, .start = start };
+  simCommand(&msg);
+}
+
+/* every page, from the start */
+static void listAll(void)
+{
+  uint32_t from = 0;
+
+  shared->count = 0;
+  pages = 0;
+  for (;;)
+  {
+    pagesSeen = pages;
+    command(IMT_LIST_RECS, from);
+    if (!simRunUntil(pageArrived, SIM_S) || pageCount == 0)
+      break;
+    from = shared->got[shared->count - 1].end;
+  }
+}
+
+static void boot(void)
+{
+  simClient(clientFxn);
+  simBoot();
+  simConnect(247);
+  simRunFor(100 * SIM_MS);
+}
+
+static void listOnly(void)
+{
+  boot();
+  listAll();
+}
+
+/* a short recording, its stop appends */
+static void session(void)
+{
+  boot();
+  command(IMT_START_REC, 0);
+  simRunFor(1200 * SIM_MS);
+  shared->stopOps = simStats.nvsOps;
+  command(IMT_STOP_REC, 0);
+  simRunFor(500 * SIM_MS);
+  shared->ops = simStats.nvsOps;
+  listAll();
+}
+
+/* runs fxn in a child, false if it did not exit cleanly */
+static bool child(void (*fxn)(void), uint32_t failOp, uint32_t seed)
+{
+  fflush(stdout);
+  pid_t pid = fork();
+  if (pid == 0)
+  {
+    if (failOp != ~0u)
+    {
+      simNvsFail(failOp, seed, NULL);
+    }
+    fxn();
+    fflush(stdout);
+    _exit(checkFailures ? 1 : 0);
+  }
+
+  int status = 1;
+  waitpid(pid, &status, 0);
+  return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+/*
+ * Flash with the monotonic counter at n (it is written every few sectors,
+ * so no data sector needs to be complete), nothing else.
+ */
+static void flashAt(uint32_t n)
+{
+  simNvsReset();
+
+  uint8_t *hi = &simFlash[(size_t) (FLASH_SECTORS - 1) * SECT_SIZE];
+  uint8_t *lo = &simFlash[(size_t) (FLASH_SECTORS - 2) * SECT_SIZE];
+  uint32_t magic = COUNTER_MAGIC;
+
+  hi[0] = 0x3f;                         // two bits, no carry pending
+  memcpy(&hi[2048], &magic, sizeof(magic));
+  memset(lo, 0, (n + 1) / 8);
+  lo[(n + 1) / 8] = 0xff >> ((n + 1) % 8);
+}
+
+static RecEntry_t entry(uint32_t start, uint32_t len)
+{
+  RecEntry_t e = { .start = start, .end = start + len, .flags = 0,
+                   .uptime = start / 2 };
+  e.flags |= (uint32_t) recEntryCheck(&e) << REC_FLAGS_CHECK_SHIFT;
+  return e;
+}
+
+static void writeSector(int s, uint32_t seq, uint32_t seqEnd, bool done,
+                        const RecEntry_t *e, uint32_t n)
+{
+  JournalHeader_t hdr = { JOURNAL_MAGIC, seq, seqEnd, done ? 0 : 0xffffffff };
+  uint8_t *p = &simFlash[JOURNAL_OFFSET(s)];
+
+  memset(p, 0xff, SECT_SIZE);
+  memcpy(p, &hdr, sizeof(hdr));
+  memcpy(p + sizeof(RecEntry_t), e, n * sizeof(RecEntry_t));
+}
+
+static bool sectorBlank(int s)
+{
+  const uint8_t *p = &simFlash[JOURNAL_OFFSET(s)];
+  for (size_t i = 0; i < SECT_SIZE; i++)
+  {
+    if (p[i] != 0xff)
+      return false;
+  }
+  return true;
+}
+
+/* what the last child listed, against n expected entries and maybe more */
+static bool listed(const RecEntry_t *e, uint32_t n, uint32_t extra)
+{
+  if (shared->count != n + extra || shared->total != n + extra)
+    return false;
+  for (uint32_t k = 0; k < n; k++)
+  {
+    if (shared->got[k].start != e[k].start || shared->got[k].end != e[k].end
+        || shared->got[k].uptime != e[k].uptime)
+      return false;
+  }
+  return true;
+}
+
+static RecEntry_t e[MAX_ENTRIES];
+
+/*
+ * Mount: torn entry, sectors out of physical order, a closed newest one
+ * (stray bits after its entries), garbage, an incomplete header, a stray
+ * byte in a blank sector.
+ */
+static void mount(void)
+{
+  for (uint32_t k = 0; k < 16; k++)
+  {
+    e[k] = entry(10 + 3 * k, 2);
+  }
+
+  flashAt(1000);
+  writeSector(0, 0, 0, true, &e[0], 5);
+  RecEntry_t torn = e[5];
+  memset((uint8_t*) &torn + 7, 0xff, sizeof(torn) - 7);
+  memcpy(&simFlash[JOURNAL_OFFSET(0) + 6 * sizeof(RecEntry_t)], &torn,
+         sizeof(torn));
+  writeSector(2, 1, 1, true, &e[5], 3);
+  writeSector(1, 2, 2, true, &e[8], 4);
+  simFlash[JOURNAL_OFFSET(1) + SECT_SIZE - 1] = 0x7f;
+  for (size_t i = 0; i < SECT_SIZE; i++)
+  {
+    simFlash[JOURNAL_OFFSET(3) + i] = (uint8_t) (i * 131 + 7);
+  }
+  writeSector(4, 3, 3, false, &e[12], 2);
+  simFlash[JOURNAL_OFFSET(5) + 1000] = 0xfe;
+
+  CHECK(child(session, ~0u, 0), "mount: session");
+  CHECK(listed(e, 12, 1), "mount: %u entries listed, total %u, expected 12 "
+        "and the new one", shared->count, shared->total);
+  CHECK(shared->got[12].start == 1000, "mount: new entry starts at %u",
+        shared->got[12].start);
+  CHECK(sectorBlank(4) && sectorBlank(5), "mount: bad sectors not erased");
+
+  RecEntry_t last = shared->got[12];
+  CHECK(child(listOnly, ~0u, 0), "mount: second boot");
+  CHECK(listed(e, 12, 1) && shared->got[12].start == last.start
+        && shared->got[12].end == last.end, "mount: second boot lists %u",
+        shared->count);
+
+  // a completed compaction of seq 0 and 1, its sources still there
+  flashAt(1000);
+  writeSector(0, 0, 0, true, &e[0], 5);
+  writeSector(1, 1, 1, true, &e[5], 5);
+  writeSector(7, 0, 1, true, &e[3], 7);
+  CHECK(child(listOnly, ~0u, 0), "compacted: boot");
+  CHECK(listed(&e[3], 7, 0), "compacted: %u entries listed, expected 7",
+        shared->count);
+  CHECK(sectorBlank(0) && sectorBlank(1), "compacted: sources not erased");
+
+  // the same copy, not done
+  flashAt(1000);
+  writeSector(0, 0, 0, true, &e[0], 5);
+  writeSector(1, 1, 1, true, &e[5], 5);
+  writeSector(7, 0, 1, false, &e[3], 7);
+  CHECK(child(listOnly, ~0u, 0), "unfinished copy: boot");
+  CHECK(listed(e, 10, 0), "unfinished copy: %u entries listed, expected 10",
+        shared->count);
+  CHECK(sectorBlank(7), "unfinished copy not erased");
+
+  printf("test_journal: mount, torn entry, bad sectors, compaction copies\n");
+}
+
+/*
+ * Eleven sectors in use (seq 0-10, at 0-10), the last one full: fills[]
+ * entries each, e[] in order.
+ */
+static uint32_t writeJournal(const uint32_t *fills)
+{
+  uint32_t n = 0;
+  for (int s = 0; s < JOURNAL_SECTS - 1; s++)
+  {
+    writeSector(s, s, s, true, &e[n], fills[s]);
+    n += fills[s];
+  }
+  return n;
+}
+
+#define COUNTER                           10000
+#define HORIZON                           (COUNTER - DATA_SECTORS)  // about
+
+/*
+ * n one-sector entries from start, back to back.
+ */
+static void entries(uint32_t from, uint32_t n, uint32_t start)
+{
+  for (uint32_t k = 0; k < n; k++)
+  {
+    e[from + k] = entry(start + k, 1);
+  }
+}
+
+static const uint32_t fullFills[] = {
+  255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255 };
+
+/* 200 entries in the oldest, 100 of them dead, and 50 in the next */
+static const uint32_t mergeFills[] = {
+  200, 50, 255, 255, 255, 255, 255, 255, 255, 255, 255 };
+
+static uint32_t mergeJournal(void)
+{
+  flashAt(COUNTER);
+  entries(0, 100, HORIZON - 1000);
+  entries(100, 2445, HORIZON + 100);
+  return writeJournal(mergeFills);
+}
+
+static void reclaim(void)
+{
+  // oldest all dead: erased
+  flashAt(COUNTER);
+  entries(0, 255, HORIZON - 2000);
+  entries(255, 2550, COUNTER - 2550 - 10);
+  uint32_t n = writeJournal(fullFills);
+  CHECK(child(session, ~0u, 0), "dead: session");
+  CHECK(listed(&e[255], n - 255, 1), "dead: %u entries listed, total %u, "
+        "expected %u", shared->count, shared->total, n - 255 + 1);
+  uint32_t deadOps = shared->ops - shared->stopOps;
+
+  // live ones of the oldest two fit in one: compacted
+  n = mergeJournal();
+  CHECK(child(session, ~0u, 0), "merge: session");
+  CHECK(listed(&e[100], n - 100, 1), "merge: %u entries listed, total %u, "
+        "expected %u", shared->count, shared->total, n - 100 + 1);
+  uint32_t mergeOps = shared->ops - shared->stopOps;
+  CHECK(child(listOnly, ~0u, 0), "merge: second boot");
+  CHECK(listed(&e[100], n - 100, 1), "merge: second boot lists %u",
+        shared->count);
+
+  // all live, all full: oldest dropped
+  flashAt(COUNTER);
+  entries(0, 2805, HORIZON + 50);
+  n = writeJournal(fullFills);
+  CHECK(child(session, ~0u, 0), "full: session");
+  CHECK(listed(&e[255], n - 255, 1), "full: %u entries listed, total %u, "
+        "expected %u", shared->count, shared->total, n - 255 + 1);
+
+  printf("test_journal: reclaim, flash ops at stop: %u dead sector erased, "
+         "%u compacting 100 + 50 live entries\n", deadOps, mergeOps);
+}
+
+/*
+ * Power fails at each flash op from the stop that compacts; the next boot
+ * lists the journal before, after compaction, or with the new entry.
+ */
+static void powerFail(void)
+{
+  uint32_t n = mergeJournal();
+  CHECK(child(session, ~0u, 0), "reference session");
+  uint32_t from = shared->stopOps;
+  uint32_t to = shared->ops;
+  RecEntry_t last = shared->got[shared->count - 1];
+
+  uint32_t before = 0, compacted = 0, appended = 0;
+  for (uint32_t k = from; k < to && checkFailures == 0; k++)
+  {
+    mergeJournal();
+    CHECK(child(session, k, k + 1), "op %u: failing session", k);
+    CHECK(child(listOnly, ~0u, 0), "op %u: boot", k);
+    if (listed(e, n, 0))
+    {
+      before++;
+    }
+    else if (listed(&e[100], n - 100, 0))
+    {
+      compacted++;
+    }
+    else if (listed(&e[100], n - 100, 1)
+             && shared->got[n - 100].start == last.start
+             && shared->got[n - 100].end == last.end)
+    {
+      appended++;
+    }
+    else
+    {
+      CHECK(false, "op %u: %u entries listed, total %u", k, shared->count,
+            shared->total);
+    }
+  }
+
+  printf("test_journal: power failed at %u ops of the stop: %u before, %u "
+         "compacted, %u appended\n", to - from, before, compacted, appended);
+}
+
+int main(void)
+{
+  shared = mmap(NULL, sizeof(*shared), PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  CHECK(shared != MAP_FAILED, "no shared memory");
+
+  mount();
+  reclaim();
+  powerFail();
+
+  return checkResult("test_journal");
+}
@@ -0,0 +1,753 @@
+/*
+ * test_sim.c
+ *
+ * End-to-end scenarios on the simulator (sim/): the unmodified application
+ * records generated speech from the I2S model into the flash model, and
+ * the recording is read back through the ble task with v2 packets; the
+ * client writes commands and settings to the profile's characteristics.
+ * The data and the codec state of each sector must be exactly what the
+ * host codec makes of the samples the microphone delivered, and no pcm
+ * buffer may be lost to the erases done while recording. Forked boots
+ * start on flash full of old data, as in the field: one idles, keeping
+ * history past the few erased-ahead sectors, then records twice back to
+ * back and once long; one is powered on recording. Prints what the run
+ * cost in flash and link time.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "adpcm.h"
+#include "check.h"
+#include "corpus.h"
+#include "sim.h"
+#include "simple_gatt_profile.h"
+
+CHECK_DEFINE;
+
+#define SECT_DATA_SIZE                    4000
+#define CHUNK_SIZE                        BADPCM_DATA_SIZE
+#define CHUNKS_PER_SECT                   25
+#define ADPCM_CHUNKS                      CHUNKS_PER_SECT
+#define SOURCE_SECONDS                    200
+#define RESERVED_SECTORS                  16
+#define DATA_SECTORS                      (4096 - RESERVED_SECTORS)
+#define ERASE_AHEAD_SECTORS               8
+
+typedef struct Client
+{
+  StatusPacket_t status;
+  uint32_t statusCount;
+  bool reading;               // flags of last status
+
+  uint32_t start;             // read range
+  uint32_t end;
+  uint8_t *data;              // SECT_DATA_SIZE per sector, from start
+  uint32_t *fill;             // bytes received per sector
+  AdpcmState_t *state;        // state of first packet per sector
+  bool *hasState;
+  uint32_t packets;
+  uint32_t bytes;
+  uint32_t errors;            // out of order or out of range
+  uint32_t stale;             // overwritten before sent
+  uint32_t ranges;            // range markers
+  uint8_t rangeIndex[16];     // of each marker
+  bool firstSeen;
+  BadpcmPacketV2_t first;     // first v2 packet since firstSeen cleared
+  uint32_t recsCount;         // recs pages
+  RecsPacket_t recs;          // header of last one
+} Client_t;
+
+static Client_t client;
+
+static int16_t *source;
+static size_t sourceLen;
+static size_t sourcePos;      // samples delivered
+
+static void sourceFxn(int16_t *pcm, size_t n, void *arg)
+{
+  (void) arg;
+
+  for (size_t i = 0; i < n; i++)
+  {
+    pcm[i] = source[sourcePos++ % sourceLen];
+  }
+}
+
+static void clientFxn(const uint8_t *pkt, size_t len)
+{
+  Client_t *c = &client;
+
+  if (len >= BADPCM_V2_HEADER_SIZE && pkt[0] == BADPCM_V2)
+  {
+    BadpcmPacketV2_t hdr;
+    memcpy(&hdr, pkt, BADPCM_V2_HEADER_SIZE);
+    const uint8_t *body = pkt + BADPCM_V2_HEADER_SIZE;
+    size_t n = len - BADPCM_V2_HEADER_SIZE;
+    if (!c->firstSeen)
+    {
+      memcpy(&c->first, pkt, sizeof(BadpcmPacketV2_t));
+      c->firstSeen = true;
+    }
+
+    if (hdr.major < c->start || hdr.major >= c->end)
+    {
+      c->errors++;
+      return;
+    }
+
+    if (hdr.format & BADPCM_V2_STALE)
+    {
+      c->stale++;
+      return;
+    }
+
+    uint32_t s = hdr.major - c->start;
+    if (hdr.format & BADPCM_V2_STATE)
+    {
+      memcpy(&c->state[s].sample, body, sizeof(int16_t));
+      c->state[s].index = body[2];
+      c->state[s].format = hdr.format & BADPCM_FMT_MASK;
+      c->hasState[s] = true;
+      body += BADPCM_V2_STATE_SIZE;
+      n -= BADPCM_V2_STATE_SIZE;
+    }
+
+    if (hdr.offset != c->fill[s] || hdr.offset + n > SECT_DATA_SIZE)
+    {
+      c->errors++;
+      return;
+    }
+
+    memcpy(&c->data[s * SECT_DATA_SIZE + hdr.offset], body, n);
+    c->fill[s] += n;
+    c->packets++;
+    c->bytes += n;
+  }
+  else if (len == sizeof(RangePacket_t) && pkt[0] == BADPCM_RANGE)
+  {
+    c->rangeIndex[c->ranges++ % 16] = pkt[1];
+  }
+  else if (len >= RECS_HEADER_SIZE && pkt[0] == BADPCM_RECS)
+  {
+    memcpy(&c->recs, pkt, RECS_HEADER_SIZE);
+    c->recsCount++;
+  }
+  else if (len <= sizeof(StatusPacket_t) && pkt[0] < 8)
+  {
+    // cut to mtu - 3, flags still first
+    memcpy(&c->status, pkt, len);
+    c->statusCount++;
+    c->reading = c->status.flags & 2;
+  }
+}
+
+static void command(uint32_t type, uint32_t start, uint32_t end)
+{
+  IncomingMsg_t msg = { .type = type, .start = start, .end = end };
+  simCommand(&msg);
+}
+
+static uint32_t statusCount;
+static uint32_t recorded;     // start of last recording, 3 sectors at least
+
+static bool statusArrived(void)
+{
+  return client.statusCount != statusCount;
+}
+
+/* status is the answer to every command but grant, ack and list */
+static void commandWait(uint32_t type, uint32_t start, uint32_t end)
+{
+  statusCount = client.statusCount;
+  command(type, start, end);
+  CHECK(simRunUntil(statusArrived, 5 * SIM_S), "no status for command %u",
+        type);
+}
+
+static bool rangeArrived(void)
+{
+  return client.ranges != 0;
+}
+
+static bool readDone(void)
+{
+  return !client.reading && client.statusCount != statusCount;
+}
+
+/*
+ * Encode what the firmware got the way it lays it out: chunks of
+ * BADPCM_SAMPLES, 3-bit chunks padded to 160 bytes, sectors of 25 chunks.
+ * Returns bytes, states[s] is the state at the start of sector s.
+ */
+static size_t encodeReference(const int16_t *pcm, size_t n, uint8_t fmt,
+                              uint8_t *out, AdpcmState_t *states)
+{
+  AdpcmState_t st = { 0, 0, fmt };
+  size_t spc = BADPCM_SAMPLES(fmt);
+  size_t bytes = 0;
+
+  for (size_t pos = 0, chunk = 0; pos < n; pos += spc, chunk++)
+  {
+    size_t k = n - pos < spc ? n - pos : spc;
+    if (chunk % CHUNKS_PER_SECT == 0)
+    {
+      states[chunk / CHUNKS_PER_SECT] = st;
+    }
+
+    uint8_t *dst = &out[chunk * CHUNK_SIZE];
+    memset(dst, 0, CHUNK_SIZE);
+    if (fmt & FMT_ADPCM3)
+    {
+      adpcm3EncodeBlock(&pcm[pos], k, dst, &st);
+      bytes = chunk * CHUNK_SIZE + k / ADPCM3_GROUP_SAMPLES * ADPCM3_GROUP_SIZE;
+    }
+    else
+    {
+      adpcmEncodeBlock(&pcm[pos], k, dst, &st);
+      bytes = chunk * CHUNK_SIZE + k / 2;
+    }
+  }
+  return bytes;
+}
+
+/*
+ * Record seconds of speech at rate and codec, stop, read it back with v2
+ * packets, and compare.
+ */
+static void recordAndRead(uint8_t bits, uint8_t khz, uint32_t seconds)
+{
+  uint32_t rate = khz * 1000;
+  uint8_t fmt = (bits == 3 ? FMT_ADPCM3 : 0) | (khz == 8 ? FMT_8KHZ : 0);
+
+  sourceLen = (size_t) rate * SOURCE_SECONDS;
+  source = malloc(sourceLen * sizeof(int16_t));
+  corpusFill(CORPUS_SPEECH, source, sourceLen, rate, 0x51u + bits + khz);
+  sourcePos = 0;
+  simI2sSource(sourceFxn, NULL);
+
+  CHECK(simWrite(SIMPLEPROFILE_CHAR3_UUID, &bits, 1) == 0
+        && simWrite(SIMPLEPROFILE_CHAR4_UUID, &khz, 1) == 0,
+        "%u-bit %u kHz: settings refused", bits, khz);
+  simRunFor(100 * SIM_MS);
+
+  SimStats before = simStats;
+  simStats.i2sMinAhead = ~0u;
+  simStats.i2sMaxBacklog = 0;
+  simStats.nvsMaxOpUs = 0;
+
+  commandWait(IMT_START_REC, 0, 0);
+  uint32_t start = client.status.recStart;
+  SimTime t0 = simNow;
+
+  simRunFor((SimTime) seconds * SIM_S);
+  commandWait(IMT_STOP_REC, 0, 0);
+  uint32_t end = client.status.recStart;
+  SimTime recUs = simNow - t0;
+
+  SimStats rec = simStats;
+  size_t delivered = sourcePos;
+
+  CHECK(rec.i2sErrors == before.i2sErrors, "%u-bit %u kHz: i2s queue ran empty",
+        bits, khz);
+  CHECK(end > start, "%u-bit %u kHz: nothing recorded", bits, khz);
+  recorded = start;
+  CHECK(rec.nvsErases - before.nvsErases
+        <= end - start + ERASE_AHEAD_SECTORS + 1,
+        "%u-bit %u kHz: %u sectors erased recording %u", bits, khz,
+        rec.nvsErases - before.nvsErases, end - start);
+
+  /* read it back */
+  uint32_t sects = end - start;
+  client.start = start;
+  client.end = end;
+  client.data = calloc(sects, SECT_DATA_SIZE);
+  client.fill = calloc(sects, sizeof(uint32_t));
+  client.state = calloc(sects, sizeof(AdpcmState_t));
+  client.hasState = calloc(sects, sizeof(bool));
+  client.packets = client.bytes = client.errors = client.stale = 0;
+
+  commandWait(IMT_START_READ_V2, start, end);
+  SimTime t1 = simNow;
+  CHECK(simRunUntil(readDone, 600 * SIM_S), "%u-bit %u kHz: read not done",
+        bits, khz);
+  SimTime readUs = simNow - t1;
+
+  /* compare */
+  uint8_t *ref = calloc(sects + 1, SECT_DATA_SIZE);
+  AdpcmState_t *refStates = calloc(sects + 1, sizeof(AdpcmState_t));
+  size_t refBytes = encodeReference(source, delivered, fmt, ref, refStates);
+
+  size_t got = 0;
+  for (uint32_t s = 0; s < sects; s++)
+  {
+    got += client.fill[s];
+    if (s + 1 < sects)
+    {
+      CHECK(client.fill[s] == SECT_DATA_SIZE, "sector %u: %u bytes", s,
+            client.fill[s]);
+    }
+
+    CHECK(client.hasState[s], "sector %u: no state", s);
+    CHECK(client.state[s].sample == refStates[s].sample
+          && client.state[s].index == refStates[s].index
+          && client.state[s].format == refStates[s].format,
+          "sector %u: state (%d, %u, %u), expected (%d, %u, %u)", s,
+          client.state[s].sample, client.state[s].index,
+          client.state[s].format, refStates[s].sample, refStates[s].index,
+          refStates[s].format);
+  }
+
+  CHECK(client.errors == 0, "%u packets out of order or range", client.errors);
+  CHECK(client.stale == 0, "%u packets stale", client.stale);
+  CHECK(got <= refBytes, "read %zu bytes, more than the %zu encoded", got,
+        refBytes);
+  /* at most the buffers in flight at stop are not recorded */
+  size_t lost = refBytes - got;
+  CHECK(lost <= 6 * 80 * (bits == 3 ? 3.0 / 8 : 0.5) + CHUNK_SIZE,
+        "read %zu bytes, %zu encoded", got, refBytes);
+  CHECK(memcmp(client.data, ref, got) == 0,
+        "%u-bit %u kHz: data differs from host encoding", bits, khz);
+
+  printf("  %u-bit %2u kHz: %3u s, %4u sectors, %u pcm buffers, "
+         "min %u queued, max %u waiting, %u i2s errors\n",
+         bits, khz, seconds, sects, rec.i2sBuffers - before.i2sBuffers,
+         rec.i2sMinAhead, rec.i2sMaxBacklog, rec.i2sErrors - before.i2sErrors);
+  printf("                 flash %u erases, %u page programs, busy %.1f%%, "
+         "longest call %.1f ms\n",
+         rec.nvsErases - before.nvsErases, rec.nvsPages - before.nvsPages,
+         100.0 * (rec.nvsBusyUs - before.nvsBusyUs) / recUs,
+         rec.nvsMaxOpUs / 1000.0);
+  printf("                 read %u packets, %u bytes in %.2f s, %.1f kB/s, "
+         "%.1fx real time\n",
+         client.packets, client.bytes, readUs / 1e6,
+         client.bytes / (readUs / 1e6) / 1000,
+         (double) recUs / readUs);
+
+  free(ref);
+  free(refStates);
+  free(client.data);
+  free(client.fill);
+  free(client.state);
+  free(client.hasState);
+  free(source);
+}
+
+/*
+ * Credit mode edges: a range marker goes out with no credit left, data
+ * waits for a grant; an ack past what was sent is rejected and answered
+ * with status, one within it is taken silently.
+ */
+static void creditsAndAcks(void)
+{
+  uint32_t s = recorded;
+
+  client.start = s;
+  client.end = s + 3;
+  client.data = calloc(3, SECT_DATA_SIZE);
+  client.fill = calloc(3, sizeof(uint32_t));
+  client.state = calloc(3, sizeof(AdpcmState_t));
+  client.hasState = calloc(3, sizeof(bool));
+  client.packets = client.bytes = client.errors = client.stale = 0;
+  client.ranges = 0;
+
+  command(IMT_GRANT, 0, 0);   // credit mode, nothing to spend
+  IncomingMsg_t multi = { .type = IMT_START_READ_MULTI, .count = 2,
+                          .ranges = { { s, s + 1 }, { s + 2, s + 3 } } };
+  statusCount = client.statusCount;
+  simCommand(&multi);
+  CHECK(simRunUntil(statusArrived, 5 * SIM_S), "no status for multi read");
+  CHECK(simRunUntil(rangeArrived, SIM_S), "range marker waits for credit");
+  simRunFor(SIM_S);
+  CHECK(client.packets == 0, "%u data packets without credit", client.packets);
+
+  // past what was sent
+  commandWait(IMT_ACK, s + 1, 0);
+  CHECK(client.status.readPosMajor == s && client.status.readPosMinor == 0,
+        "status read position %u, %u", client.status.readPosMajor,
+        client.status.readPosMinor);
+
+  // what was sent, not answered
+  statusCount = client.statusCount;
+  command(IMT_ACK, s, 0);
+  simRunFor(SIM_S);
+  CHECK(client.statusCount == statusCount, "ack within read answered");
+
+  statusCount = client.statusCount;
+  command(IMT_GRANT, 1000, 0);
+  CHECK(simRunUntil(readDone, 60 * SIM_S), "multi read not done");
+  CHECK(client.ranges == 2, "%u range markers", client.ranges);
+  CHECK(client.errors == 0 && client.fill[0] > 0 && client.fill[1] == 0
+        && client.fill[2] > 0, "ranges not read as asked");
+
+  printf("test_sim: credit 0 range marker, ack checks, %u packets after "
+         "grant\n", client.packets);
+
+  free(client.data);
+  free(client.fill);
+  free(client.state);
+  free(client.hasState);
+}
+
+static bool packetArrived(void)
+{
+  return client.firstSeen;
+}
+
+/*
+ * Seek edges: a start packet past the sector starts the next one; a v2
+ * resume point inside a chunk resumes at the chunk, with the state there.
+ * Reconnects first, which leaves credit mode with no credits.
+ */
+static void seeks(void)
+{
+  uint32_t s = recorded;
+
+  simDisconnect();
+  simRunFor(100 * SIM_MS);
+  simConnect(247);
+  simRunFor(100 * SIM_MS);
+
+  client.start = client.end = 0;
+  IncomingMsg_t read = { .type = IMT_START_READ_V2, .start = s, .end = s + 1,
+                         .startMinor = ADPCM_CHUNKS, .endMinor = 0 };
+  statusCount = client.statusCount;
+  simCommand(&read);
+  CHECK(simRunUntil(statusArrived, 5 * SIM_S), "no status for read");
+  CHECK(client.status.readPosMajor == s + 1 && client.status.readPosMinor == 0,
+        "start packet %u read from %u, %u", ADPCM_CHUNKS,
+        client.status.readPosMajor, client.status.readPosMinor);
+  commandWait(IMT_STOP_READ, 0, 0);
+
+  /* one packet of sector s, ack it, resume */
+  client.start = s;
+  client.end = s + 2;
+  client.data = calloc(2, SECT_DATA_SIZE);
+  client.fill = calloc(2, sizeof(uint32_t));
+  client.state = calloc(2, sizeof(AdpcmState_t));
+  client.hasState = calloc(2, sizeof(bool));
+  client.packets = client.errors = 0;
+  client.firstSeen = false;
+
+  command(IMT_GRANT, 1, 0);
+  commandWait(IMT_START_READ_V2, s, s + 2);
+  CHECK(simRunUntil(packetArrived, 5 * SIM_S), "no packet");
+  simRunFor(SIM_S);
+  uint32_t acked = client.fill[0];
+  AdpcmState_t st = client.state[0];    // the resumed packet overwrites it
+  CHECK(acked > CHUNK_SIZE && acked % CHUNK_SIZE, "first packet %u bytes",
+        acked);
+
+  // 9-byte form, range being read
+  IncomingMsg_t ack = { .type = IMT_ACK, .start = s, .end = acked,
+                        .range = ACK_RANGE_CURRENT };
+  simCommand(&ack);
+  commandWait(IMT_STOP_READ, 0, 0);
+  commandWait(IMT_RESUME_READ, 0, 0);
+  uint32_t chunk = acked / CHUNK_SIZE * CHUNK_SIZE;
+  CHECK(client.status.readPosMajor == s && client.status.readPosMinor == chunk,
+        "resumed at %u, %u, expected %u, %u", client.status.readPosMajor,
+        client.status.readPosMinor, s, chunk);
+
+  client.firstSeen = false;
+  command(IMT_GRANT, 1, 0);
+  CHECK(simRunUntil(packetArrived, 5 * SIM_S), "no packet after resume");
+
+  adpcmAdvanceState(client.data, BADPCM_SAMPLES(st.format) * (chunk / CHUNK_SIZE),
+                    &st);
+  CHECK(client.first.offset == chunk && (client.first.format & BADPCM_V2_STATE),
+        "resumed packet offset %u, format %02x", client.first.offset,
+        client.first.format);
+  int16_t sample;
+  memcpy(&sample, client.first.body, sizeof(sample));
+  CHECK(sample == st.sample && client.first.body[2] == st.index,
+        "resumed state (%d, %u), expected (%d, %u)", sample,
+        client.first.body[2], st.sample, st.index);
+
+  commandWait(IMT_STOP_READ, 0, 0);
+  printf("test_sim: seek past sector, resume inside chunk at %u from %u\n",
+         chunk, acked);
+
+  free(client.data);
+  free(client.fill);
+  free(client.state);
+  free(client.hasState);
+}
+
+static void ackRange(uint8_t range, uint32_t major, uint32_t minor)
+{
+  IncomingMsg_t ack = { .type = IMT_ACK, .start = major, .end = minor,
+                        .range = range };
+  simCommand(&ack);
+}
+
+/*
+ * Multi-range resume: the next range is on the air before the tail of the
+ * previous one is acked. The resume point stays in the acked range, and
+ * resume sends that range's tail, with its marker, and then the next one.
+ * Acks for a range not yet read, or past what was sent, are rejected.
+ */
+static void multiRangeResume(void)
+{
+  uint32_t s = recorded;
+  uint32_t acked = 10 * CHUNK_SIZE;
+
+  client.start = s;
+  client.end = s + 3;
+  client.data = calloc(3, SECT_DATA_SIZE);
+  client.fill = calloc(3, sizeof(uint32_t));
+  client.state = calloc(3, sizeof(AdpcmState_t));
+  client.hasState = calloc(3, sizeof(bool));
+  client.packets = client.errors = client.ranges = 0;
+
+  // all of range 0, a few packets of range 1
+  command(IMT_GRANT, SECT_DATA_SIZE / 236 + 4, 0);
+  IncomingMsg_t multi = { .type = IMT_START_READ_MULTI, .count = 2,
+                          .ranges = { { s, s + 1 }, { s + 2, s + 3 } } };
+  statusCount = client.statusCount;
+  simCommand(&multi);
+  CHECK(simRunUntil(statusArrived, 5 * SIM_S), "no status for multi read");
+  simRunFor(SIM_S);
+  CHECK(client.ranges == 2 && client.fill[0] == SECT_DATA_SIZE
+        && client.fill[2] > 0, "%u markers, %u and %u bytes", client.ranges,
+        client.fill[0], client.fill[2]);
+
+  ackRange(0, s, acked);
+  commandWait(IMT_ACK, s + 2, 0);       // range 0 does not go there
+  CHECK(client.status.readPosMajor == s + 2, "ack into range 0 taken");
+  commandWait(IMT_ACK, s + 3, 0);       // range 1, past what was sent
+  statusCount = client.statusCount;
+  ackRange(2, s, 0);                    // not read yet
+  CHECK(simRunUntil(statusArrived, SIM_S), "ack for range 2 taken");
+  commandWait(IMT_STOP_READ, 0, 0);
+
+  /* the unacked tail of range 0 and range 1 come again */
+  client.fill[0] = acked;
+  client.fill[2] = 0;
+  client.ranges = 0;
+  command(IMT_GRANT, 1000, 0);
+  commandWait(IMT_RESUME_READ, 0, 0);
+  CHECK(client.status.readPosMajor == s
+        && client.status.readPosMinor == acked,
+        "resumed at %u, %u, expected %u, %u", client.status.readPosMajor,
+        client.status.readPosMinor, s, acked);
+  CHECK(simRunUntil(readDone, 60 * SIM_S), "resumed multi read not done");
+  CHECK(client.ranges == 2 && client.rangeIndex[0] == 0
+        && client.rangeIndex[1] == 1, "%u markers after resume, first %u",
+        client.ranges, client.rangeIndex[0]);
+  CHECK(client.errors == 0 && client.fill[0] == SECT_DATA_SIZE
+        && client.fill[1] == 0 && client.fill[2] == SECT_DATA_SIZE,
+        "resumed ranges: %u errors, %u, %u, %u bytes", client.errors,
+        client.fill[0], client.fill[1], client.fill[2]);
+
+  /* acked into range 1, resume starts there */
+  ackRange(1, s + 2, 0);
+  client.ranges = 0;
+  commandWait(IMT_RESUME_READ, 0, 0);
+  CHECK(client.status.readPosMajor == s + 2 && client.status.readPosMinor == 0,
+        "resumed at %u, %u, expected %u, 0", client.status.readPosMajor,
+        client.status.readPosMinor, s + 2);
+  CHECK(simRunUntil(readDone, 60 * SIM_S), "second resume not done");
+  CHECK(client.ranges == 1 && client.rangeIndex[0] == 1,
+        "%u markers after resume in range 1, first %u", client.ranges,
+        client.rangeIndex[0]);
+  commandWait(IMT_STOP_READ, 0, 0);
+
+  printf("test_sim: multi-range resume in range 0 at %u after range 1 "
+         "started, then in range 1\n", acked);
+
+  free(client.data);
+  free(client.fill);
+  free(client.state);
+  free(client.hasState);
+}
+
+static bool recsArrived(void)
+{
+  return client.recsCount != 0;
+}
+
+/*
+ * Journal pages: the 1-byte form lists from the start; at mtu 23 not one
+ * entry fits and the answer is status, not an empty page (the end).
+ */
+static void listRecs(void)
+{
+  client.recsCount = 0;
+  IncomingMsg_t list = { .type = IMT_LIST_RECS };
+  simCommand(&list);
+  CHECK(simRunUntil(recsArrived, SIM_S), "no recs page");
+  CHECK(client.recs.count == 3 && client.recs.total == 3,
+        "recs page %u of %u entries", client.recs.count, client.recs.total);
+
+  simDisconnect();
+  simRunFor(100 * SIM_MS);
+  simConnect(23);
+  simRunFor(100 * SIM_MS);
+  client.recsCount = 0;
+  statusCount = client.statusCount;
+  simCommand(&list);
+  CHECK(simRunUntil(statusArrived, SIM_S), "no status for list at mtu 23");
+  CHECK(client.recsCount == 0, "recs page at mtu 23");
+  printf("test_sim: list recs, %u entries, status at mtu 23\n",
+         client.recs.total);
+}
+
+/*
+ * A notification buffer shorter than the v2 header (an mtu dropped under a
+ * queued packet) gets nothing, a longer one the header and what data fits.
+ */
+static void shortBuffer(void)
+{
+  static uint8_t buf[256];
+  OutgoingMsg_t msg = { .type = OMT_BADPCM_V2 };
+  msg.len = BADPCM_V2_HEADER_SIZE + BADPCM_V2_STATE_SIZE + 200;
+  msg.nvsLen = 200;
+  msg.nvsOffset = 0;
+
+  size_t n = readOutgoingMsg(&msg, buf, BADPCM_V2_HEADER_SIZE);
+  CHECK(n == 0, "%zu bytes into a buffer shorter than the header", n);
+  n = readOutgoingMsg(&msg, buf, 20);
+  CHECK(n == 20, "%zu bytes into a 20-byte buffer", n);
+  n = readOutgoingMsg(&msg, buf, sizeof(buf));
+  CHECK(n == msg.len, "%zu bytes of a %u-byte packet", n, msg.len);
+}
+
+static uint32_t oldSectors(void)
+{
+  uint32_t n = 0;
+  for (uint32_t s = 0; s < DATA_SECTORS; s++)
+  {
+    n += simFlash[s * 4096 + 4095] == 0x5a;
+  }
+  return n;
+}
+
+static void usedFlashReset(void)
+{
+  simNvsReset();
+  memset(simFlash, 0x5a, DATA_SECTORS * 4096);
+}
+
+/*
+ * Stop and start again at once: the sectors erased ahead were used up by
+ * the first recording, the second one erases in the pcm path from its
+ * start.
+ */
+static void backToBack(void)
+{
+  SimStats before = simStats;
+  simStats.i2sMinAhead = ~0u;
+
+  commandWait(IMT_START_REC, 0, 0);
+  simRunFor(5 * SIM_S);
+  commandWait(IMT_STOP_REC, 0, 0);
+  commandWait(IMT_START_REC, 0, 0);
+  simRunFor(10 * SIM_S);
+  commandWait(IMT_STOP_REC, 0, 0);
+
+  CHECK(simStats.i2sErrors == before.i2sErrors, "back to back: i2s queue "
+        "ran empty");
+  printf("test_sim: back to back, %u sectors erased, min %u queued\n",
+         simStats.nvsErases - before.nvsErases, simStats.i2sMinAhead);
+}
+
+/*
+ * Boot on a data region full of old recordings (nothing blank), give the
+ * idle task time to erase ahead, which must leave the rest alone, then
+ * record back to back, and longer than one pcm buffer queue could cover
+ * without erasing while recording.
+ */
+static int usedFlash(void)
+{
+  usedFlashReset();
+
+  simClient(clientFxn);
+  simBoot();
+  simConnect(247);
+
+  SimStats before = simStats;
+  simRunFor(60 * SIM_S);
+  uint32_t erased = simStats.nvsErases - before.nvsErases;
+  CHECK(erased <= ERASE_AHEAD_SECTORS + 1, "%u sectors erased in idle",
+        erased);
+  CHECK(oldSectors() == DATA_SECTORS - erased, "%u old sectors of %u left",
+        oldSectors(), DATA_SECTORS - erased);
+  printf("test_sim: used flash, %u sectors erased in 60 s idle, %u kept\n",
+         erased, oldSectors());
+
+  backToBack();
+  recordAndRead(4, 16, 120);
+
+  return checkResult("test_sim (used flash)");
+}
+
+/*
+ * Powered on with a double click, recording at once on used flash: no
+ * sector is erased ahead yet.
+ */
+static int bootRecording(void)
+{
+  usedFlashReset();
+
+  simBootRecording();
+  SimStats before = simStats;
+  simRunFor(30 * SIM_S);
+
+  CHECK(simStats.i2sErrors == 0, "boot recording: i2s queue ran empty");
+  CHECK(simStats.i2sBuffers - before.i2sBuffers >= 30 * 200 - 1,
+        "boot recording: %u pcm buffers in 30 s",
+        simStats.i2sBuffers - before.i2sBuffers);
+  printf("test_sim: powered on recording, %u sectors erased in 30 s, "
+         "min %u queued\n", simStats.nvsErases - before.nvsErases,
+         simStats.i2sMinAhead);
+
+  // double click stops and powers off
+  simButton(simNow, 150);
+  simButton(simNow + 300 * SIM_MS, 150);
+  CHECK(simRunUntil(simPoweredOff, 5 * SIM_S), "no power off");
+
+  return checkResult("test_sim (boot recording)");
+}
+
+static bool forked(int (*fxn)(void))
+{
+  fflush(stdout);
+  pid_t pid = fork();
+  if (pid == 0)
+  {
+    exit(fxn());
+  }
+
+  int status = 1;
+  waitpid(pid, &status, 0);
+  return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+int main(void)
+{
+  CHECK(forked(usedFlash), "used flash boot failed");
+  CHECK(forked(bootRecording), "boot recording failed");
+
+  simClient(clientFxn);
+  simBoot();
+  simConnect(247);
+  simRunFor(100 * SIM_MS);
+
+  printf("test_sim: record and read back, mtu 247, %u ms interval, "
+         "%u pdus per event\n", simConfig.connIntervalUs / 1000,
+         simConfig.pdusPerEvent);
+  recordAndRead(4, 16, 60);
+  recordAndRead(3, 16, 30);
+  recordAndRead(4, 8, 30);
+  creditsAndAcks();
+  seeks();
+  multiRangeResume();
+  listRecs();
+  shortBuffer();
+
+  CHECK(simStats.icallBadFrees == 0, "%u ICall blocks freed as the wrong kind",
+        simStats.icallBadFrees);
+  return checkResult("test_sim");
+}
@@ -0,0 +1,327 @@
+/*
+ * test_vad.c
+ *
+ * Recording with voice activity detection on the simulator (sim/), built
+ * with USE_VAD; test_vad_off is the same file without it. Speech with long
+ * pauses is replayed into the I2S model on flash full of old data, then
+ * read back with v2 packets. A host model of the firmware's sector layout
+ * (the same vad.c on the same pcm buffers: silence from a sector boundary
+ * is collapsed into one marker sector, the codec state runs on over it)
+ * gives the reference: each marker's sample count, and each data sector's
+ * state and bytes, must be exactly what the client got, and decoding the
+ * sectors either side of a marker must give the reference samples. Prints
+ * what the recording cost in flash and what the read sent, to compare the
+ * two builds.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "adpcm.h"
+#include "check.h"
+#include "corpus.h"
+#include "sim.h"
+#include "vad.h"
+
+CHECK_DEFINE;
+
+#define RATE                              16000
+#define PCM_BUF_SAMPLES                   80
+#define CHUNK_SIZE                        BADPCM_DATA_SIZE
+#define CHUNK_SAMPLES                     (CHUNK_SIZE * 2)
+#define CHUNKS_PER_SECT                   25
+#define SECT_DATA_SIZE                    4000
+#define SECT_SAMPLES                      (CHUNKS_PER_SECT * CHUNK_SAMPLES)
+#define DATA_SECTORS                      (4096 - 16)
+#define MAX_SECTS                         256
+
+#ifdef USE_VAD
+#define BUILD_NAME                        "test_vad"
+#else
+#define BUILD_NAME                        "test_vad_off"
+#endif
+
+/* speech, pause, ... in seconds; pauses are longer than the hangover */
+static const struct
+{
+  CorpusKind_t kind;
+  float seconds;
+} script[] = {
+  { CORPUS_SPEECH, 3.0f }, { CORPUS_SILENCE, 5.0f },
+  { CORPUS_SPEECH, 2.3f }, { CORPUS_SILENCE, 1.7f },
+  { CORPUS_SPEECH, 4.0f }, { CORPUS_SILENCE, 9.0f },
+  { CORPUS_SPEECH, 2.0f },
+};
+
+typedef struct Sect
+{
+  bool silence;
+  uint32_t count;             // silent samples of a marker
+  AdpcmState_t state;         // at sector start
+  uint8_t data[SECT_DATA_SIZE];
+  uint32_t fill;
+} Sect_t;
+
+static int16_t *source;
+static size_t sourceLen;
+static size_t sourcePos;
+
+/* reference, fed the pcm buffers the microphone delivers */
+static Sect_t ref[MAX_SECTS];
+static uint32_t refNum;       // sectors begun
+static AdpcmState_t refState;
+static VadState_t refVad;
+#ifdef USE_VAD
+static uint32_t refSilent;    // pending marker
+#endif
+
+/* what the client got, by major - start */
+static Sect_t got[MAX_SECTS];
+static uint32_t gotStart;
+static uint32_t gotErrors;
+static StatusPacket_t status;
+static uint32_t statusCount;
+
+static void refBuffer(const int16_t *pcm, size_t n)
+{
+#ifdef USE_VAD
+  bool voiced = vadProcess(&refVad, pcm, n);
+  Sect_t *cur = refNum ? &ref[refNum - 1] : NULL;
+  bool boundary = cur == NULL || cur->silence || cur->fill == SECT_DATA_SIZE;
+  if (!voiced && boundary)
+  {
+    refSilent += n;
+    return;
+  }
+  if (refSilent)
+  {
+    Sect_t *m = &ref[refNum++];
+    m->silence = true;
+    m->count = refSilent;
+    m->state = refState;
+    refSilent = 0;
+  }
+#endif
+
+  Sect_t *s = refNum ? &ref[refNum - 1] : NULL;
+  if (s == NULL || s->silence || s->fill == SECT_DATA_SIZE)
+  {
+    if (refNum == MAX_SECTS)
+      return;
+    s = &ref[refNum++];
+    s->state = refState;
+  }
+  adpcmEncodeBlock(pcm, n, &s->data[s->fill], &refState);
+  s->fill += n / 2;
+}
+
+static void sourceFxn(int16_t *pcm, size_t n, void *arg)
+{
+  (void) arg;
+
+  for (size_t i = 0; i < n; i++)
+  {
+    pcm[i] = sourcePos < sourceLen ? source[sourcePos] : 0;
+    sourcePos++;
+  }
+  refBuffer(pcm, n);
+}
+
+static void clientFxn(const uint8_t *pkt, size_t len)
+{
+  if (len >= BADPCM_V2_HEADER_SIZE && pkt[0] == BADPCM_V2)
+  {
+    BadpcmPacketV2_t hdr;
+    memcpy(&hdr, pkt, BADPCM_V2_HEADER_SIZE);
+    const uint8_t *body = pkt + BADPCM_V2_HEADER_SIZE;
+    size_t n = len - BADPCM_V2_HEADER_SIZE;
+
+    uint32_t k = hdr.major - gotStart;
+    if (k >= MAX_SECTS || (hdr.format & BADPCM_V2_STALE))
+    {
+      gotErrors++;
+      return;
+    }
+
+    Sect_t *s = &got[k];
+    if (hdr.format & BADPCM_V2_STATE)
+    {
+      memcpy(&s->state.sample, body, sizeof(int16_t));
+      s->state.index = body[2];
+      s->state.format = hdr.format & BADPCM_FMT_MASK;
+      body += BADPCM_V2_STATE_SIZE;
+      n -= BADPCM_V2_STATE_SIZE;
+    }
+
+    if (hdr.format & FMT_SILENCE)
+    {
+      s->silence = true;
+      memcpy(&s->count, body, sizeof(uint32_t));
+      return;
+    }
+
+    if (hdr.offset != s->fill || hdr.offset + n > SECT_DATA_SIZE)
+    {
+      gotErrors++;
+      return;
+    }
+    memcpy(&s->data[hdr.offset], body, n);
+    s->fill += n;
+  }
+  else if (len <= sizeof(StatusPacket_t) && pkt[0] < 8)
+  {
+    memcpy(&status, pkt, len);
+    statusCount++;
+  }
+}
+
+static uint32_t statusSeen;
+
+static bool statusArrived(void)
+{
+  return statusCount != statusSeen;
+}
+
+static bool readDone(void)
+{
+  return statusArrived() && !(status.flags & 2);
+}
+
+static void commandWait(uint32_t type, uint32_t start, uint32_t end)
+{
+  IncomingMsg_t msg = { .type = type, .start = start, .end = end };
+  statusSeen = statusCount;
+  simCommand(&msg);
+  CHECK(simRunUntil(statusArrived, 5 * SIM_S), "no status for command %u",
+        type);
+}
+
+static void decode(const Sect_t *s, int16_t *pcm)
+{
+  AdpcmState_t st = s->state;
+  adpcmDecodeBlock(s->data, s->fill * 2, pcm, &st);
+}
+
+/*
+ * The sectors either side of marker k decode to the reference samples.
+ */
+static void checkAroundMarker(uint32_t k)
+{
+  static int16_t a[SECT_SAMPLES], b[SECT_SAMPLES];
+
+  for (int d = -1; d <= 1; d += 2)
+  {
+    if ((d < 0 && k == 0) || k + d >= refNum || got[k + d].silence)
+      continue;
+
+    decode(&got[k + d], a);
+    decode(&ref[k + d], b);
+    CHECK(got[k + d].fill == ref[k + d].fill
+          || (k + d + 1 == refNum && got[k + d].fill <= ref[k + d].fill),
+          "sector %u next to marker: %u bytes, expected %u", k + d,
+          got[k + d].fill, ref[k + d].fill);
+    CHECK(memcmp(a, b, got[k + d].fill * 2 * sizeof(int16_t)) == 0,
+          "sector %u next to marker %u decodes differently", k + d, k);
+  }
+}
+
+int main(void)
+{
+  for (size_t i = 0; i < sizeof(script) / sizeof(script[0]); i++)
+  {
+    sourceLen += (size_t) (script[i].seconds * RATE) / PCM_BUF_SAMPLES
+        * PCM_BUF_SAMPLES;
+  }
+  source = malloc(sourceLen * sizeof(int16_t));
+  for (size_t i = 0, pos = 0; i < sizeof(script) / sizeof(script[0]); i++)
+  {
+    size_t n = (size_t) (script[i].seconds * RATE) / PCM_BUF_SAMPLES
+        * PCM_BUF_SAMPLES;
+    corpusFill(script[i].kind, &source[pos], n, RATE, 0x7ad + i);
+    pos += n;
+  }
+
+  simNvsReset();
+  memset(simFlash, 0x5a, (size_t) DATA_SECTORS * 4096);
+  simClient(clientFxn);
+  simBoot();
+  simConnect(247);
+  simRunFor(100 * SIM_MS);
+
+  /* the reference starts with the firmware, at the first buffer */
+  vadReset(&refVad);
+  simI2sSource(sourceFxn, NULL);
+  SimStats before = simStats;
+  commandWait(IMT_START_REC, 0, 0);
+  uint32_t start = status.recStart;
+  simRunFor((SimTime) sourceLen * SIM_S / RATE);
+  commandWait(IMT_STOP_REC, 0, 0);
+  uint32_t end = status.recStart;
+  SimStats rec = simStats;
+
+  CHECK(rec.i2sErrors == before.i2sErrors, "i2s queue ran empty");
+  CHECK(end > start && end - start <= MAX_SECTS, "recorded %u sectors",
+        end - start);
+
+  gotStart = start;
+  SimStats readBefore = simStats;
+  commandWait(IMT_START_READ_V2, start, end);
+  CHECK(simRunUntil(readDone, 120 * SIM_S), "read not done");
+  SimStats read = simStats;
+
+  /* compare sector by sector, the last may be cut short by stop */
+  uint32_t sects = end - start;
+  uint32_t markers = 0;
+  uint64_t samples = 0;
+  CHECK(gotErrors == 0, "%u packets out of order or range", gotErrors);
+  CHECK(sects == refNum || sects + 1 == refNum,
+        "%u sectors recorded, reference has %u", sects, refNum);
+  for (uint32_t k = 0; k < sects && k < refNum; k++)
+  {
+    bool last = k + 1 == sects;
+    CHECK(got[k].silence == ref[k].silence, "sector %u: silence %d, "
+          "expected %d", k, got[k].silence, ref[k].silence);
+    CHECK(got[k].state.sample == ref[k].state.sample
+          && got[k].state.index == ref[k].state.index,
+          "sector %u: state (%d, %u), expected (%d, %u)", k,
+          got[k].state.sample, got[k].state.index, ref[k].state.sample,
+          ref[k].state.index);
+
+    if (got[k].silence)
+    {
+      CHECK(got[k].count == ref[k].count
+            || (last && got[k].count <= ref[k].count),
+            "marker %u: %u samples, expected %u", k, got[k].count,
+            ref[k].count);
+      samples += got[k].count;
+      markers++;
+      checkAroundMarker(k);
+      continue;
+    }
+
+    CHECK(got[k].fill == ref[k].fill || (last && got[k].fill <= ref[k].fill),
+          "sector %u: %u bytes, expected %u", k, got[k].fill, ref[k].fill);
+    CHECK(memcmp(got[k].data, ref[k].data, got[k].fill) == 0,
+          "sector %u: data differs from host encoding", k);
+    samples += got[k].fill * 2;
+  }
+
+#ifdef USE_VAD
+  CHECK(markers >= 3, "%u silence markers", markers);
+#else
+  CHECK(markers == 0, "%u silence markers without vad", markers);
+#endif
+  /* timeline: what was delivered, less the buffers in flight at stop */
+  CHECK(samples <= sourcePos && sourcePos - samples <= 16 * PCM_BUF_SAMPLES
+        + CHUNK_SAMPLES, "timeline %llu samples, %zu delivered",
+        (unsigned long long) samples, sourcePos);
+
+  printf("%s: %.1f s, %u sectors (%u silence markers), %u page programs, "
+         "%u erases, %llu bytes sent in %u notifications\n", BUILD_NAME,
+         (double) sourceLen / RATE, sects, markers, rec.nvsPages - before.nvsPages,
+         rec.nvsErases - before.nvsErases,
+         (unsigned long long) (read.notifyBytes - readBefore.notifyBytes),
+         read.notifications - readBefore.notifications);
+
+  free(source);
+  return checkResult(BUILD_NAME);
+}
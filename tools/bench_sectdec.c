@@ -0,0 +1,81 @@
+/*
+ * bench_sectdec.c
+ *
+ * Sectors/s of each kernel on a 16 MB image (4080 data sectors) of full
+ * 4-bit sectors, encoded from the generated speech. Single thread.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "corpus.h"
+#include "sectdec.h"
+
+volatile uint32_t benchSink;
+
+#define IMAGE_SECTS                       4096
+#define DATA_SECTS                        (IMAGE_SECTS - SECT_RESERVED)
+#define BENCH_ROUNDS                      5
+
+int main(void)
+{
+  uint8_t *image = malloc((size_t) IMAGE_SECTS * SECT_SIZE);
+  int16_t *pcm = malloc((size_t) DATA_SECTS * SECT_SAMPLES_4 * sizeof(int16_t));
+  static SectInfo_t infos[DATA_SECTS];
+  static int16_t *out[DATA_SECTS];
+  AdpcmState_t st = { 0, 0, 0 };
+
+  memset(image, 0xff, (size_t) IMAGE_SECTS * SECT_SIZE);
+  corpusFill(CORPUS_SPEECH, pcm, (size_t) DATA_SECTS * SECT_SAMPLES_4, 16000, 1);
+
+  for (uint32_t i = 0; i < DATA_SECTS; i++)
+  {
+    uint8_t *sect = image + (size_t) i * SECT_SIZE;
+
+    memset(sect, 0, SECT_HEADER_SIZE);
+    memcpy(sect + SECT_POS_OFFSET, &i, sizeof(i));
+    memcpy(sect + SECT_STATE_OFFSET, &st, sizeof(st));
+    adpcmEncodeBlock(&pcm[(size_t) i * SECT_SAMPLES_4], SECT_SAMPLES_4,
+                     sect + SECT_HEADER_SIZE, &st);
+
+    sectParse(sect, i, &infos[i]);
+    out[i] = &pcm[(size_t) i * SECT_SAMPLES_4];   // reuse as output
+  }
+
+  static const char *names[] = { "scalar", "sse41", "avx2" };
+  double base = 0;
+
+  for (int n = 0; n < 3; n++)
+  {
+    const SectDecoder_t *dec = sectDecoderFind(names[n]);
+    uint64_t ns = UINT64_MAX;
+
+    if (!dec)
+    {
+      printf("%-8s not supported\n", names[n]);
+      continue;
+    }
+
+    for (int round = 0; round < BENCH_ROUNDS; round++)
+    {
+      uint64_t t0 = benchNow();
+      sectDecode(dec, image, infos, DATA_SECTS, out);
+      uint64_t t = benchNow() - t0;
+      ns = t < ns ? t : ns;
+      benchSink += out[DATA_SECTS / 2][100];
+    }
+
+    double rate = DATA_SECTS * 1e9 / ns;
+    if (n == 0)
+      base = rate;
+
+    printf("%-8s %2u lanes %10.0f sectors/s %8.1f Msample/s %6.2fx scalar"
+           " %7.1f ms per image\n", dec->name, dec->lanes, rate,
+           rate * SECT_SAMPLES_4 / 1e6, rate / base, ns / 1e6);
+  }
+
+  free(image);
+  free(pcm);
+  return 0;
+}
@@ -0,0 +1,215 @@
+/*
+ * sectdec.c
+ *
+ * Sector parsing, the scalar fallback and kernel dispatch.
+ */
+#include <stdbool.h>
+#include <string.h>
+
+#include "sectdec.h"
+
+/* same tables as adpcm.c, the simd kernels use them widened to 32-bit */
+static const int stepSizeTable[89] = { 7, 8, 9, 10, 11, 12, 13, 14, 16, 17,
+                                       19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+                                       50, 55, 60, 66, 73, 80, 88, 97, 107, 118,
+                                       130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+                                       337, 371, 408, 449, 494, 544, 598, 658, 724, 796,
+                                       876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+                                       2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358,
+                                       5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+                                       15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767 };
+
+static const int indexTable[8] = { -1, -1, -1, -1, 2, 4, 6, 8 };
+
+int32_t sectDiffqTable[89 * 8];
+int32_t sectNextTable[89 * 8];
+
+static void initTables(void)
+{
+  static bool done;
+
+  if (done)
+    return;
+
+  for (int i = 0; i < 89; i++)
+  {
+    int step = stepSizeTable[i];
+    for (int c = 0; c < 8; c++)
+    {
+      int next = i + indexTable[c];
+      sectDiffqTable[i * 8 + c] = (step >> 3) + ((c & 4) ? step : 0)
+          + ((c & 2) ? step >> 1 : 0) + ((c & 1) ? step >> 2 : 0);
+      sectNextTable[i * 8 + c] = next < 0 ? 0 : (next > 88 ? 88 : next);
+    }
+  }
+  done = true;
+}
+
+static uint32_t le32(const uint8_t *p)
+{
+  return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t) p[3] << 24;
+}
+
+/* same rule as sectFill() in audio.c */
+static uint32_t sectFill(uint32_t marker)
+{
+  uint32_t fill = marker & 0xffff;
+  if ((marker >> 16) != (~fill & 0xffff) || fill == 0
+      || fill >= SECT_DATA_SIZE)
+  {
+    return SECT_DATA_SIZE;
+  }
+  return fill;
+}
+
+void sectParse(const uint8_t *sect, uint32_t index, SectInfo_t *info)
+{
+  const uint8_t *st = sect + SECT_STATE_OFFSET;
+
+  memset(info, 0, sizeof(*info));
+  info->index = index;
+  info->pos = le32(sect + SECT_POS_OFFSET);
+  info->state.sample = (int16_t) (st[0] | st[1] << 8);
+  info->state.index = st[2];
+  info->state.format = st[3];
+  info->rate = (info->state.format & SECT_FMT_8KHZ) ? 8000 : 16000;
+  info->bytes = sectFill(le32(sect + SECT_FILL_OFFSET));
+
+  if (info->pos == 0xffffffff || info->state.index > 88
+      || (info->state.format & ~7))
+  {
+    info->kind = SECT_BLANK;
+    info->bytes = 0;
+  }
+  else if (info->state.format & SECT_FMT_SILENCE)
+  {
+    info->kind = SECT_SILENCE;
+    info->bytes = 0;
+    info->samples = le32(sect + SECT_HEADER_SIZE);
+  }
+  else if (info->state.format & SECT_FMT_ADPCM3)
+  {
+    info->kind = SECT_ADPCM3;
+    info->samples = info->bytes / SECT_CHUNK_SIZE * SECT_CHUNK_SAMPLES_3
+        + info->bytes % SECT_CHUNK_SIZE / ADPCM3_GROUP_SIZE
+            * ADPCM3_GROUP_SAMPLES;
+  }
+  else
+  {
+    info->kind = SECT_ADPCM4;
+    info->samples = info->bytes * 2;
+  }
+}
+
+/* one sector per call, with the firmware block decoder */
+static void kernelScalar(const uint8_t *const data[], const AdpcmState_t st[],
+                         int16_t *const out[])
+{
+  AdpcmState_t s = st[0];
+  adpcmDecodeBlock(data[0], SECT_SAMPLES_4, out[0], &s);
+}
+
+static const SectDecoder_t decoders[] = {
+#if defined(__x86_64__) || defined(__i386__)
+  { "avx2", 8, sectKernelAvx2 },
+  { "sse41", 4, sectKernelSse41 },
+#endif
+  { "scalar", 1, kernelScalar },
+};
+
+#define DECODER_NUM (sizeof(decoders) / sizeof(decoders[0]))
+
+static bool supported(const SectDecoder_t *dec)
+{
+#if defined(__x86_64__) || defined(__i386__)
+  if (!strcmp(dec->name, "avx2"))
+    return __builtin_cpu_supports("avx2");
+  if (!strcmp(dec->name, "sse41"))
+    return __builtin_cpu_supports("sse4.1");
+#endif
+  (void) dec;
+  return true;
+}
+
+const SectDecoder_t *sectDecoderFind(const char *name)
+{
+  initTables();
+
+  for (size_t i = 0; i < DECODER_NUM; i++)
+  {
+    if ((!strcmp(name, "auto") || !strcmp(name, decoders[i].name))
+        && supported(&decoders[i]))
+    {
+      return &decoders[i];
+    }
+  }
+  return NULL;
+}
+
+static void decodeOther(const uint8_t *sect, const SectInfo_t *info,
+                        int16_t *out)
+{
+  AdpcmState_t st = info->state;
+  const uint8_t *data = sect + SECT_HEADER_SIZE;
+
+  switch (info->kind)
+  {
+  case SECT_ADPCM4:     // partial, committed on stop
+    adpcmDecodeBlock(data, info->samples, out, &st);
+    break;
+
+  case SECT_ADPCM3:     // per chunk, last byte of each chunk is pad
+    for (uint32_t done = 0; done < info->samples;
+        done += SECT_CHUNK_SAMPLES_3, data += SECT_CHUNK_SIZE)
+    {
+      uint32_t k = info->samples - done;
+      k = k < SECT_CHUNK_SAMPLES_3 ? k : SECT_CHUNK_SAMPLES_3;
+      adpcm3DecodeBlock(data, k, &out[done], &st);
+    }
+    break;
+
+  case SECT_SILENCE:
+    memset(out, 0, info->samples * sizeof(int16_t));
+    break;
+
+  default:
+    break;
+  }
+}
+
+void sectDecode(const SectDecoder_t *dec, const uint8_t *image,
+                const SectInfo_t *infos, size_t count, int16_t *const out[])
+{
+  const uint8_t *data[8];
+  AdpcmState_t st[8];
+  int16_t *dst[8];
+  unsigned lanes = 0;
+
+  for (size_t i = 0; i < count; i++)
+  {
+    const SectInfo_t *info = &infos[i];
+    const uint8_t *sect = image + (size_t) info->index * SECT_SIZE;
+
+    if (info->kind != SECT_ADPCM4 || info->bytes != SECT_DATA_SIZE)
+    {
+      decodeOther(sect, info, out[i]);
+      continue;
+    }
+
+    data[lanes] = sect + SECT_HEADER_SIZE;
+    st[lanes] = info->state;
+    dst[lanes] = out[i];
+
+    if (++lanes == dec->lanes)
+    {
+      dec->kernel(data, st, dst);
+      lanes = 0;
+    }
+  }
+
+  /* remaining sectors one by one, simd lanes would need padding */
+  for (unsigned l = 0; l < lanes; l++)
+  {
+    kernelScalar(&data[l], &st[l], &dst[l]);
+  }
+}
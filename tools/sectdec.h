@@ -0,0 +1,94 @@
+/*
+ * sectdec.h
+ *
+ * Host decoder for flash images pulled off the recorder. Every data sector
+ * carries its own start state (header offset 92), so sectors are decoded
+ * independently; full 4-bit sectors are decoded several at a time, one per
+ * SIMD lane. Output is bit-exact with adpcmDecoder() / adpcm3DecodeBlock()
+ * in Application/adpcm.c. Layout see doc/interface.md, 4.1.
+ */
+
+#ifndef TOOLS_SECTDEC_H_
+#define TOOLS_SECTDEC_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "adpcm.h"
+
+#define SECT_SIZE                         4096
+#define SECT_HEADER_SIZE                  96
+#define SECT_DATA_SIZE                    4000
+#define SECT_RESERVED                     16      // journal, settings, counter
+#define SECT_CHUNK_SIZE                   160
+#define SECT_CHUNK_SAMPLES_3              (SECT_CHUNK_SIZE / 3 * 8)
+#define SECT_SAMPLES_4                    (SECT_DATA_SIZE * 2)
+
+/* header fields */
+#define SECT_FILL_OFFSET                  0
+#define SECT_POS_OFFSET                   88
+#define SECT_STATE_OFFSET                 92
+
+/* format bits, same as audio.h */
+#define SECT_FMT_ADPCM3                   (1 << 0)
+#define SECT_FMT_8KHZ                     (1 << 1)
+#define SECT_FMT_SILENCE                  (1 << 2)
+
+typedef enum SectKind
+{
+  SECT_BLANK,           // erased or not a data sector
+  SECT_ADPCM4,
+  SECT_ADPCM3,
+  SECT_SILENCE,
+} SectKind_t;
+
+typedef struct SectInfo
+{
+  uint32_t index;       // physical sector
+  uint32_t pos;         // recPos, logical sector
+  SectKind_t kind;
+  AdpcmState_t state;
+  uint32_t rate;        // Hz
+  uint32_t bytes;       // data bytes, fill length if committed on stop
+  uint32_t samples;     // decoded samples
+} SectInfo_t;
+
+void sectParse(const uint8_t *sect, uint32_t index, SectInfo_t *info);
+
+/*
+ * Kernel decoding lanes full 4-bit sectors (4000 bytes, 8000 samples) at
+ * once, data[i] and st[i] to out[i].
+ */
+typedef void (*SectKernel_t)(const uint8_t *const data[],
+                             const AdpcmState_t st[], int16_t *const out[]);
+
+typedef struct SectDecoder
+{
+  const char *name;
+  unsigned lanes;
+  SectKernel_t kernel;
+} SectDecoder_t;
+
+/*
+ * "scalar", "sse41", "avx2", or "auto" for the widest one the cpu has.
+ * Returns NULL if not available.
+ */
+const SectDecoder_t *sectDecoderFind(const char *name);
+
+/*
+ * Decode count sectors of image described by infos, sector i to out[i],
+ * which has room for infos[i].samples. Blank sectors produce nothing.
+ */
+void sectDecode(const SectDecoder_t *dec, const uint8_t *image,
+                const SectInfo_t *infos, size_t count, int16_t *const out[]);
+
+/* per-index tables shared by the simd kernels, [index * 8 + (code & 7)] */
+extern int32_t sectDiffqTable[89 * 8];
+extern int32_t sectNextTable[89 * 8];
+
+void sectKernelSse41(const uint8_t *const data[], const AdpcmState_t st[],
+                     int16_t *const out[]);
+void sectKernelAvx2(const uint8_t *const data[], const AdpcmState_t st[],
+                    int16_t *const out[]);
+
+#endif /* TOOLS_SECTDEC_H_ */
@@ -0,0 +1,93 @@
+/*
+ * sectdec_avx2.c
+ *
+ * 8 sectors at once, one per 32-bit lane. Built with -mavx2, called only
+ * if the cpu has it. Diffq and next index come from the shared per-index
+ * tables by gather, so the only serial dependency per sample is the index.
+ */
+#include <string.h>
+
+#include <immintrin.h>
+
+#include "sectdec.h"
+
+static inline uint32_t load32(const uint8_t *p)
+{
+  uint32_t x;
+  memcpy(&x, p, sizeof(x));
+  return x;
+}
+
+void sectKernelAvx2(const uint8_t *const data[], const AdpcmState_t st[],
+                    int16_t *const out[])
+{
+  const __m256i lo = _mm256_set1_epi32(-32768);
+  const __m256i hi = _mm256_set1_epi32(32767);
+  const __m256i seven = _mm256_set1_epi32(7);
+
+  __m256i pred = _mm256_setr_epi32(st[0].sample, st[1].sample, st[2].sample,
+                                   st[3].sample, st[4].sample, st[5].sample,
+                                   st[6].sample, st[7].sample);
+  __m256i index = _mm256_setr_epi32(st[0].index, st[1].index, st[2].index,
+                                    st[3].index, st[4].index, st[5].index,
+                                    st[6].index, st[7].index);
+
+  /* 4 bytes, 8 samples per lane per round, low nibble first */
+  for (size_t j = 0; j < SECT_DATA_SIZE; j += 4)
+  {
+    __m256i w = _mm256_setr_epi32(load32(data[0] + j), load32(data[1] + j),
+                                  load32(data[2] + j), load32(data[3] + j),
+                                  load32(data[4] + j), load32(data[5] + j),
+                                  load32(data[6] + j), load32(data[7] + j));
+    __m256i s[8];
+
+    for (int k = 0; k < 8; k++)
+    {
+      __m256i t = _mm256_add_epi32(_mm256_slli_epi32(index, 3),
+                                   _mm256_and_si256(w, seven));
+      __m256i diffq = _mm256_i32gather_epi32(sectDiffqTable, t, 4);
+      __m256i sign = _mm256_srai_epi32(_mm256_slli_epi32(w, 28), 31);
+
+      index = _mm256_i32gather_epi32(sectNextTable, t, 4);
+      diffq = _mm256_sub_epi32(_mm256_xor_si256(diffq, sign), sign);
+      pred = _mm256_add_epi32(pred, diffq);
+      pred = _mm256_min_epi32(_mm256_max_epi32(pred, lo), hi);
+
+      s[k] = pred;
+      w = _mm256_srli_epi32(w, 4);
+    }
+
+    /* transpose 8 x 8, row l is 8 samples of lane l */
+    __m256i t0 = _mm256_unpacklo_epi32(s[0], s[1]);
+    __m256i t1 = _mm256_unpackhi_epi32(s[0], s[1]);
+    __m256i t2 = _mm256_unpacklo_epi32(s[2], s[3]);
+    __m256i t3 = _mm256_unpackhi_epi32(s[2], s[3]);
+    __m256i t4 = _mm256_unpacklo_epi32(s[4], s[5]);
+    __m256i t5 = _mm256_unpackhi_epi32(s[4], s[5]);
+    __m256i t6 = _mm256_unpacklo_epi32(s[6], s[7]);
+    __m256i t7 = _mm256_unpackhi_epi32(s[6], s[7]);
+
+    __m256i u[8];
+    u[0] = _mm256_unpacklo_epi64(t0, t2);
+    u[1] = _mm256_unpackhi_epi64(t0, t2);
+    u[2] = _mm256_unpacklo_epi64(t1, t3);
+    u[3] = _mm256_unpackhi_epi64(t1, t3);
+    u[4] = _mm256_unpacklo_epi64(t4, t6);
+    u[5] = _mm256_unpackhi_epi64(t4, t6);
+    u[6] = _mm256_unpacklo_epi64(t5, t7);
+    u[7] = _mm256_unpackhi_epi64(t5, t7);
+
+    for (int l = 0; l < 4; l++)
+    {
+      __m256i a = _mm256_permute2x128_si256(u[l], u[l + 4], 0x20);
+      __m256i b = _mm256_permute2x128_si256(u[l], u[l + 4], 0x31);
+
+      _mm_storeu_si128((__m128i *) (out[l] + j * 2),
+                       _mm_packs_epi32(_mm256_castsi256_si128(a),
+                                       _mm256_extracti128_si256(a, 1)));
+      _mm_storeu_si128((__m128i *) (out[l + 4] + j * 2),
+                       _mm_packs_epi32(_mm256_castsi256_si128(b),
+                                       _mm256_extracti128_si256(b, 1)));
+    }
+  }
+}
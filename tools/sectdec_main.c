@@ -0,0 +1,149 @@
+/*
+ * sectdec_main.c
+ *
+ *   sectdec [-k auto|scalar|sse41|avx2] [-l] [-o out.raw] image.bin
+ *
+ * Decodes all data sectors of a flash image in recording order (recPos),
+ * writes 16-bit little endian pcm to out.raw. Sectors may mix 16 kHz and
+ * 8 kHz, -l lists every sector with its rate and sample count. The last
+ * 16 sectors (journal, settings, counter) are skipped.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "sectdec.h"
+
+static const char *kindNames[] = { "blank", "adpcm4", "adpcm3", "silence" };
+
+static int byPos(const void *a, const void *b)
+{
+  const SectInfo_t *x = a, *y = b;
+  return x->pos < y->pos ? -1 : x->pos > y->pos;
+}
+
+static double now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char *argv[])
+{
+  const char *kernel = "auto";
+  const char *output = NULL;
+  int list = 0;
+  int c;
+
+  while ((c = getopt(argc, argv, "k:lo:")) != -1)
+  {
+    switch (c)
+    {
+    case 'k':
+      kernel = optarg;
+      break;
+    case 'l':
+      list = 1;
+      break;
+    case 'o':
+      output = optarg;
+      break;
+    default:
+      goto usage;
+    }
+  }
+
+  if (optind != argc - 1)
+    goto usage;
+
+  const SectDecoder_t *dec = sectDecoderFind(kernel);
+  if (!dec)
+  {
+    fprintf(stderr, "kernel %s not available\n", kernel);
+    return 1;
+  }
+
+  FILE *fp = fopen(argv[optind], "rb");
+  if (!fp)
+  {
+    perror(argv[optind]);
+    return 1;
+  }
+  fseek(fp, 0, SEEK_END);
+  size_t size = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+
+  if (size % SECT_SIZE || size / SECT_SIZE <= SECT_RESERVED)
+  {
+    fprintf(stderr, "%s: not a flash image\n", argv[optind]);
+    return 1;
+  }
+
+  uint8_t *image = malloc(size);
+  if (!image || fread(image, 1, size, fp) != size)
+  {
+    perror(argv[optind]);
+    return 1;
+  }
+  fclose(fp);
+
+  size_t sects = size / SECT_SIZE - SECT_RESERVED;
+  SectInfo_t *infos = malloc(sects * sizeof(SectInfo_t));
+  size_t count = 0, samples = 0;
+
+  for (size_t i = 0; i < sects; i++)
+  {
+    sectParse(image + i * SECT_SIZE, i, &infos[count]);
+    if (infos[count].kind != SECT_BLANK)
+    {
+      samples += infos[count].samples;
+      count++;
+    }
+  }
+  qsort(infos, count, sizeof(SectInfo_t), byPos);
+
+  int16_t *pcm = malloc((samples + 1) * sizeof(int16_t));
+  int16_t **out = malloc((count + 1) * sizeof(int16_t *));
+  for (size_t i = 0, off = 0; i < count; off += infos[i].samples, i++)
+  {
+    out[i] = pcm + off;
+  }
+
+  double t0 = now();
+  sectDecode(dec, image, infos, count, out);
+  double t = now() - t0;
+
+  if (list)
+  {
+    for (size_t i = 0; i < count; i++)
+    {
+      printf("%10u %6u %-8s %5u %6u\n", infos[i].pos, infos[i].index,
+             kindNames[infos[i].kind], infos[i].rate, infos[i].samples);
+    }
+  }
+
+  fprintf(stderr, "%zu sectors, %zu samples, %s kernel, %.1f ms, "
+          "%.0f sectors/s\n", count, samples, dec->name, t * 1e3,
+          t > 0 ? count / t : 0);
+
+  if (output)
+  {
+    fp = fopen(output, "wb");
+    if (!fp || fwrite(pcm, sizeof(int16_t), samples, fp) != samples)
+    {
+      perror(output);
+      return 1;
+    }
+    fclose(fp);
+  }
+
+  return 0;
+
+usage:
+  fprintf(stderr, "usage: %s [-k auto|scalar|sse41|avx2] [-l] [-o out.raw]"
+          " image.bin\n", argv[0]);
+  return 2;
+}
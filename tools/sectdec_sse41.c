@@ -0,0 +1,87 @@
+/*
+ * sectdec_sse41.c
+ *
+ * 4 sectors at once, one per 32-bit lane. Built with -msse4.1, called
+ * only if the cpu has it. SSE has no gather, table lookups are done per
+ * lane; sign, predictor and clamp are vector operations.
+ */
+#include <string.h>
+
+#include <smmintrin.h>
+
+#include "sectdec.h"
+
+static inline uint32_t load32(const uint8_t *p)
+{
+  uint32_t x;
+  memcpy(&x, p, sizeof(x));
+  return x;
+}
+
+void sectKernelSse41(const uint8_t *const data[], const AdpcmState_t st[],
+                     int16_t *const out[])
+{
+  const __m128i lo = _mm_set1_epi32(-32768);
+  const __m128i hi = _mm_set1_epi32(32767);
+
+  __m128i pred = _mm_setr_epi32(st[0].sample, st[1].sample, st[2].sample,
+                                st[3].sample);
+  int32_t index[4] = { st[0].index, st[1].index, st[2].index, st[3].index };
+
+  for (size_t j = 0; j < SECT_DATA_SIZE; j += 4)
+  {
+    uint32_t w[4] = { load32(data[0] + j), load32(data[1] + j),
+                      load32(data[2] + j), load32(data[3] + j) };
+    __m128i s[8];
+
+    for (int k = 0; k < 8; k++)
+    {
+      int32_t t[4];
+      for (int l = 0; l < 4; l++)
+      {
+        t[l] = index[l] * 8 + (w[l] & 7);
+      }
+
+      __m128i diffq = _mm_setr_epi32(sectDiffqTable[t[0]],
+                                     sectDiffqTable[t[1]],
+                                     sectDiffqTable[t[2]],
+                                     sectDiffqTable[t[3]]);
+      __m128i sign = _mm_setr_epi32(-(int32_t) ((w[0] >> 3) & 1),
+                                    -(int32_t) ((w[1] >> 3) & 1),
+                                    -(int32_t) ((w[2] >> 3) & 1),
+                                    -(int32_t) ((w[3] >> 3) & 1));
+
+      for (int l = 0; l < 4; l++)
+      {
+        index[l] = sectNextTable[t[l]];
+        w[l] >>= 4;
+      }
+
+      diffq = _mm_sub_epi32(_mm_xor_si128(diffq, sign), sign);
+      pred = _mm_add_epi32(pred, diffq);
+      pred = _mm_min_epi32(_mm_max_epi32(pred, lo), hi);
+      s[k] = pred;
+    }
+
+    /* two 4 x 4 transposes, samples 0-3 and 4-7 of each lane */
+    __m128i a0 = _mm_unpacklo_epi32(s[0], s[1]);
+    __m128i a1 = _mm_unpackhi_epi32(s[0], s[1]);
+    __m128i a2 = _mm_unpacklo_epi32(s[2], s[3]);
+    __m128i a3 = _mm_unpackhi_epi32(s[2], s[3]);
+    __m128i b0 = _mm_unpacklo_epi32(s[4], s[5]);
+    __m128i b1 = _mm_unpackhi_epi32(s[4], s[5]);
+    __m128i b2 = _mm_unpacklo_epi32(s[6], s[7]);
+    __m128i b3 = _mm_unpackhi_epi32(s[6], s[7]);
+
+    __m128i ra[4] = { _mm_unpacklo_epi64(a0, a2), _mm_unpackhi_epi64(a0, a2),
+                      _mm_unpacklo_epi64(a1, a3), _mm_unpackhi_epi64(a1, a3) };
+    __m128i rb[4] = { _mm_unpacklo_epi64(b0, b2), _mm_unpackhi_epi64(b0, b2),
+                      _mm_unpacklo_epi64(b1, b3), _mm_unpackhi_epi64(b1, b3) };
+
+    for (int l = 0; l < 4; l++)
+    {
+      _mm_storeu_si128((__m128i *) (out[l] + j * 2),
+                       _mm_packs_epi32(ra[l], rb[l]));
+    }
+  }
+}
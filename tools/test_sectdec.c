@@ -0,0 +1,221 @@
+/*
+ * test_sectdec.c
+ *
+ * Every available kernel against the scalar reference (per-sample
+ * adpcmDecoder(), adpcm3DecodeBlock() per chunk) on a generated image:
+ * full 4-bit sectors from corpus signals and random bytes, from states
+ * at both clamps, plus 3-bit, partial (fill marker), silence marker and
+ * blank sectors, in an order that leaves simd batches incomplete.
+ */
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "check.h"
+#include "corpus.h"
+#include "sectdec.h"
+
+CHECK_DEFINE;
+
+#define DATA_SECTS                        203
+#define IMAGE_SECTS                       (DATA_SECTS + SECT_RESERVED)
+
+static uint8_t image[IMAGE_SECTS * SECT_SIZE];
+static SectInfo_t infos[DATA_SECTS];
+static int16_t *out[DATA_SECTS];
+static int16_t *ref[DATA_SECTS];
+
+static void put32(uint8_t *p, uint32_t x)
+{
+  p[0] = x;
+  p[1] = x >> 8;
+  p[2] = x >> 16;
+  p[3] = x >> 24;
+}
+
+static void makeHeader(uint8_t *sect, uint32_t pos, AdpcmState_t st,
+                       uint32_t fill)
+{
+  memset(sect, 0, SECT_HEADER_SIZE);
+  if (fill < SECT_DATA_SIZE)
+  {
+    put32(sect + SECT_FILL_OFFSET, fill | ((~fill & 0xffff) << 16));
+  }
+  put32(sect + SECT_POS_OFFSET, pos);
+  sect[SECT_STATE_OFFSET] = (uint8_t) st.sample;
+  sect[SECT_STATE_OFFSET + 1] = (uint8_t) (st.sample >> 8);
+  sect[SECT_STATE_OFFSET + 2] = st.index;
+  sect[SECT_STATE_OFFSET + 3] = st.format;
+}
+
+static void buildImage(void)
+{
+  static int16_t pcm[SECT_SAMPLES_4 * 2];
+  uint32_t seed = 99;
+
+  memset(image, 0xff, sizeof(image));
+
+  for (uint32_t i = 0; i < DATA_SECTS; i++)
+  {
+    uint8_t *sect = &image[i * SECT_SIZE];
+    uint8_t *data = sect + SECT_HEADER_SIZE;
+    uint32_t r = corpusRand(&seed);
+    AdpcmState_t st;
+
+    st.sample = (i % 5 == 0) ? -32768 : (i % 5 == 1) ? 32767 : (int16_t) r;
+    st.index = (r >> 16) % 89;
+    st.format = 0;
+
+    if (i % 41 == 40)           // blank
+      continue;
+
+    if (i % 23 == 5)            // silence marker
+    {
+      st.format = SECT_FMT_SILENCE;
+      makeHeader(sect, 1000 + i, st, SECT_DATA_SIZE);
+      put32(data, 1234 + i);
+      continue;
+    }
+
+    if (i % 17 == 3)            // 3-bit, every other one partial
+    {
+      AdpcmState_t enc = st;
+      uint32_t fill = (i & 1) ? SECT_DATA_SIZE : 7 * SECT_CHUNK_SIZE + 42;
+
+      enc.format = st.format = SECT_FMT_ADPCM3 | ((i & 2) ? SECT_FMT_8KHZ : 0);
+      corpusFill(CORPUS_SPEECH, pcm, SECT_DATA_SIZE / SECT_CHUNK_SIZE
+                     * SECT_CHUNK_SAMPLES_3, 16000, i);
+      memset(data, 0, SECT_DATA_SIZE);
+      for (uint32_t c = 0; c < SECT_DATA_SIZE / SECT_CHUNK_SIZE; c++)
+      {
+        adpcm3EncodeBlock(&pcm[c * SECT_CHUNK_SAMPLES_3], SECT_CHUNK_SAMPLES_3,
+                          &data[c * SECT_CHUNK_SIZE], &enc);
+      }
+      makeHeader(sect, 1000 + i, st, fill);
+      continue;
+    }
+
+    makeHeader(sect, 1000 + i, st, (i % 13 == 7) ? 1 + r % 3999 : SECT_DATA_SIZE);
+
+    if (i % 3 == 0)             // random codes, hits clamps often
+    {
+      for (uint32_t j = 0; j < SECT_DATA_SIZE; j++)
+        data[j] = (uint8_t) corpusRand(&seed);
+    }
+    else
+    {
+      AdpcmState_t enc = st;
+      corpusFill(i % CORPUS_KIND_NUM, pcm, SECT_SAMPLES_4, 16000, i);
+      adpcmEncodeBlock(pcm, SECT_SAMPLES_4, data, &enc);
+    }
+  }
+}
+
+static void decodeReference(void)
+{
+  for (uint32_t i = 0; i < DATA_SECTS; i++)
+  {
+    const SectInfo_t *info = &infos[i];
+    const uint8_t *data = &image[i * SECT_SIZE + SECT_HEADER_SIZE];
+    int16_t sample = info->state.sample;
+    uint8_t index = info->state.index;
+    AdpcmState_t st = info->state;
+
+    switch (info->kind)
+    {
+    case SECT_ADPCM4:
+      for (uint32_t k = 0; k < info->samples; k++)
+      {
+        uint8_t x = data[k / 2];
+        ref[i][k] = adpcmDecoder((k & 1) ? x >> 4 : x & 0x0f, &sample, &index);
+      }
+      break;
+
+    case SECT_ADPCM3:
+      for (uint32_t k = 0; k < info->samples; k += SECT_CHUNK_SAMPLES_3)
+      {
+        uint32_t n = info->samples - k;
+        n = n < SECT_CHUNK_SAMPLES_3 ? n : SECT_CHUNK_SAMPLES_3;
+        adpcm3DecodeBlock(&data[k / SECT_CHUNK_SAMPLES_3 * SECT_CHUNK_SIZE], n,
+                          &ref[i][k], &st);
+      }
+      break;
+
+    case SECT_SILENCE:
+      memset(ref[i], 0, info->samples * sizeof(int16_t));
+      break;
+
+    default:
+      break;
+    }
+  }
+}
+
+static void testParse(void)
+{
+  int kinds[4] = { 0 };
+
+  for (uint32_t i = 0; i < DATA_SECTS; i++)
+  {
+    kinds[infos[i].kind]++;
+    if (i % 41 == 40)
+      CHECK(infos[i].kind == SECT_BLANK, "sector %u not blank", i);
+    else
+      CHECK(infos[i].pos == 1000 + i, "sector %u pos %u", i, infos[i].pos);
+  }
+
+  CHECK(infos[5].kind == SECT_SILENCE && infos[5].samples == 1239,
+        "silence marker: kind %d samples %u", infos[5].kind, infos[5].samples);
+  CHECK(infos[20].kind == SECT_ADPCM3 && infos[20].samples == 7 * 424 + 112,
+        "partial 3-bit: kind %d samples %u", infos[20].kind, infos[20].samples);
+  CHECK(kinds[SECT_ADPCM4] > 100 && kinds[SECT_ADPCM3] && kinds[SECT_SILENCE]
+        && kinds[SECT_BLANK], "kinds %d %d %d %d", kinds[0], kinds[1],
+        kinds[2], kinds[3]);
+}
+
+static void testKernel(const char *name)
+{
+  const SectDecoder_t *dec = sectDecoderFind(name);
+
+  if (!dec)
+  {
+    printf("%s: not supported on this cpu, skipped\n", name);
+    return;
+  }
+
+  for (uint32_t i = 0; i < DATA_SECTS; i++)
+  {
+    memset(out[i], 0x5a, infos[i].samples * sizeof(int16_t));
+  }
+
+  sectDecode(dec, image, infos, DATA_SECTS, out);
+
+  for (uint32_t i = 0; i < DATA_SECTS; i++)
+  {
+    CHECK(!memcmp(out[i], ref[i], infos[i].samples * sizeof(int16_t)),
+          "%s: sector %u kind %d differs", name, i, infos[i].kind);
+  }
+}
+
+int main(void)
+{
+  buildImage();
+
+  for (uint32_t i = 0; i < DATA_SECTS; i++)
+  {
+    sectParse(&image[i * SECT_SIZE], i, &infos[i]);
+    out[i] = malloc((infos[i].samples + 1) * sizeof(int16_t));
+    ref[i] = malloc((infos[i].samples + 1) * sizeof(int16_t));
+  }
+
+  testParse();
+  decodeReference();
+
+  testKernel("scalar");
+  testKernel("sse41");
+  testKernel("avx2");
+
+  CHECK(sectDecoderFind("auto") != NULL, "no decoder");
+
+  return checkResult("test_sectdec");
+}